@@ -0,0 +1,95 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "allocation_sites.h"
+
+#include "flags.h"
+#include "objects.h"
+#include "program.h"
+#include "third_party/dartino/object_memory.h"
+
+namespace toit {
+
+AllocationSites::~AllocationSites() {
+  delete[] sites_;
+}
+
+AllocationSite* AllocationSites::lookup(uint8* bcp) {
+  if (sites_ == null) {
+    if (sites_allocation_failed_) return null;
+    sites_ = _new AllocationSite[CAPACITY];
+    if (sites_ == null) {
+      sites_allocation_failed_ = true;
+      return null;
+    }
+    memset(sites_, 0, CAPACITY * sizeof(AllocationSite));
+  }
+  // The bytecodes are not aligned, so all the bits of the bcp are useful.
+  uword hash = reinterpret_cast<uword>(bcp);
+  hash ^= hash >> 8;
+  for (int i = 0; i < CAPACITY; i++) {
+    AllocationSite* site = &sites_[(hash + i) & (CAPACITY - 1)];
+    if (site->bcp == bcp) return site;
+    if (site->bcp == null) {
+      // Keep the table sparse so the probe sequences stay short.
+      if (site_count_ >= CAPACITY - (CAPACITY >> 2)) return null;
+      site_count_++;
+      site->bcp = bcp;
+      return site;
+    }
+  }
+  return null;
+}
+
+void AllocationSites::process_samples(LivenessOracle* from_space, Program* program) {
+  for (int i = 0; i < sample_count_; i++) {
+    AllocationSite* site = samples_[i].site;
+    site->sampled++;
+    if (from_space->is_alive(samples_[i].object)) site->survived++;
+    if (site->sampled == DECISION_SAMPLES) decide(site, program);
+  }
+  sample_count_ = 0;
+}
+
+void AllocationSites::decide(AllocationSite* site, Program* program) {
+  bool pretenure = site->survived * 100 >= site->sampled * PRETENURE_PERCENT;
+  if (pretenure != site->pretenure) {
+    site->pretenure = pretenure;
+    trace(site, program, pretenure ? "pretenure" : "don't pretenure");
+  }
+  site->sampled = 0;
+  site->survived = 0;
+}
+
+void AllocationSites::forget_decisions(Program* program) {
+  if (sites_ == null) return;
+  for (int i = 0; i < CAPACITY; i++) {
+    AllocationSite* site = &sites_[i];
+    if (!site->pretenure) continue;
+    site->pretenure = false;
+    trace(site, program, "forget decision");
+  }
+}
+
+void AllocationSites::trace(AllocationSite* site, Program* program, const char* reason) {
+  if (!Flags::trace_pretenuring) return;
+  printf("[pretenuring | bci %d: %u/%u sampled objects survived, %s]\n",
+      program->absolute_bci_from_bcp(site->bcp),
+      static_cast<unsigned>(site->survived),
+      static_cast<unsigned>(site->sampled),
+      reason);
+}
+
+} // namespace toit
@@ -0,0 +1,94 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+class HeapObject;
+class LivenessOracle;
+class Program;
+
+// Survival feedback for one place in the bytecodes that allocates objects.
+struct AllocationSite {
+  uint8* bcp;
+  uint32 allocations;
+  uint32 sampled;
+  uint32 survived;
+  bool pretenure;
+};
+
+// Pretenuring, enabled with -Xpretenuring.  The ALLOCATE bytecode and the
+// calls to the array and byte array primitives are allocation sites.  One
+// in every SAMPLE_RATE objects allocated at a site is remembered, and the
+// next scavenge records whether it survived.  Objects from sites where
+// nearly all sampled objects survive are allocated directly in old-space,
+// so the scavenger no longer has to copy them before they are promoted.
+// Pretenured objects can't be sampled, so the decisions are forgotten at
+// each old-space GC, and the sites have to earn them again.
+// The sites and the samples are only touched from the thread that runs the
+// process (or collects its garbage), so they need no locking.
+class AllocationSites {
+ public:
+  static const int CAPACITY = 256;  // Must be a power of two.
+  static const int MAX_SAMPLES = 64;
+  static const uint32 SAMPLE_RATE = 8;
+  // The number of samples a decision is based on.
+  static const uint32 DECISION_SAMPLES = 32;
+  // The percentage of sampled objects that must survive their first
+  // scavenge for a site to be pretenured.
+  static const uint32 PRETENURE_PERCENT = 85;
+
+  ~AllocationSites();
+
+  // Returns the site for the given bcp, or null if the site can't be
+  // tracked.
+  AllocationSite* lookup(uint8* bcp);
+
+  // Counts an allocation at the site.  The object must be in new-space.
+  void record_allocation(AllocationSite* site, HeapObject* object) {
+    if (site->allocations++ % SAMPLE_RATE != 0) return;
+    if (sample_count_ == MAX_SAMPLES) return;
+    samples_[sample_count_].object = object;
+    samples_[sample_count_].site = site;
+    sample_count_++;
+  }
+
+  // Called during a scavenge, before the from-space is released.  Uses the
+  // liveness of the sampled objects to update the decisions.
+  void process_samples(LivenessOracle* from_space, Program* program);
+
+  // Called after an old-space GC.
+  void forget_decisions(Program* program);
+
+ private:
+  struct Sample {
+    HeapObject* object;
+    AllocationSite* site;
+  };
+
+  void decide(AllocationSite* site, Program* program);
+  void trace(AllocationSite* site, Program* program, const char* reason);
+
+  AllocationSite* sites_ = null;  // Allocated on first use.
+  bool sites_allocation_failed_ = false;
+  int site_count_ = 0;
+  Sample samples_[MAX_SAMPLES];
+  int sample_count_ = 0;
+};
+
+} // namespace toit
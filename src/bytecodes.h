@@ -85,6 +85,13 @@ enum BytecodeFormat {
 };
 
 // Macro for iterating over the bytecode definitions.
+//
+// The bytecodes at the end of the list are superinstructions. They fuse
+// a bytecode with the bytecode that follows it. The following bytecode is
+// left in place, so a superinstruction has the length of the first
+// bytecode and its slow path behaves exactly like the first bytecode.
+// The fast path executes both bytecodes with a single dispatch.
+// New non-fused bytecodes should be added before the superinstructions.
 #define BYTECODES(BYTECODE)                                                    \
   BYTECODE(LOAD_LOCAL,                 2, OP_BS, "load local")                 \
   BYTECODE(LOAD_LOCAL_WIDE,            3, OP_SS, "load local wide")            \
@@ -202,6 +209,14 @@ enum BytecodeFormat {
   BYTECODE(INTRINSIC_ARRAY_DO,         1, OP, "intrinsic array do")            \
   BYTECODE(INTRINSIC_HASH_FIND,        1, OP, "intrinsic hash find")           \
   BYTECODE(INTRINSIC_HASH_DO,          1, OP, "intrinsic hash do")             \
+  \
+  BYTECODE(INVOKE_EQ_BRANCH_IF_FALSE,  1, OP, "invoke eq, branch if false")    \
+  BYTECODE(INVOKE_LT_BRANCH_IF_FALSE,  1, OP, "invoke lt, branch if false")    \
+  BYTECODE(INVOKE_GT_BRANCH_IF_FALSE,  1, OP, "invoke gt, branch if false")    \
+  BYTECODE(INVOKE_LTE_BRANCH_IF_FALSE, 1, OP, "invoke lte, branch if false")   \
+  BYTECODE(INVOKE_GTE_BRANCH_IF_FALSE, 1, OP, "invoke gte, branch if false")   \
+  BYTECODE(INVOKE_ADD_STORE_LOCAL_POP, 1, OP, "invoke add, store local, pop")  \
+  BYTECODE(INVOKE_SUB_STORE_LOCAL_POP, 1, OP, "invoke sub, store local, pop")  \
 
 #define BYTECODE_ENUM(name, length, format, print) name,
 enum Opcode { BYTECODES(BYTECODE_ENUM) ILLEGAL_END };
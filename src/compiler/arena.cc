@@ -0,0 +1,53 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+
+#include "arena.h"
+
+#include "../utils.h"
+
+namespace toit {
+namespace compiler {
+
+Arena* Arena::current_ = null;
+
+Arena::~Arena() {
+  Chunk* chunk = chunks_;
+  while (chunk != null) {
+    Chunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+void* Arena::allocate(word size) {
+  size = Utils::round_up(size, ALIGNMENT);
+  if (limit_ - top_ < size) {
+    const word header_size = Utils::round_up(static_cast<word>(sizeof(Chunk)), ALIGNMENT);
+    word chunk_size = Utils::max(CHUNK_SIZE, header_size + size);
+    auto chunk = unvoid_cast<Chunk*>(malloc(chunk_size));
+    if (chunk == null) return null;
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    top_ = reinterpret_cast<uint8*>(chunk) + header_size;
+    limit_ = reinterpret_cast<uint8*>(chunk) + chunk_size;
+  }
+  void* result = top_;
+  top_ += size;
+  return result;
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,69 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+
+#pragma once
+
+#include "../top.h"
+
+namespace toit {
+namespace compiler {
+
+/// A bump allocator that frees all its memory at once.
+///
+/// A long-lived compiler (see `LspDaemon`) parses each unit in an arena of
+/// its own, so it can drop the unit when the file changes. While an arena is
+/// installed with a `Scope`, AST nodes and `List`s are allocated in it.
+/// Nothing else may keep pointers to that memory.
+class Arena {
+ public:
+  Arena() {}
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+
+  void* allocate(word size);
+
+  /// The arena that is installed, or null.
+  static Arena* current() { return current_; }
+
+  class Scope {
+   public:
+    explicit Scope(Arena* arena) : previous_(current_) { current_ = arena; }
+    ~Scope() { current_ = previous_; }
+
+   private:
+    Arena* previous_;
+  };
+
+ private:
+  static const word CHUNK_SIZE = 32 * KB;
+  static const word ALIGNMENT = 16;
+
+  struct Chunk {
+    Chunk* next;
+  };
+
+  Chunk* chunks_ = null;
+  uint8* top_ = null;
+  uint8* limit_ = null;
+
+  // Parsing in an arena only happens on the main thread of the daemon, and
+  // the parallel parser is never used there.
+  static Arena* current_;
+};
+
+} // namespace toit::compiler
+} // namespace toit
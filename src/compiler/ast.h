@@ -17,6 +17,7 @@
 
 #include <string>
 
+#include "arena.h"
 #include "list.h"
 #include "sources.h"
 #include "symbol.h"
@@ -101,6 +102,14 @@ class Node {
   Node() : range_(Source::Range::invalid()) {}
   virtual void accept(Visitor* visitor) = 0;
 
+  // Nodes are never deleted.  While an arena is installed, they are
+  // allocated in it, and freed with it.
+  static void* operator new(size_t size, const std::nothrow_t& tag) noexcept {
+    Arena* arena = Arena::current();
+    if (arena != null) return arena->allocate(size);
+    return ::operator new(size, tag);
+  }
+
   /// The range that should be selected and revealed when this node is
   /// picked or used for error reporting.
   /// For example, in method calls with bad arguments the ".method" part
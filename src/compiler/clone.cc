@@ -0,0 +1,610 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include <vector>
+
+#include "clone.h"
+#include "map.h"
+#include "resolver_scope.h"
+
+namespace toit {
+namespace compiler {
+
+using namespace ir;
+
+/// Copies the nodes of a program.
+///
+/// Classes, methods, fields and locals can be referenced before their
+///   declaration is reached. They are therefore created on first use, and
+///   the classes and methods are filled in afterwards.
+/// Expressions are copied once, even if they are referenced multiple times.
+class Cloner : public ReturningVisitor<Node*> {
+ public:
+  Program* clone(Program* program);
+
+#define DECLARE(name) Node* visit_##name(name* node);
+IR_NODES(DECLARE)
+#undef DECLARE
+
+ private:
+  UnorderedMap<Class*, Class*> classes_;
+  UnorderedMap<Method*, Method*> methods_;
+  UnorderedMap<Field*, Field*> fields_;
+  UnorderedMap<Local*, Local*> locals_;
+  UnorderedMap<Node*, Node*> nodes_;
+
+  std::vector<Class*> class_queue_;
+  std::vector<Method*> method_queue_;
+
+  Class* map(Class* klass);
+  Method* map(Method* method);
+  MethodInstance* map(MethodInstance* method) { return map(static_cast<Method*>(method))->as_MethodInstance(); }
+  Global* map(Global* global) { return map(static_cast<Method*>(global))->as_Global(); }
+  Field* map(Field* field);
+  Local* map(Local* local);
+  Parameter* map(Parameter* parameter) { return map(static_cast<Local*>(parameter))->as_Parameter(); }
+  Block* map(Block* block) { return map(static_cast<Local*>(block))->as_Block(); }
+  Expression* map(Expression* expression);
+  Code* map(Code* code) { return map(static_cast<Expression*>(code))->as_Code(); }
+  ReferenceMethod* map(ReferenceMethod* reference) {
+    return map(static_cast<Expression*>(reference))->as_ReferenceMethod();
+  }
+  Dot* map(Dot* dot);
+  Builtin* map(Builtin* builtin);
+  Type map(Type type);
+  StaticsScope* map(StaticsScope* statics);
+
+  template<typename T> List<T*> map_all(List<T*> nodes) {
+    auto result = ListBuilder<T*>::allocate(nodes.length());
+    for (int i = 0; i < nodes.length(); i++) {
+      result[i] = map(nodes[i]);
+    }
+    return result;
+  }
+
+  List<Type> map_all(List<Type> types) {
+    auto result = ListBuilder<Type>::allocate(types.length());
+    for (int i = 0; i < types.length(); i++) {
+      result[i] = map(types[i]);
+    }
+    return result;
+  }
+
+  Method* create_method(Method* method);
+  void fill_class(Class* klass, Class* result);
+  void fill_method(Method* method, Method* result);
+  void copy_local_state(Local* local, Local* result);
+  void copy_call_state(Call* call, Call* result);
+};
+
+Program* Cloner::clone(Program* program) {
+  auto result = _new Program(map_all(program->classes()),
+                             map_all(program->methods()),
+                             map_all(program->globals()),
+                             map_all(program->tree_roots()),
+                             map_all(program->entry_points()),
+                             map_all(program->literal_types()),
+                             map(program->lookup_failure()),
+                             map(program->as_check_failure()),
+                             map(program->lambda_box()));
+  // Filling in a class or method can reference new ones.
+  while (!class_queue_.empty() || !method_queue_.empty()) {
+    if (!class_queue_.empty()) {
+      auto klass = class_queue_.back();
+      class_queue_.pop_back();
+      fill_class(klass, classes_.at(klass));
+    } else {
+      auto method = method_queue_.back();
+      method_queue_.pop_back();
+      fill_method(method, methods_.at(method));
+    }
+  }
+  return result;
+}
+
+Class* Cloner::map(Class* klass) {
+  if (klass == null) return null;
+  auto probe = classes_.lookup(klass);
+  if (probe != null) return probe;
+  auto result = _new Class(klass->name(),
+                           klass->kind(),
+                           klass->is_abstract(),
+                           klass->range(),
+                           klass->outline_range());
+  classes_[klass] = result;
+  class_queue_.push_back(klass);
+  return result;
+}
+
+void Cloner::fill_class(Class* klass, Class* result) {
+  // The ids are only assigned when the program is emitted.
+  ASSERT(klass->start_id() == -1 && klass->total_field_count() == -1);
+  if (klass->is_runtime_class()) result->mark_runtime_class();
+  result->set_deprecation(klass->get_deprecation_message());
+  if (klass->has_super()) result->set_super(map(klass->super()));
+  result->set_interfaces(map_all(klass->interfaces()));
+  result->set_mixins(map_all(klass->mixins()));
+  result->set_unnamed_constructors(map_all(klass->unnamed_constructors()));
+  result->set_factories(map_all(klass->factories()));
+  result->set_methods(map_all(klass->methods()));
+  result->set_fields(map_all(klass->fields()));
+  if (klass->statics() != null) result->set_statics(map(klass->statics()));
+  result->set_toitdoc_scope(klass->toitdoc_scope());
+  result->set_is_instantiated(klass->is_instantiated());
+  if (klass->typecheck_selector().is_valid()) {
+    result->set_typecheck_selector(klass->typecheck_selector());
+  }
+}
+
+StaticsScope* Cloner::map(StaticsScope* statics) {
+  // Adding the entries in the same order keeps the order of the nodes.
+  auto result = _new StaticsScope();
+  statics->for_each([&](Symbol name, const ResolutionEntry& entry) {
+    ListBuilder<Node*> nodes;
+    for (auto node : entry.nodes()) {
+      nodes.add(map(node->as_Method()));
+    }
+    ResolutionEntry copy(entry.kind());
+    copy.set_nodes(nodes.build());
+    result->add(name, copy);
+  });
+  return result;
+}
+
+Method* Cloner::map(Method* method) {
+  if (method == null) return null;
+  auto probe = methods_.lookup(method);
+  if (probe != null) return probe;
+  auto result = create_method(method);
+  methods_[method] = result;
+  method_queue_.push_back(method);
+  return result;
+}
+
+Method* Cloner::create_method(Method* method) {
+  auto name = method->name();
+  auto holder = map(method->holder());
+  auto range = method->range();
+  auto outline_range = method->outline_range();
+  if (method->is_Global()) {
+    return _new Global(name, holder, method->as_Global()->is_final(), range, outline_range);
+  }
+  if (method->is_FieldStub()) {
+    auto stub = method->as_FieldStub();
+    return _new FieldStub(map(stub->field()), holder, stub->is_getter(), range, outline_range);
+  }
+  // The remaining stubs are only added when the program is lowered.
+  ASSERT(!method->is_AdapterStub() && !method->is_MixinStub() && !method->is_IsInterfaceOrMixinStub());
+  ASSERT(method->uses_resolution_shape());
+  auto shape = method->resolution_shape();
+  if (method->is_MonitorMethod()) {
+    return _new MonitorMethod(name, holder, shape, range, outline_range);
+  }
+  if (method->is_MethodInstance()) {
+    return _new MethodInstance(method->kind(), name, holder, shape, method->is_abstract(), range, outline_range);
+  }
+  if (method->is_MethodStatic()) {
+    return _new MethodStatic(name, holder, shape, method->kind(), range, outline_range);
+  }
+  if (method->is_Constructor()) {
+    if (method->as_Constructor()->is_synthetic()) {
+      return _new Constructor(name, holder, range, outline_range);
+    }
+    return _new Constructor(name, holder, shape, range, outline_range);
+  }
+  UNREACHABLE();
+}
+
+void Cloner::fill_method(Method* method, Method* result) {
+  result->set_parameters(map_all(method->parameters()));
+  auto return_type = method->return_type();
+  if (return_type.is_valid()) {
+    if (method->is_Global() && method->as_Global()->has_explicit_type()) {
+      result->as_Global()->set_explicit_return_type(map(return_type));
+    } else {
+      result->set_return_type(map(return_type));
+    }
+  }
+  if (method->does_not_return()) result->mark_does_not_return();
+  if (method->is_runtime_method()) result->mark_runtime_method();
+  result->set_deprecation(method->get_deprecation_message());
+  if (method->is_dead()) result->kill();
+  if (method->is_Global()) {
+    auto global = method->as_Global();
+    ASSERT(global->global_id() == -1);
+    // Only the fact that a global is mutated is recorded.
+    if (!global->is_effectively_final()) result->as_Global()->register_mutation();
+    if (!global->is_lazy()) result->as_Global()->mark_eager();
+  }
+  if (method->is_FieldStub()) {
+    auto stub = method->as_FieldStub();
+    if (stub->is_throwing()) result->as_FieldStub()->mark_throwing();
+    if (stub->checked_type().is_valid()) {
+      result->as_FieldStub()->set_checked_type(map(stub->checked_type()));
+    }
+  }
+  if (method->has_body()) result->set_body(map(method->body()));
+}
+
+Field* Cloner::map(Field* field) {
+  if (field == null) return null;
+  auto probe = fields_.lookup(field);
+  if (probe != null) return probe;
+  auto result = _new Field(field->name(),
+                           map(field->holder()),
+                           field->is_final(),
+                           field->range(),
+                           field->outline_range());
+  fields_[field] = result;
+  if (field->type().is_valid()) result->set_type(map(field->type()));
+  result->set_deprecation(field->get_deprecation_message());
+  ASSERT(field->resolved_index() == -1);
+  return result;
+}
+
+Local* Cloner::map(Local* local) {
+  if (local == null) return null;
+  auto probe = locals_.lookup(local);
+  if (probe != null) return probe;
+  Local* result;
+  if (local->is_CapturedLocal()) {
+    // Captured locals forward their state to the local they capture.
+    auto captured = local->as_CapturedLocal();
+    result = _new CapturedLocal(map(captured->local()), captured->index(), captured->range());
+    locals_[local] = result;
+    return result;
+  }
+  auto explicit_type = local->has_explicit_type() ? map(local->type()) : Type::invalid();
+  if (local->is_Parameter()) {
+    auto parameter = local->as_Parameter();
+    auto copy = _new Parameter(parameter->name(),
+                               explicit_type,
+                               parameter->is_block(),
+                               parameter->index(),
+                               parameter->original_index(),
+                               parameter->has_default_value(),
+                               parameter->default_value_range(),
+                               parameter->range());
+    auto migration_types = parameter->migration_types();
+    if (!migration_types.is_empty()) {
+      auto copied_types = ListBuilder<Parameter::MigrationType>::allocate(migration_types.length());
+      for (int i = 0; i < migration_types.length(); i++) {
+        auto migration_type = migration_types[i];
+        copied_types[i] = Parameter::MigrationType(map(migration_type.type()),
+                                                   migration_type.is_deprecated(),
+                                                   migration_type.deprecation_message());
+      }
+      copy->set_migration_types(copied_types);
+    }
+    result = copy;
+  } else if (local->is_Block()) {
+    result = _new Block(local->name(), local->range());
+  } else {
+    result = _new Local(local->name(), local->is_final(), local->is_block(), explicit_type, local->range());
+  }
+  locals_[local] = result;
+  copy_local_state(local, result);
+  return result;
+}
+
+void Cloner::copy_local_state(Local* local, Local* result) {
+  if (!local->has_explicit_type() && local->type().is_valid()) {
+    result->set_type(map(local->type()));
+  }
+  for (int i = 0; i < local->mutation_count(); i++) result->register_mutation();
+  if (local->is_captured()) result->mark_captured();
+  if (local->is_effectively_final_loop_variable()) result->mark_effectively_final_loop_variable();
+  // The index of parameters is passed to their constructor.
+  if (!local->is_Parameter() && local->index() != -1) result->set_index(local->index());
+}
+
+Type Cloner::map(Type type) {
+  if (!type.is_class()) return type;
+  auto result = Type(map(type.klass()));
+  return type.is_nullable() ? result.to_nullable() : result;
+}
+
+Expression* Cloner::map(Expression* expression) {
+  if (expression == null) return null;
+  auto probe = nodes_.lookup(expression);
+  if (probe != null) return probe->as_Expression();
+  auto result = expression->accept(this)->as_Expression();
+  nodes_[expression] = result;
+  return result;
+}
+
+Dot* Cloner::map(Dot* dot) {
+  auto probe = nodes_.lookup(dot);
+  if (probe != null) return probe->as_Dot();
+  auto result = dot->accept(this)->as_Dot();
+  nodes_[dot] = result;
+  return result;
+}
+
+Builtin* Cloner::map(Builtin* builtin) {
+  auto probe = nodes_.lookup(builtin);
+  if (probe != null) return probe->as_Builtin();
+  auto result = _new Builtin(builtin->kind());
+  nodes_[builtin] = result;
+  return result;
+}
+
+void Cloner::copy_call_state(Call* call, Call* result) {
+  if (call->is_tail_call()) result->mark_tail_call();
+}
+
+// Declarations are cloned through the 'map' functions, and the abstract
+// node classes are never instantiated.
+Node* Cloner::visit_Program(Program* node) { UNREACHABLE(); }
+Node* Cloner::visit_Global(Global* node) { UNREACHABLE(); }
+Node* Cloner::visit_Class(Class* node) { UNREACHABLE(); }
+Node* Cloner::visit_Field(Field* node) { UNREACHABLE(); }
+Node* Cloner::visit_Method(Method* node) { UNREACHABLE(); }
+Node* Cloner::visit_MethodInstance(MethodInstance* node) { UNREACHABLE(); }
+Node* Cloner::visit_MonitorMethod(MonitorMethod* node) { UNREACHABLE(); }
+Node* Cloner::visit_MethodStatic(MethodStatic* node) { UNREACHABLE(); }
+Node* Cloner::visit_Constructor(Constructor* node) { UNREACHABLE(); }
+Node* Cloner::visit_AdapterStub(AdapterStub* node) { UNREACHABLE(); }
+Node* Cloner::visit_MixinStub(MixinStub* node) { UNREACHABLE(); }
+Node* Cloner::visit_IsInterfaceOrMixinStub(IsInterfaceOrMixinStub* node) { UNREACHABLE(); }
+Node* Cloner::visit_FieldStub(FieldStub* node) { UNREACHABLE(); }
+Node* Cloner::visit_Local(Local* node) { UNREACHABLE(); }
+Node* Cloner::visit_Parameter(Parameter* node) { UNREACHABLE(); }
+Node* Cloner::visit_CapturedLocal(CapturedLocal* node) { UNREACHABLE(); }
+Node* Cloner::visit_Block(Block* node) { UNREACHABLE(); }
+Node* Cloner::visit_Expression(Expression* node) { UNREACHABLE(); }
+Node* Cloner::visit_Reference(Reference* node) { UNREACHABLE(); }
+Node* Cloner::visit_Call(Call* node) { UNREACHABLE(); }
+Node* Cloner::visit_Assignment(Assignment* node) { UNREACHABLE(); }
+Node* Cloner::visit_Literal(Literal* node) { UNREACHABLE(); }
+
+Node* Cloner::visit_Builtin(Builtin* node) {
+  return map(node);
+}
+
+Node* Cloner::visit_Dot(Dot* node) {
+  return _new Dot(map(node->receiver()), node->selector());
+}
+
+Node* Cloner::visit_LspSelectionDot(LspSelectionDot* node) {
+  return _new LspSelectionDot(map(node->receiver()), node->selector(), node->name());
+}
+
+Node* Cloner::visit_Code(Code* node) {
+  auto parameters = map_all(node->parameters());
+  auto body = map(node->body());
+  auto result = _new Code(node->name(), parameters, body, node->is_block(), node->range());
+  result->set_captured_count(node->captured_count());
+  if (node->is_dead()) result->kill();
+  return result;
+}
+
+Node* Cloner::visit_Sequence(Sequence* node) {
+  return _new Sequence(map_all(node->expressions()), node->range());
+}
+
+Node* Cloner::visit_TryFinally(TryFinally* node) {
+  auto body = map(node->body());
+  auto handler_parameters = map_all(node->handler_parameters());
+  auto handler = map(node->handler());
+  return _new TryFinally(body, handler_parameters, handler, node->range());
+}
+
+Node* Cloner::visit_If(If* node) {
+  auto condition = map(node->condition());
+  auto yes = map(node->yes());
+  auto no = map(node->no());
+  return _new If(condition, yes, no, node->range());
+}
+
+Node* Cloner::visit_Not(Not* node) {
+  return _new Not(map(node->value()), node->range());
+}
+
+Node* Cloner::visit_While(While* node) {
+  auto condition = map(node->condition());
+  auto body = map(node->body());
+  auto update = map(node->update());
+  auto loop_variable = map(node->loop_variable());
+  return _new While(condition, body, update, loop_variable, node->range());
+}
+
+Node* Cloner::visit_LoopBranch(LoopBranch* node) {
+  return _new LoopBranch(node->is_break(), node->block_depth(), node->range());
+}
+
+Node* Cloner::visit_Error(Error* node) {
+  return _new Error(node->range(), map_all(node->nested()));
+}
+
+Node* Cloner::visit_Nop(Nop* node) {
+  return _new Nop(node->range());
+}
+
+Node* Cloner::visit_FieldLoad(FieldLoad* node) {
+  auto result = _new FieldLoad(map(node->receiver()), map(node->field()), node->range());
+  if (node->is_box_load()) result->mark_box_load();
+  return result;
+}
+
+Node* Cloner::visit_FieldStore(FieldStore* node) {
+  auto receiver = map(node->receiver());
+  auto value = map(node->value());
+  auto result = _new FieldStore(receiver, map(node->field()), value, node->range());
+  if (node->is_box_store()) result->mark_box_store();
+  return result;
+}
+
+Node* Cloner::visit_Super(Super* node) {
+  if (node->expression() == null) {
+    ASSERT(!node->is_explicit());
+    return _new Super(node->is_at_end(), node->range());
+  }
+  return _new Super(map(node->expression()), node->is_explicit(), node->is_at_end(), node->range());
+}
+
+Node* Cloner::visit_CallStatic(CallStatic* node) {
+  auto target = map(node->target());
+  auto arguments = map_all(node->arguments());
+  auto result = _new CallStatic(target, node->shape(), arguments, node->range());
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_Lambda(Lambda* node) {
+  auto target = map(node->target());
+  auto arguments = map_all(node->arguments());
+  Map<Local*, int> captured_depths;
+  node->captured_depths().for_each([&](Local* local, int depth) {
+    captured_depths[map(local)] = depth;
+  });
+  auto result = _new Lambda(target, node->shape(), arguments, captured_depths, node->range());
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_CallConstructor(CallConstructor* node) {
+  auto target = map(node->target());
+  auto arguments = map_all(node->arguments());
+  auto result = _new CallConstructor(target, node->shape(), arguments, node->range());
+  if (node->is_box_construction()) result->mark_box_construction();
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_CallVirtual(CallVirtual* node) {
+  auto target = map(node->target());
+  auto arguments = map_all(node->arguments());
+  auto result = _new CallVirtual(target, node->shape(), arguments, node->range());
+  result->set_opcode(node->opcode());
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_CallBlock(CallBlock* node) {
+  auto target = map(node->target());
+  auto arguments = map_all(node->arguments());
+  auto result = _new CallBlock(target, node->shape(), arguments, node->range());
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_CallBuiltin(CallBuiltin* node) {
+  auto arguments = map_all(node->arguments());
+  auto result = _new CallBuiltin(map(node->target()), node->shape(), arguments, node->range());
+  copy_call_state(node, result);
+  return result;
+}
+
+Node* Cloner::visit_Typecheck(Typecheck* node) {
+  return _new Typecheck(node->kind(),
+                        map(node->expression()),
+                        map(node->type()),
+                        node->type_name(),
+                        node->range());
+}
+
+Node* Cloner::visit_Return(Return* node) {
+  auto value = map(node->value());
+  if (node->depth() == -1) {
+    return _new Return(value, node->is_end_of_method_return(), node->range());
+  }
+  return _new Return(value, node->depth(), node->range());
+}
+
+Node* Cloner::visit_ReferenceClass(ReferenceClass* node) {
+  return _new ReferenceClass(map(node->target()), node->range());
+}
+
+Node* Cloner::visit_ReferenceMethod(ReferenceMethod* node) {
+  return _new ReferenceMethod(map(node->target()), node->range());
+}
+
+Node* Cloner::visit_ReferenceLocal(ReferenceLocal* node) {
+  return _new ReferenceLocal(map(node->target()), node->block_depth(), node->range());
+}
+
+Node* Cloner::visit_ReferenceBlock(ReferenceBlock* node) {
+  return _new ReferenceBlock(map(node->target()), node->block_depth(), node->range());
+}
+
+Node* Cloner::visit_ReferenceGlobal(ReferenceGlobal* node) {
+  return _new ReferenceGlobal(map(node->target()), node->is_lazy(), node->range());
+}
+
+Node* Cloner::visit_LogicalBinary(LogicalBinary* node) {
+  auto left = map(node->left());
+  auto right = map(node->right());
+  return _new LogicalBinary(left, right, node->op(), node->range());
+}
+
+Node* Cloner::visit_AssignmentLocal(AssignmentLocal* node) {
+  auto local = map(node->local());
+  return _new AssignmentLocal(local, node->block_depth(), map(node->right()), node->range());
+}
+
+Node* Cloner::visit_AssignmentGlobal(AssignmentGlobal* node) {
+  auto global = map(node->global());
+  return _new AssignmentGlobal(global, map(node->right()), node->range());
+}
+
+Node* Cloner::visit_AssignmentDefine(AssignmentDefine* node) {
+  auto local = map(node->local());
+  return _new AssignmentDefine(local, map(node->right()), node->range());
+}
+
+Node* Cloner::visit_LiteralNull(LiteralNull* node) {
+  return _new LiteralNull(node->range());
+}
+
+Node* Cloner::visit_LiteralUndefined(LiteralUndefined* node) {
+  return _new LiteralUndefined(node->range());
+}
+
+Node* Cloner::visit_LiteralInteger(LiteralInteger* node) {
+  return _new LiteralInteger(node->value(), node->range());
+}
+
+Node* Cloner::visit_LiteralFloat(LiteralFloat* node) {
+  return _new LiteralFloat(node->value(), node->range());
+}
+
+Node* Cloner::visit_LiteralString(LiteralString* node) {
+  return _new LiteralString(node->value(), node->length(), node->range());
+}
+
+Node* Cloner::visit_LiteralByteArray(LiteralByteArray* node) {
+  return _new LiteralByteArray(node->data(), node->range());
+}
+
+Node* Cloner::visit_LiteralBoolean(LiteralBoolean* node) {
+  return _new LiteralBoolean(node->value(), node->range());
+}
+
+Node* Cloner::visit_PrimitiveInvocation(PrimitiveInvocation* node) {
+  return _new PrimitiveInvocation(node->module(),
+                                  node->primitive(),
+                                  node->module_index(),
+                                  node->primitive_index(),
+                                  node->range());
+}
+
+ir::Program* clone_program(ir::Program* program) {
+  Cloner cloner;
+  return cloner.clone(program);
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,34 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "ir.h"
+
+namespace toit {
+namespace compiler {
+
+/// Returns a deep copy of the given program.
+///
+/// The program must not be lowered yet, that is, the cloning must happen
+///   before the stubs are added and the methods switch to plain shapes.
+///
+/// The copy shares no nodes with the original, and all lists keep their
+///   order. Lowering and optimizing the copy thus yields the same program
+///   as doing it on the original.
+ir::Program* clone_program(ir::Program* program);
+
+} // namespace toit::compiler
+} // namespace toit
@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <fcntl.h>
 
+#include "arena.h"
+#include "clone.h"
 #include "compiler.h"
 #include "diagnostic.h"
 #include "definite.h"
@@ -39,6 +41,7 @@
 #include "list.h"
 #include "lsp/lsp.h"
 #include "lsp/completion.h"
+#include "lsp/daemon.h"
 #include "lsp/goto_definition.h"
 #include "lsp/rename.h"
 #include "lsp/selection_range.h"
@@ -50,11 +53,13 @@
 #include "mixin.h"
 #include "monitor.h"
 #include "optimizations/optimizations.h"
+#include "parallel_parser.h"
 #include "parser.h"
 #include "propagation/type_database.h"
 #include "resolver.h"
 #include "resolver_scope.h"
 #include "../snapshot_bundle.h"
+#include "snapshot_cache.h"
 #include "stubs.h"
 #include "symbol_canonicalizer.h"
 #include "token.h"
@@ -87,6 +92,8 @@ struct PipelineConfiguration {
   SourceManager* source_manager;
   Diagnostics* diagnostics;
   Lsp* lsp;
+  /// The state of a long-lived language-server compiler, or null.
+  LspDaemon* daemon;
 
   /// Whether to continue compiling after having encountered an error (if possible).
   bool force;
@@ -97,6 +104,8 @@ struct PipelineConfiguration {
   bool is_for_dependencies;
   /// Optimization level.
   int optimization_level;
+  /// The cache in which to store the compiled snapshot, or null.
+  SnapshotCache* snapshot_cache;
 };
 
 class Pipeline {
@@ -142,13 +151,23 @@ class Pipeline {
   virtual void parsed_units(const std::vector<ast::Unit*>& units);
   virtual void post_resolve(Resolver* resolver, ir::Program* program);
   virtual void post_type_check();
+  /// Whether a daemon can load and parse the sources of this pipeline in its
+  /// own process.
+  ///
+  /// Pipelines that already act on the request while loading or parsing
+  /// (and might exit) must run in the request process from the start.
+  virtual bool can_parse_in_daemon() { return true; }
 
   virtual List<const char*> adjust_source_paths(List<const char*> source_paths);
   virtual PackageLock load_package_lock(List<const char*> source_paths);
 
   SourceManager* source_manager() const { return configuration_.source_manager; }
   Diagnostics* diagnostics() const { return configuration_.diagnostics; }
-  SymbolCanonicalizer* symbol_canonicalizer() { return &symbols_; }
+  SymbolCanonicalizer* symbol_canonicalizer() {
+    // Cached units of a daemon refer to the daemon's symbols.
+    if (configuration_.daemon != null) return configuration_.daemon->symbols();
+    return &symbols_;
+  }
   Filesystem* filesystem() const { return configuration_.filesystem; }
   Lsp* lsp() { return configuration_.lsp; }
   // The toitdoc registry is filled during the resolution stage.
@@ -167,6 +186,10 @@ class Pipeline {
                        const PackageLock& package_lock);
   std::vector<ast::Unit*> _parse_units(List<const char*> source_paths,
                                        const PackageLock& package_lock);
+  void _parse_imports_in_parallel(std::vector<ast::Unit*>* units,
+                                  UnorderedMap<Source*, ast::Unit*>* parsed_units,
+                                  const PackageLock& package_lock,
+                                  int thread_count);
   ir::Program* resolve(const std::vector<ast::Unit*>& units,
                        int entry_unit_index,
                        int core_unit_index,
@@ -217,6 +240,8 @@ class LocationLanguageServerPipeline : public LanguageServerPipeline {
  protected:
   ast::Unit* parse(Source* source);
 
+  bool can_parse_in_daemon() { return false; }
+
   /// Whether the scanner should make keywords to identifiers if they are
   /// at the LSP-selection point.
   virtual bool is_lsp_selection_identifier() = 0;
@@ -493,24 +518,100 @@ void Compiler::language_server(const Compiler::Configuration& compiler_config) {
   };
 
   Lsp lsp(lsp_protocol);
+  SourceManager source_manager(fs);
+  lsp_request(&reader, &lsp, fs, &source_manager, null, compiler_config);
+}
+
+// Source positions are never reused, so a daemon that loaded more source
+// than this exits, and the language server starts a fresh one.
+static const int DAEMON_MAX_SOURCE_OFFSET = 1 << 30;
+
+void Compiler::language_server_daemon(const Compiler::Configuration& compiler_config) {
+#ifdef TOIT_POSIX
+  // The request processes read the rest of their request from stdin, so the
+  // daemon must not buffer any input that isn't its own.
+  setvbuf(stdin, null, _IONBF, 0);
+  LineReader reader(stdin);
+  LspFsConnectionMultiplexStdout connection;
+  LspWriterMultiplexStdout writer;
+  LspFsProtocol fs_protocol(&connection);
+  FilesystemLsp fs(&fs_protocol);
+  SourceManager source_manager(&fs);
+  LspDaemon daemon(&writer);
+  bool is_first_request = true;
 
+  while (true) {
+    int next = fgetc(stdin);
+    if (next == EOF) break;
+    ungetc(next, stdin);
+
+    char* port = reader.next("port");
+    if (strcmp("-2", port) != 0) {
+      FATAL("LANGUAGE SERVER ERROR - The daemon only supports multiplexed requests");
+    }
+    free(port);
+
+    // The server sends the paths of the files that changed since the last
+    // request, or -1 if any file might have changed.
+    int changed_count = reader.next_int("changed count");
+    std::vector<std::string> changed_paths;
+    for (int i = 0; i < changed_count; i++) {
+      char* path = reader.next("changed path");
+      changed_paths.push_back(path);
+      free(path);
+    }
+    if (changed_count < 0 || is_first_request) {
+      fs.clear_cache();
+      source_manager.revalidate();
+    } else {
+      fs.clear_cache(changed_paths);
+      for (auto& path : changed_paths) source_manager.revalidate(path);
+    }
+    is_first_request = false;
+    daemon.start_request();
+
+    LspProtocol lsp_protocol(&writer);
+    Lsp lsp(&lsp_protocol);
+    lsp_request(&reader, &lsp, &fs, &source_manager, &daemon, compiler_config);
+    if (daemon.is_request_process()) exit(0);
+    writer.end_request(daemon.request_signal(),
+                       daemon.reused_units(),
+                       daemon.parsed_units(),
+                       daemon.replayed());
+    daemon.finish_request(&source_manager);
+
+    if (source_manager.next_offset() > DAEMON_MAX_SOURCE_OFFSET) break;
+  }
+#else
+  FATAL("The language server daemon is not supported on this platform");
+#endif
+}
+
+void Compiler::lsp_request(LineReader* line_reader,
+                           Lsp* lsp,
+                           Filesystem* fs,
+                           SourceManager* source_manager,
+                           LspDaemon* daemon,
+                           const Compiler::Configuration& compiler_config) {
+  LineReader& reader = *line_reader;
   const char* mode = reader.next("mode");
-  SourceManager source_manager(fs);
   PipelineConfiguration configuration = {
     .out_path = null,
     .dep_file = null,
     .dep_format = DepFormat::none,
     .project_root = compiler_config.project_root,
     .filesystem = fs,
-    .source_manager = &source_manager,
+    .source_manager = source_manager,
     .diagnostics = null,  // Needs to be set later.
-    .lsp = &lsp,
+    .lsp = lsp,
+    .daemon = daemon,
     .force = compiler_config.force,
     .werror = compiler_config.werror,
     .parse_only = false,
     .is_for_analysis = true,
     .is_for_dependencies = false,
     .optimization_level = compiler_config.optimization_level,
+    .snapshot_cache = null,
   };
 
   if (strcmp("ANALYZE", mode) == 0) {
@@ -519,12 +620,18 @@ void Compiler::language_server(const Compiler::Configuration& compiler_config) {
       FATAL("LANGUAGE SERVER ERROR - analyze must have at least one source");
     }
     auto source_paths = ListBuilder<const char*>::allocate(path_count);
+    std::string request_key = mode;
     for (int i = 0; i < path_count; i++) {
       source_paths[i] = strdup(reader.next("path"));
+      request_key += '\n';
+      request_key += source_paths[i];
     }
-    LanguageServerAnalysisDiagnostics diagnostics(&source_manager, &lsp);
+    // The diagnostics and summaries only depend on the content of the
+    // loaded files, so the daemon can replay them.
+    if (daemon != null) daemon->set_request_key(request_key);
+    LanguageServerAnalysisDiagnostics diagnostics(source_manager, lsp);
     configuration.diagnostics = &diagnostics;
-    lsp.set_needs_summary(true);
+    lsp->set_needs_summary(true);
     lsp_analyze(source_paths, configuration);
   } else if (strcmp("PARSE", mode) == 0) {
     int path_count = reader.next_int("path count");
@@ -536,20 +643,23 @@ void Compiler::language_server(const Compiler::Configuration& compiler_config) {
       source_paths[i] = strdup(reader.next("path"));
     }
 
-    NullDiagnostics diagnostics(&source_manager);
+    NullDiagnostics diagnostics(source_manager);
     configuration.diagnostics = &diagnostics;
     configuration.parse_only = true;
-    lsp.set_needs_summary(false);
+    lsp->set_needs_summary(false);
     lsp_analyze(source_paths, configuration);
   } else if (strcmp("SNAPSHOT BUNDLE", mode) == 0) {
     const char* path = reader.next("path");
-    NullDiagnostics diagnostics(&source_manager);
+    // Compiling forks again, and the compilation must only report its
+    // result in the process of the request.
+    if (daemon != null && !daemon->fork_request()) return;
+    NullDiagnostics diagnostics(source_manager);
     configuration.diagnostics = &diagnostics;
     configuration.is_for_analysis = false;
     lsp_snapshot(path, configuration);
   } else if (strcmp("SEMANTIC TOKENS", mode) == 0) {
     const char* path = reader.next("path");
-    NullDiagnostics diagnostics(&source_manager);
+    NullDiagnostics diagnostics(source_manager);
     configuration.diagnostics = &diagnostics;
     configuration.is_for_analysis = true;
     lsp_semantic_tokens(path, configuration);
@@ -564,7 +674,7 @@ void Compiler::language_server(const Compiler::Configuration& compiler_config) {
       int col  = 1 + reader.next_int("column number (0-based)");
       positions.push_back({line, col});
     }
-    NullDiagnostics diagnostics(&source_manager);
+    NullDiagnostics diagnostics(source_manager);
     configuration.diagnostics = &diagnostics;
     configuration.is_for_analysis = true;
     lsp_selection_range(path, positions, configuration);
@@ -573,7 +683,7 @@ void Compiler::language_server(const Compiler::Configuration& compiler_config) {
     // We generally use 1-based line/column numbers.
     int line_number = 1 + reader.next_int("line number (0-based)");
     int column_number = 1 + reader.next_int("column number (0-based)");
-    NullDiagnostics diagnostics(&source_manager);
+    NullDiagnostics diagnostics(source_manager);
     configuration.diagnostics = &diagnostics;
     if (strcmp("COMPLETE", mode) == 0) {
       lsp_complete(path, line_number, column_number, configuration);
@@ -764,12 +874,14 @@ void Compiler::analyze(List<const char*> source_paths,
     .source_manager = &source_manager,
     .diagnostics = diagnostics,
     .lsp = null,
+    .daemon = null,
     .force = compiler_config.force,
     .werror = compiler_config.werror,
     .parse_only = false,
     .is_for_analysis = !for_dependencies,
     .is_for_dependencies = for_dependencies,
     .optimization_level = compiler_config.optimization_level,
+    .snapshot_cache = null,
   };
   Pipeline pipeline(configuration);
   pipeline.run(source_paths, false);
@@ -893,12 +1005,14 @@ SnapshotBundle Compiler::compile(const char* source_path,
     .source_manager = &source_manager,
     .diagnostics = &diagnostics,
     .lsp = null,
+    .daemon = null,
     .force = compiler_config.force,
     .werror = compiler_config.werror,
     .parse_only = false,
     .is_for_analysis = false,
     .is_for_dependencies = false,
     .optimization_level = compiler_config.optimization_level,
+    .snapshot_cache = compiler_config.snapshot_cache,
   };
 
   return compile(source_path, configuration);
@@ -1010,9 +1124,25 @@ static int compute_source_offset(const uint8* source, int line_number, int utf16
 }
 
 ast::Unit* Pipeline::parse(Source* source) {
+  auto daemon = configuration_.daemon;
+  if (daemon != null) {
+    auto cached = daemon->lookup(source);
+    if (cached != null) return cached;
+  }
+  if (daemon == null || daemon->is_request_process()) {
+    Scanner scanner(source, symbol_canonicalizer(), diagnostics());
+    Parser parser(source, &scanner, diagnostics());
+    return parser.parse_unit();
+  }
+  // The daemon frees the unit once its file changes.
+  int reported_count = diagnostics()->reported_count();
+  auto arena = _new Arena();
+  Arena::Scope scope(arena);
   Scanner scanner(source, symbol_canonicalizer(), diagnostics());
   Parser parser(source, &scanner, diagnostics());
-  return parser.parse_unit();
+  auto result = parser.parse_unit();
+  daemon->add(source, result, arena, diagnostics()->reported_count() == reported_count);
+  return result;
 }
 
 void Pipeline::setup_lsp_selection_handler() {
@@ -1832,6 +1962,14 @@ std::vector<ast::Unit*> Pipeline::_parse_units(List<const char*> source_paths,
     units.push_back(unit);
   }
 
+  // The language server and the daemon parse through the virtual `parse`
+  // and might act on the sources while loading them.
+  int thread_count = ParallelParser::default_thread_count();
+  if (lsp() == null && configuration_.daemon == null && thread_count > 1) {
+    _parse_imports_in_parallel(&units, &parsed_units, package_lock, thread_count);
+    return units;
+  }
+
   // Transitively parse the source_files.
   // Note that we modify the vector inside the loop, growing it.
   for (size_t i = 0; i < units.size(); i++) {
@@ -1867,6 +2005,98 @@ std::vector<ast::Unit*> Pipeline::_parse_units(List<const char*> source_paths,
   return units;
 }
 
+/// Transitively parses the imports of the given units, like the sequential
+///   loop in `_parse_units`, but parses the new units of each round in
+///   parallel.
+///
+/// The units end up in the same order as with the sequential loop. The
+///   diagnostics of loading and parsing are buffered, and are reported in
+///   the order in which the sequential loop would report them.
+void Pipeline::_parse_imports_in_parallel(std::vector<ast::Unit*>* units,
+                                          UnorderedMap<Source*, ast::Unit*>* parsed_units,
+                                          const PackageLock& package_lock,
+                                          int thread_count) {
+  // Loading an import of a round either yields an error unit, a unit that
+  // was already parsed, or a source that is parsed at the end of the round.
+  struct Load {
+    BufferedDiagnostics* diagnostics;
+    ast::Import* import;
+    ast::Unit* unit;
+    int source_index;  // The index in the sources of the round, or -1.
+    bool is_first;     // Whether the load adds the unit.
+  };
+
+  ParallelParser parser(symbol_canonicalizer(), thread_count);
+  size_t round_start = 0;
+  while (round_start < units->size()) {
+    size_t round_end = units->size();
+    std::vector<Load> loads;
+    std::vector<Source*> sources;
+    UnorderedMap<Source*, int> source_indexes;
+    for (size_t i = round_start; i < round_end; i++) {
+      auto unit = (*units)[i];
+      for (auto import : unit->imports()) {
+        if (import->unit() != null) continue;
+        auto load_diagnostics = _new BufferedDiagnostics();
+        auto diagnostics = configuration_.diagnostics;
+        configuration_.diagnostics = load_diagnostics;
+        auto import_source = _load_import(unit, import, package_lock);
+        configuration_.diagnostics = diagnostics;
+
+        Load load = {
+          .diagnostics = load_diagnostics,
+          .import = import,
+          .unit = null,
+          .source_index = -1,
+          .is_first = false,
+        };
+        if (import_source == null) {
+          ASSERT(load_diagnostics->encountered_error());
+          bool is_error_unit = true;
+          load.unit = _new ast::Unit(is_error_unit);
+          load.is_first = true;
+        } else if (parsed_units->lookup(import_source) != null) {
+          load.unit = parsed_units->lookup(import_source);
+        } else {
+          auto probe = source_indexes.find(import_source);
+          if (probe != source_indexes.end()) {
+            load.source_index = probe->second;
+          } else {
+            load.source_index = sources.size();
+            load.is_first = true;
+            source_indexes[import_source] = sources.size();
+            sources.push_back(import_source);
+          }
+        }
+        loads.push_back(load);
+      }
+    }
+
+    std::vector<BufferedDiagnostics*> parse_diagnostics;
+    for (size_t i = 0; i < sources.size(); i++) {
+      parse_diagnostics.push_back(_new BufferedDiagnostics());
+    }
+    auto new_units = parser.parse(sources, parse_diagnostics);
+
+    for (auto& load : loads) {
+      load.diagnostics->replay(diagnostics());
+      auto unit = load.unit;
+      if (load.source_index >= 0) {
+        unit = new_units[load.source_index];
+        if (load.is_first) {
+          auto source = sources[load.source_index];
+          if (Flags::trace) printf("Parsing file '%s'\n", source->absolute_path());
+          parse_diagnostics[load.source_index]->replay(diagnostics());
+          (*parsed_units)[source] = unit;
+        }
+      }
+      load.import->set_unit(unit);
+      if (load.is_first) units->push_back(unit);
+    }
+    round_start = round_end;
+  }
+}
+
 static void assign_field_indexes(List<ir::Class*> classes) {
   ASSERT(_sorted_by_inheritance(classes));
   // We rely on the fact that the classes are sorted by inheritance.
@@ -2085,6 +2315,11 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
   Flags::enable_asserts = true;
 #endif
 
+  auto daemon = configuration_.daemon;
+  if (daemon != null && !can_parse_in_daemon() && !daemon->fork_request()) {
+    return Result::invalid();
+  }
+
   setup_lsp_selection_handler();
 
   auto fs = configuration_.filesystem;
@@ -2132,6 +2367,14 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
 
   if (configuration_.parse_only) return Result::invalid();
 
+  // The daemon keeps the parsed units. The rest of the request runs in a
+  // process of its own, unless the daemon still has the output of the same
+  // request on the same files.
+  if (daemon != null) {
+    bool cacheable = diagnostics()->reported_count() == 0;
+    if (!daemon->replay_or_fork_request(units, cacheable)) return Result::invalid();
+  }
+
   // Give subclasses a chance to handle parse-only requests (e.g. selection ranges).
   parsed_units(units);
 
@@ -2173,27 +2416,36 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
   bool run_optimizations = !diagnostics()->encountered_error() &&
       configuration_.optimization_level >= 1;
 
+  // The second compilation pass, where we use propagated types, must start
+  // from the same IR nodes as the first one, so the optimizations behave the
+  // same way and the oracle can match up the nodes. Constructing the program
+  // lowers the IR in place, so we keep a copy of the resolved and
+  // type-checked IR for the second pass.
+  bool run_second_pass = run_optimizations && configuration_.optimization_level >= 2;
+  ir::Program* second_pass_program = null;
+  if (run_second_pass && !Flags::no_clone_ir) {
+    second_pass_program = clone_program(ir_program);
+  }
+
   SourceMapper unoptimized_source_mapper(source_manager());
   auto source_mapper = &unoptimized_source_mapper;
   TypeOracle oracle(source_mapper);
   auto program = construct_program(ir_program, source_mapper, &oracle, null, run_optimizations);
 
   SourceMapper optimized_source_mapper(source_manager());
-  if (run_optimizations && configuration_.optimization_level >= 2) {
-    bool quiet = true;
-    ir_program = resolve(units, ENTRY_UNIT_INDEX, CORE_UNIT_INDEX, quiet);
-    sort_classes(ir_program->classes());
-    // We check the types again, because the compiler computes types as
-    // a side-effect of this and the types are necessary for the
-    // optimizations. This feels a little bit unfortunate, but it is
-    // important that the second compilation pass where we use propagated
-    // types is based on the same IR nodes, so we need the optimizations
-    // to behave the same way for the output to be correct.
-    check_types_and_deprecations(ir_program, quiet);
-    ASSERT(!diagnostics()->encountered_error());
+  if (run_second_pass) {
+    if (second_pass_program == null) {
+      // Resolve and type-check again instead. This must produce the same
+      // output as the copy, which is checked by the tests.
+      bool quiet = true;
+      second_pass_program = resolve(units, ENTRY_UNIT_INDEX, CORE_UNIT_INDEX, quiet);
+      sort_classes(second_pass_program->classes());
+      check_types_and_deprecations(second_pass_program, quiet);
+      ASSERT(!diagnostics()->encountered_error());
+    }
     TypeDatabase* types = TypeDatabase::compute(program);
     source_mapper = &optimized_source_mapper;
-    program = construct_program(ir_program, source_mapper, &oracle, types, true);
+    program = construct_program(second_pass_program, source_mapper, &oracle, types, true);
     delete types;
   }
 
@@ -2210,6 +2462,15 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
   uint8* source_map_data = source_mapper->cook(&source_map_size);
   int snapshot_size;
   uint8* snapshot = generator.take_buffer(&snapshot_size);
+  // Only cache the snapshot if the compilation didn't report anything, so
+  // that running it from the cache behaves exactly the same.
+  auto snapshot_cache = configuration_.snapshot_cache;
+  if (snapshot_cache != null && diagnostics()->reported_count() == 0) {
+    snapshot_cache->store(units,
+                          package_lock.lock_file_source(),
+                          List<uint8>(snapshot, snapshot_size),
+                          List<uint8>(source_map_data, source_map_size));
+  }
   return {
     .snapshot = snapshot,
     .snapshot_size = snapshot_size,
@@ -34,9 +34,14 @@ class Program;
 namespace compiler {
 
 class DispatchTable;
+class Filesystem;
+class LineReader;
+class Lsp;
+class LspDaemon;
 class Parser;
 class ProgramBuilder;
 class Diagnostics;
+class SnapshotCache;
 class SourceMapper;
 class SymbolCanonicalizer;
 
@@ -70,6 +75,9 @@ class Compiler {
     bool print_diagnostics_on_stdout;
     /// Optimization level.
     int optimization_level;
+    /// The cache in which to store the compiled snapshot.
+    /// Optional (may be null).
+    SnapshotCache* snapshot_cache;
   };
 
   Compiler();
@@ -85,6 +93,16 @@ class Compiler {
   /// generated information is not intended to be read by humans.
   void language_server(const Configuration& config);
 
+  /// Starts the compiler as a long-lived language-server backend.
+  ///
+  /// Reads one language-server request after the other from stdin, until
+  /// stdin is closed. The requests must multiplex the filesystem protocol
+  /// over stdin/stdout (port "-2"). The output of each request is terminated
+  /// with an end-of-request frame (see `LspWriterMultiplexStdout`).
+  ///
+  /// Parsed units of unchanged files are reused between requests.
+  void language_server_daemon(const Configuration& config);
+
   /// Analyzes the given source.
   ///
   /// This mode does not run the program or generates any snapshots. It simply
@@ -103,6 +121,18 @@ class Compiler {
                          const Configuration& config);
 
  private:
+  /// Reads the mode of a language-server request and its arguments from the
+  /// reader, and handles the request.
+  ///
+  /// The [daemon] is null, unless the request is handled by a long-lived
+  /// compiler.
+  void lsp_request(LineReader* reader,
+                   Lsp* lsp,
+                   Filesystem* fs,
+                   SourceManager* source_manager,
+                   LspDaemon* daemon,
+                   const Configuration& compiler_config);
+
   /// Analyzes the given sources.
   ///
   /// This mode does not run the program or generates any snapshots. It simply
@@ -40,6 +40,7 @@ namespace compiler {
 const char* const NO_WARN_MARKER = "// @no-warn";
 
 void Diagnostics::report(Severity severity, const char* format, va_list& arguments) {
+  reported_count_++;
   severity = adjust_severity(severity);
   bool was_emitted = emit(severity, format, arguments);
   if (!was_emitted) return;
@@ -72,6 +73,7 @@ bool Diagnostics::ends_with_no_warn_marker(const Source::Position& pos) {
 }
 
 void Diagnostics::report(Severity severity, Source::Range range, const char* format, va_list& arguments) {
+  reported_count_++;
   severity = adjust_severity(severity);
   if (severity == Severity::warning && ends_with_no_warn_marker(range.to())) {
     return;
@@ -344,5 +346,95 @@ void LanguageServerAnalysisDiagnostics::end_group() {
   lsp()->diagnostics()->end_group();
 }
 
+static std::string format_message(const char* format, va_list& arguments) {
+  va_list arguments_copy;
+  va_copy(arguments_copy, arguments);
+  int size = vsnprintf(null, 0, format, arguments_copy);
+  va_end(arguments_copy);
+  std::string result(size, '\0');
+  vsnprintf(&result[0], size + 1, format, arguments);
+  return result;
+}
+
+bool BufferedDiagnostics::emit(Severity severity, const char* format, va_list& arguments) {
+  entries_.push_back({
+    .kind = Kind::message,
+    .severity = severity,
+    .range = Source::Range::invalid(),
+    .message = format_message(format, arguments),
+  });
+  return true;
+}
+
+bool BufferedDiagnostics::emit(Severity severity,
+                               Source::Range range,
+                               const char* format,
+                               va_list& arguments) {
+  entries_.push_back({
+    .kind = Kind::message_with_range,
+    .severity = severity,
+    .range = range,
+    .message = format_message(format, arguments),
+  });
+  return true;
+}
+
+void BufferedDiagnostics::start_group() {
+  entries_.push_back({
+    .kind = Kind::start_group,
+    .severity = Severity::note,
+    .range = Source::Range::invalid(),
+    .message = "",
+  });
+}
+
+void BufferedDiagnostics::end_group() {
+  entries_.push_back({
+    .kind = Kind::end_group,
+    .severity = Severity::note,
+    .range = Source::Range::invalid(),
+    .message = "",
+  });
+}
+
+static void report_to(Diagnostics* target,
+                      Diagnostics::Severity severity,
+                      const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  target->report(severity, format, arguments);
+  va_end(arguments);
+}
+
+static void report_to(Diagnostics* target,
+                      Diagnostics::Severity severity,
+                      Source::Range range,
+                      const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  target->report(severity, range, format, arguments);
+  va_end(arguments);
+}
+
+void BufferedDiagnostics::replay(Diagnostics* target) {
+  for (auto& entry : entries_) {
+    switch (entry.kind) {
+      case Kind::message:
+        report_to(target, entry.severity, "%s", entry.message.c_str());
+        break;
+      case Kind::message_with_range:
+        report_to(target, entry.severity, entry.range, "%s", entry.message.c_str());
+        break;
+      case Kind::start_group:
+        target->start_group();
+        break;
+      case Kind::end_group:
+        target->end_group();
+        break;
+    }
+  }
+  entries_.clear();
+}
+
 } // namespace toit::compiler
 } // namespace toit
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "../top.h"
 
@@ -73,6 +74,12 @@ class Diagnostics {
     return encountered_warning_;
   }
 
+  /// The number of diagnostics that were reported so far, including the
+  /// ones that were not emitted.
+  int reported_count() const {
+    return reported_count_;
+  }
+
   SourceManager* source_manager() { return source_manager_; }
 
   void report_location(Source::Range range, const char* prefix);
@@ -102,6 +109,7 @@ class Diagnostics {
   SourceManager* source_manager_;
   bool encountered_error_;
   bool encountered_warning_;
+  int reported_count_ = 0;
 
   bool ends_with_no_warn_marker(const Source::Position& pos);
 };
@@ -186,5 +194,46 @@ class NullDiagnostics : public Diagnostics {
   bool emit(Severity severity, Source::Range range, const char* format, va_list& arguments) { return true; }
 };
 
+/// Collects diagnostics, so that they can be reported later.
+///
+/// Diagnostics that are produced concurrently (like the ones of sources that
+///   are parsed in parallel) are replayed in a fixed order, so that the
+///   output doesn't depend on the scheduling of the threads.
+/// The no-warn markers and the severity adjustments of the target are
+///   applied when replaying.
+class BufferedDiagnostics : public Diagnostics {
+ public:
+  BufferedDiagnostics() : Diagnostics(null) {}
+
+  bool should_report_missing_main() const { return false; }
+
+  void start_group();
+  void end_group();
+
+  /// Reports the collected diagnostics to the [target] and clears them.
+  void replay(Diagnostics* target);
+
+ protected:
+  bool emit(Severity severity, const char* format, va_list& arguments);
+  bool emit(Severity severity, Source::Range range, const char* format, va_list& arguments);
+
+ private:
+  enum class Kind {
+    message,
+    message_with_range,
+    start_group,
+    end_group,
+  };
+
+  struct Entry {
+    Kind kind;
+    Severity severity;
+    Source::Range range;
+    std::string message;
+  };
+
+  std::vector<Entry> entries_;
+};
+
 } // namespace toit::compiler
 } // namespace toit
@@ -14,6 +14,7 @@
 // directory of this repository.
 
 #include "emitter.h"
+#include "../flags.h"
 #include "../objects_inline.h"
 #include "../interpreter.h"
 #include "limits.h"
@@ -326,6 +327,15 @@ void Emitter::pop(int n) {
       (previous == STORE_LOCAL || previous == STORE_FIELD)) {
     if (previous == STORE_LOCAL) {
       builder_[last_pos] = STORE_LOCAL_POP;
+      // Fuse an addition or subtraction that is directly stored into
+      // a local, like for 'x += y', into a superinstruction.
+      auto before = previous_opcode(1);
+      if ((before == INVOKE_ADD || before == INVOKE_SUB) && !Flags::no_superinstructions) {
+        unsigned before_pos = opcode_positions_[opcode_positions_.length() - 2];
+        builder_[before_pos] = (before == INVOKE_ADD)
+            ? INVOKE_ADD_STORE_LOCAL_POP
+            : INVOKE_SUB_STORE_LOCAL_POP;
+      }
     } else if (previous == STORE_FIELD) {
       builder_[last_pos] = STORE_FIELD_POP;
     }
@@ -461,6 +471,17 @@ void Emitter::branch(Condition condition, Label* label) {
     stack_.pop();
   }
 
+  if (op == BRANCH_IF_FALSE) {
+    // Fuse a comparison that is directly followed by the branch into
+    // a superinstruction. The branch itself stays in place.
+    static_assert(INVOKE_GTE - INVOKE_EQ == INVOKE_GTE_BRANCH_IF_FALSE - INVOKE_EQ_BRANCH_IF_FALSE,
+                  "Unexpected order of the relational bytecodes");
+    auto previous = previous_opcode();
+    if (previous >= INVOKE_EQ && previous <= INVOKE_GTE && !Flags::no_superinstructions) {
+      builder_[opcode_positions_.last()] = INVOKE_EQ_BRANCH_IF_FALSE + (previous - INVOKE_EQ);
+    }
+  }
+
   int position = this->position();
   if (label->is_bound()) {
     int offset = -(label->position() - position);
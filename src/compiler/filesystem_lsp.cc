@@ -67,6 +67,27 @@ void FilesystemLsp::list_directory_entries(const char* path,
   protocol_->list_directory_entries(path, callback);
 }
 
+void FilesystemLsp::clear_cache() {
+  for (auto& entry : file_cache_.underlying_map()) {
+    free(const_cast<uint8*>(entry.second.content));
+  }
+  file_cache_.clear();
+}
+
+void FilesystemLsp::clear_cache(const std::vector<std::string>& changed_paths) {
+  std::vector<std::string> forgotten;
+  for (auto& entry : file_cache_.underlying_map()) {
+    if (!entry.second.is_regular_file) forgotten.push_back(entry.first);
+  }
+  forgotten.insert(forgotten.end(), changed_paths.begin(), changed_paths.end());
+  for (auto& path : forgotten) {
+    auto probe = file_cache_.find(path);
+    if (probe == file_cache_.end()) continue;
+    free(const_cast<uint8*>(probe->second.content));
+    file_cache_.remove(path);
+  }
+}
+
 LspFsProtocol::PathInfo FilesystemLsp::info_for(const char* path) {
   std::string lookup_key(path);
   auto probe = file_cache_.find(lookup_key);
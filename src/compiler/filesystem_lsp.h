@@ -62,6 +62,20 @@ class FilesystemLsp : public Filesystem {
     return path[0] == '/' && path[1] == '\0';
   }
 
+  /// Forgets the files that were fetched from the language server, and frees
+  /// their content.
+  /// Used by long-lived compilers between requests, so that the next request
+  /// sees the current content of the files. The source manager must keep its
+  /// own copies of the files (see `SourceManager::revalidate`).
+  void clear_cache();
+
+  /// Variant of `clear_cache` that only forgets the given changed files.
+  ///
+  /// The content of the other regular files stays cached. Paths that didn't
+  /// exist, or weren't regular files, are always forgotten, as they are
+  /// cheap to fetch again and might have been created since.
+  void clear_cache(const std::vector<std::string>& changed_paths);
+
 
  protected:
   bool do_exists(const char* path);
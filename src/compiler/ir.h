@@ -584,6 +584,11 @@ class Method : public Node {
     return resolution_shape_;
   }
 
+  /// Whether this method still uses its resolution shape.
+  ///
+  /// Methods switch to a plain shape when the program is lowered.
+  bool uses_resolution_shape() const { return use_resolution_shape_; }
+
   /// The unique shape of this method.
   ///
   /// This shape does not contain any optional parameters anymore.
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "../utils.h"
+#include "arena.h"
 
 namespace toit {
 namespace compiler {
@@ -69,6 +70,12 @@ class ListBuilder {
   }
 
   static List<T> allocate(int length) {
+    Arena* arena = Arena::current();
+    if (arena != null) {
+      T* data = static_cast<T*>(arena->allocate(length * sizeof(T)));
+      for (int i = 0; i < length; i++) new (&data[i]) T();
+      return List<T>(data, length);
+    }
     T* data = _new T[length]();
     return List<T>(data, length);
   }
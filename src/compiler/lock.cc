@@ -137,7 +137,16 @@ std::string find_lock_file_at(const char* dir,
 // Searches for the lock file starting at [source_path].
 std::string find_lock_file(const char* source_path,
                            Filesystem* fs) {
-  if (SourceManager::is_virtual_file(source_path)) return "";
+  for (auto& path : lock_file_search_paths(source_path, fs)) {
+    if (fs->exists(path.c_str())) return path;
+  }
+  return "";
+}
+
+std::vector<std::string> lock_file_search_paths(const char* source_path,
+                                                Filesystem* fs) {
+  std::vector<std::string> result;
+  if (SourceManager::is_virtual_file(source_path)) return result;
 
   PathBuilder builder(fs);
   if (!fs->is_absolute(source_path)) {
@@ -155,12 +164,10 @@ std::string find_lock_file(const char* source_path,
     if (fs->is_path_separator(builder[i])) {
       builder.reset_to(i + 1);
       builder.join(LOCK_FILE);
-      if (fs->exists(builder.c_str())) {
-        return builder.buffer();
-      }
+      result.push_back(builder.buffer());
     }
   }
-  return "";
+  return result;
 }
 
 static std::string build_canonical_sdk_dir(Filesystem* fs) {
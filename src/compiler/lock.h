@@ -17,6 +17,7 @@
 
 #include <string>
 #include <functional>
+#include <vector>
 
 #include "../top.h"
 
@@ -107,6 +108,11 @@ std::string find_lock_file(const char* source_path,
 std::string find_lock_file_at(const char* dir,
                              Filesystem* fs);
 
+/// Returns the paths at which `find_lock_file` looks for a lock file for the
+/// [source_path], in the order in which they are tried.
+std::vector<std::string> lock_file_search_paths(const char* source_path,
+                                                Filesystem* fs);
+
 const char* compute_package_cache_path_from_home(const char* home, Filesystem* fs);
 
 } // namespace toit::compiler
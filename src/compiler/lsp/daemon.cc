@@ -0,0 +1,194 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "daemon.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#ifdef TOIT_POSIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "multiplex_stdout.h"
+#include "../../sha.h"
+#include "../arena.h"
+#include "../ast.h"
+#include "../sources.h"
+
+namespace toit {
+namespace compiler {
+
+void LspDaemon::start_request() {
+  used_units_.clear();
+  request_key_.clear();
+  request_signal_ = 0;
+  reused_units_ = 0;
+  parsed_units_ = 0;
+  replayed_ = false;
+}
+
+void LspDaemon::finish_request(SourceManager* source_manager) {
+  for (auto arena : request_arenas_) delete arena;
+  request_arenas_.clear();
+  for (auto source : source_manager->take_replaced_sources()) {
+    drop_outputs_depending_on(source->absolute_path());
+    auto probe = units_.find(source);
+    if (probe != units_.end()) {
+      delete probe->second.arena;
+      units_.remove(source);
+    }
+    source_manager->release(source);
+  }
+}
+
+void LspDaemon::drop_outputs_depending_on(const std::string& path) {
+  // The paths of an output are the import closure of the request's entries,
+  // so this drops the outputs of all files that import the path, directly or
+  // transitively.
+  for (auto it = outputs_.begin(); it != outputs_.end();) {
+    auto& paths = it->second.paths;
+    if (std::find(paths.begin(), paths.end(), path) != paths.end()) {
+      it = outputs_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+ast::Unit* LspDaemon::lookup(Source* source) {
+  auto probe = units_.find(source);
+  auto unit = probe == units_.end() ? null : probe->second.unit;
+  // A request that asks twice for the same source (for example when the
+  // entry is the core library) must get two different units.
+  if (unit == null || used_units_.contains(unit)) {
+    parsed_units_++;
+    return null;
+  }
+  used_units_.insert(unit);
+  reused_units_++;
+  // The imports still point to the units of the last request that used
+  // this unit, which might have changed since.
+  for (auto import : unit->imports()) {
+    import->set_unit(null);
+  }
+  return unit;
+}
+
+void LspDaemon::add(Source* source, ast::Unit* unit, Arena* arena, bool cacheable) {
+  if (cacheable && !units_.contains_key(source)) {
+    units_[source] = { .unit = unit, .arena = arena };
+  } else {
+    request_arenas_.push_back(arena);
+  }
+  used_units_.insert(unit);
+}
+
+bool LspDaemon::replay_or_fork_request(const std::vector<ast::Unit*>& units, bool cacheable) {
+  if (is_request_process_) return true;
+  if (!cacheable || request_key_.empty()) return fork_request(null);
+  std::string key = request_key_;
+  std::vector<std::string> paths;
+  for (auto unit : units) {
+    auto source = unit->source();
+    if (source == null || source->content_hash() == null) return fork_request(null);
+    key += '\n';
+    key += source->absolute_path();
+    key += '\n';
+    key += source->error_path();
+    key += '\n';
+    auto hash = source->content_hash();
+    for (int i = 0; i < Sha::HASH_LENGTH_256; i++) {
+      char hex[3];
+      snprintf(hex, sizeof(hex), "%02x", hash[i]);
+      key += hex;
+    }
+    paths.push_back(source->absolute_path());
+  }
+  auto probe = outputs_.find(key);
+  if (probe != outputs_.end()) {
+    writer_->write_raw(probe->second.bytes);
+    replayed_ = true;
+    return false;
+  }
+  Output output;
+  output.paths = std::move(paths);
+  if (fork_request(&output.bytes)) return true;
+  // Only keep the output of requests that ran to completion.
+  if (request_status_ == 0) {
+    if (outputs_.size() >= MAX_OUTPUTS) outputs_.clear();
+    outputs_[key] = std::move(output);
+  }
+  return false;
+}
+
+bool LspDaemon::fork_request(std::string* output) {
+  if (is_request_process_) return true;
+#ifdef TOIT_POSIX
+  int fds[2] = { -1, -1 };
+  if (output != null && pipe(fds) == -1) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+  // Otherwise both processes would write the buffered output.
+  fflush(stdout);
+  int pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    is_request_process_ = true;
+    if (output != null) {
+      close(fds[0]);
+      writer_->set_tee(fds[1]);
+    }
+    return true;
+  }
+  if (output != null) {
+    close(fds[1]);
+    // The request process blocks once the pipe is full, so the output must
+    // be read before waiting for the process.
+    char buffer[4096];
+    while (true) {
+      int read_bytes = read(fds[0], buffer, sizeof(buffer));
+      if (read_bytes == 0) break;
+      if (read_bytes == -1) {
+        if (errno == EINTR) continue;
+        perror("read");
+        exit(EXIT_FAILURE);
+      }
+      output->append(buffer, read_bytes);
+    }
+    close(fds[0]);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR) {
+      perror("wait");
+      exit(EXIT_FAILURE);
+    }
+  }
+  request_signal_ = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+  request_status_ = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return false;
+#else
+  FATAL("fork not supported");
+#endif
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,162 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../top.h"
+
+#include "../list.h"
+#include "../map.h"
+#include "../set.h"
+#include "../symbol_canonicalizer.h"
+
+namespace toit {
+namespace compiler {
+
+namespace ast {
+class Unit;
+}
+class Arena;
+class Source;
+class SourceManager;
+struct LspWriterMultiplexStdout;
+
+/// The state a long-lived language-server compiler keeps between requests.
+///
+/// The daemon handles one request after the other. It loads and parses the
+/// units of a request itself, and then forks a process that finishes the
+/// request. The language-server pipelines exit as soon as they have their
+/// answer, and the resolver and the later passes modify the parsed units in
+/// place, so everything after parsing must happen in a process of its own.
+///
+/// Parsed units are cached by their source. The source manager keeps the
+/// source of a path as long as the hash of the file's content doesn't change
+/// (see `SourceManager::revalidate`), so unchanged files hit the cache. The
+/// symbols of cached units stay valid, as all requests share the daemon's
+/// symbol canonicalizer. Each cached unit lives in an arena of its own, which
+/// is freed, together with the source, once the file changed.
+///
+/// The daemon also keeps the output of analysis requests, keyed by the
+/// request and the content hashes of all units the request loaded (the
+/// import closure of its entries). A request with the same key replays the
+/// output without resolving again. When a file changes, all outputs that
+/// depend on it, that is, the ones of the files that import it directly or
+/// transitively, are dropped.
+class LspDaemon {
+ public:
+  explicit LspDaemon(LspWriterMultiplexStdout* writer) : writer_(writer) {}
+
+  /// Prepares the cache for a new request.
+  void start_request();
+
+  /// Frees the memory of the current request, and the units whose sources
+  /// were replaced.
+  void finish_request(SourceManager* source_manager);
+
+  SymbolCanonicalizer* symbols() { return &symbols_; }
+
+  /// Returns the cached unit for the given source, or null.
+  ///
+  /// The imports of the returned unit are not yet resolved to units.
+  ast::Unit* lookup(Source* source);
+
+  /// Takes the given unit, and the arena it was parsed in.
+  ///
+  /// The unit is only cached if it is [cacheable]. Units that were parsed
+  /// with a diagnostic must not be cached, as the diagnostics of a cache hit
+  /// would be lost. Otherwise the arena is freed once the request is done.
+  void add(Source* source, ast::Unit* unit, Arena* arena, bool cacheable);
+
+  /// Sets the key of the current request, if its output only depends on the
+  /// request and the content of the files it loads.
+  void set_request_key(const std::string& key) { request_key_ = key; }
+
+  /// Forks the process that finishes the current request.
+  ///
+  /// Returns true in the new process, and if this already is the process of
+  /// a request.
+  /// Otherwise waits for the request process to terminate and returns false.
+  bool fork_request() { return fork_request(null); }
+
+  /// Variant of `fork_request` that replays the output of an earlier request
+  /// with the same key and the same [units].
+  ///
+  /// Only requests that have a key and reported no diagnostic yet may be
+  /// [cacheable]. If there is no earlier output, the output of the request
+  /// process is kept for later requests.
+  bool replay_or_fork_request(const std::vector<ast::Unit*>& units, bool cacheable);
+
+  bool is_request_process() const { return is_request_process_; }
+
+  /// The signal that terminated the process of the current request, or 0.
+  int request_signal() const { return request_signal_; }
+
+  /// The number of units of the current request that came from the cache,
+  /// and the number that had to be parsed.
+  ///
+  /// Only counts the units that were loaded in the daemon itself, and not
+  /// the ones of the request process.
+  int reused_units() const { return reused_units_; }
+  int parsed_units() const { return parsed_units_; }
+
+  /// Whether the output of the current request was replayed.
+  bool replayed() const { return replayed_; }
+
+ private:
+  // The outputs of earlier requests are dropped when there are more than
+  // this many.
+  static const int MAX_OUTPUTS = 64;
+
+  struct CachedUnit {
+    ast::Unit* unit;
+    Arena* arena;
+  };
+
+  struct Output {
+    std::string bytes;
+    // The paths of the units the request loaded.
+    std::vector<std::string> paths;
+  };
+
+  LspWriterMultiplexStdout* writer_;
+  SymbolCanonicalizer symbols_;
+  UnorderedMap<Source*, CachedUnit> units_;
+  // The units that were handed out for the current request.
+  UnorderedSet<ast::Unit*> used_units_;
+  // The arenas of the units of the current request that aren't cached.
+  std::vector<Arena*> request_arenas_;
+  std::unordered_map<std::string, Output> outputs_;
+  std::string request_key_;
+  bool is_request_process_ = false;
+  int request_signal_ = 0;
+  // The exit status of the process of the current request, or -1 if it
+  // was terminated by a signal.
+  int request_status_ = 0;
+  int reused_units_ = 0;
+  int parsed_units_ = 0;
+  bool replayed_ = false;
+
+  // Variant of `fork_request` that also stores the output of the request
+  // process in [output].
+  bool fork_request(std::string* output);
+  void drop_outputs_depending_on(const std::string& path);
+};
+
+} // namespace toit::compiler
+} // namespace toit
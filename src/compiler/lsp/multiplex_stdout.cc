@@ -15,7 +15,11 @@
 
 #include "multiplex_stdout.h"
 
+#include <errno.h>
 #include <stdio.h>
+#ifdef TOIT_POSIX
+#include <unistd.h>
+#endif
 
 namespace toit {
 namespace compiler {
@@ -27,25 +31,67 @@ static void checked_fwrite(const void* data,
   if (written_bytes != size) FATAL(error_message);
 }
 
+static void checked_tee_write(int fd, const void* data, int size) {
+#ifdef TOIT_POSIX
+  auto bytes = static_cast<const uint8*>(data);
+  while (size > 0) {
+    int written_bytes = ::write(fd, bytes, size);
+    if (written_bytes == -1) {
+      if (errno == EINTR) continue;
+      perror("LspWriterMultiplexStdout::write/tee");
+      FATAL("Couldn't write data");
+    }
+    bytes += written_bytes;
+    size -= written_bytes;
+  }
+#else
+  FATAL("Teeing not supported");
+#endif
+}
+
 void LspWriterMultiplexStdout::printf(const char* format, va_list& arguments) {
   va_list copy;
   va_copy(copy, arguments);
-  int32 needed_bytes = static_cast<int32>(vsnprintf(null, 0, format, arguments));
-  checked_fwrite(&needed_bytes, sizeof(needed_bytes));
-  int written_bytes = vprintf(format, copy);
-  if (written_bytes < 0) {
-    perror("LspWriterMultiplexStdout::printf/vprintf");
+  int needed_bytes = vsnprintf(null, 0, format, arguments);
+  if (needed_bytes < 0) {
+    perror("LspWriterMultiplexStdout::printf/vsnprintf");
+    FATAL("Couldn't format data");
   }
+  auto buffer = unvoid_cast<char*>(malloc(needed_bytes + 1));
+  int written_bytes = vsnprintf(buffer, needed_bytes + 1, format, copy);
+  va_end(copy);
   if (written_bytes != needed_bytes) {
     fprintf(stderr, "Written %d, needed: %d, format: %s\n", written_bytes, needed_bytes, format);
-    FATAL("Unexpected vprintf return value. Write failed?");
+    FATAL("Unexpected vsnprintf return value");
   }
+  write(reinterpret_cast<const uint8*>(buffer), needed_bytes);
+  free(buffer);
 }
 
 void LspWriterMultiplexStdout::write(const uint8* data, int size) {
   int32 size32 = static_cast<int32>(size);
   checked_fwrite(&size32, sizeof(size32));
   checked_fwrite(data, size);
+  if (tee_fd_ != -1) {
+    checked_tee_write(tee_fd_, &size32, sizeof(size32));
+    checked_tee_write(tee_fd_, data, size);
+  }
+}
+
+void LspWriterMultiplexStdout::write_raw(const std::string& frames) {
+  checked_fwrite(frames.data(), frames.size());
+}
+
+void LspWriterMultiplexStdout::end_request(int signal, int reused_units, int parsed_units, bool replayed) {
+  int32 data[] = {
+    END_OF_REQUEST,
+    static_cast<int32>(signal),
+    static_cast<int32>(reused_units),
+    static_cast<int32>(parsed_units),
+    replayed ? 1 : 0,
+  };
+  checked_fwrite(data, sizeof(data));
+  fflush(stdout);
 }
 
 void LspFsConnectionMultiplexStdout::putline(const char* line) {
@@ -28,10 +28,28 @@ namespace compiler {
 /// When sending data, then the messages are prefixed with the length of the
 /// message. However, the LspFsConnection negates the size first, so that
 /// the LSP server can figure out which protocol is currently used.
+/// A long-lived compiler (see `LspDaemon`) terminates each request with a
+/// frame of size `END_OF_REQUEST`, followed by the signal that terminated the
+/// request process (or 0), the number of units it reused, the number of
+/// units it parsed, and whether the output was replayed from an earlier
+/// request (1) or not (0).
 
 struct LspWriterMultiplexStdout : public LspWriter {
+  static const int32 END_OF_REQUEST = INT32_MIN;
+
   void printf(const char* format, va_list& arguments);
   void write(const uint8* data, int size);
+  void end_request(int signal, int reused_units, int parsed_units, bool replayed);
+
+  /// Also writes all frames to the given file descriptor, so the daemon can
+  /// keep the output of a request.
+  void set_tee(int fd) { tee_fd_ = fd; }
+
+  /// Writes frames that were captured with `set_tee` before.
+  void write_raw(const std::string& frames);
+
+ private:
+  int tee_fd_ = -1;
 };
 
 struct LspFsConnectionMultiplexStdout : public LspFsConnection {
@@ -0,0 +1,253 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "inline.h"
+
+namespace toit {
+namespace compiler {
+
+using namespace ir;
+
+// The number of IR nodes an inlined body may have in addition to the
+// number of arguments of the call.  Pushing the arguments and invoking the
+// method takes a few bytes per argument, so bodies within the budget don't
+// make the caller bigger.
+static const int STRAIGHT_LINE_BUDGET = 2;
+// Calls in loops and blocks are likely to run often, so we accept that
+// inlining makes the caller somewhat bigger there.
+static const int LOOP_BUDGET = 8;
+
+static bool is_simple_literal(Expression* node) {
+  return node->is_LiteralNull() ||
+      node->is_LiteralBoolean() ||
+      node->is_LiteralInteger() ||
+      node->is_LiteralFloat();
+}
+
+// Returns the parameter of the method that the node refers to, or null.
+static Parameter* parameter_of(Expression* node, Method* method) {
+  if (!node->is_ReferenceLocal()) return null;
+  auto reference = node->as_ReferenceLocal();
+  if (reference->is_block() || reference->block_depth() != 0) return null;
+  auto target = reference->target();
+  if (!target->is_Parameter()) return null;
+  auto parameter = target->as_Parameter();
+  auto parameters = method->parameters();
+  int index = parameter->index();
+  if (index < 0 || index >= parameters.length()) return null;
+  if (parameters[index] != parameter) return null;
+  return parameter;
+}
+
+// Returns the number of nodes in the given expression, or -1 if the
+// expression could have side effects, throw, or call other methods, or if
+// it has more than `budget` nodes.
+static int size_of(Expression* node, Method* method, int budget) {
+  if (budget <= 0) return -1;
+  if (is_simple_literal(node)) return 1;
+  if (node->is_ReferenceLocal()) {
+    return parameter_of(node, method) == null ? -1 : 1;
+  }
+  if (node->is_FieldLoad()) {
+    auto load = node->as_FieldLoad();
+    // Only fields of `this`, which is never null in an instance method.
+    if (load->is_box_load() || !method->is_instance()) return -1;
+    auto receiver = parameter_of(load->receiver(), method);
+    if (receiver == null || receiver->index() != 0) return -1;
+    return 2;
+  }
+  if (node->is_Not()) {
+    int value = size_of(node->as_Not()->value(), method, budget - 1);
+    return value < 0 ? -1 : value + 1;
+  }
+  if (node->is_LogicalBinary()) {
+    auto binary = node->as_LogicalBinary();
+    int left = size_of(binary->left(), method, budget - 1);
+    if (left < 0) return -1;
+    int right = size_of(binary->right(), method, budget - 1 - left);
+    return right < 0 ? -1 : left + right + 1;
+  }
+  if (node->is_If()) {
+    auto node_if = node->as_If();
+    int condition = size_of(node_if->condition(), method, budget - 1);
+    if (condition < 0) return -1;
+    int yes = size_of(node_if->yes(), method, budget - 1 - condition);
+    if (yes < 0) return -1;
+    int no = size_of(node_if->no(), method, budget - 1 - condition - yes);
+    return no < 0 ? -1 : condition + yes + no + 1;
+  }
+  return -1;
+}
+
+// Returns the value the given body returns, or null if the body does
+// anything else.
+// The return peephole pushes returns into ifs, so `return c ? a : b` comes
+// as an if with a return in each branch.
+static Expression* returned_value(Expression* body) {
+  if (body->is_Sequence()) {
+    auto expressions = body->as_Sequence()->expressions();
+    // Anything after the first return is dead.
+    if (expressions.is_empty()) return null;
+    return returned_value(expressions[0]);
+  }
+  if (body->is_Return()) {
+    auto ret = body->as_Return();
+    if (ret->depth() != -1) return null;
+    return ret->value();
+  }
+  if (body->is_If()) {
+    auto body_if = body->as_If();
+    auto yes = returned_value(body_if->yes());
+    if (yes == null) return null;
+    auto no = returned_value(body_if->no());
+    if (no == null) return null;
+    return _new If(body_if->condition(), yes, no, body_if->range());
+  }
+  return null;
+}
+
+// Copies the given expression from the body of the method, replacing the
+// references to the parameters with the arguments of the call.
+// The copies get the range of the call, so the source map attributes them
+// to the call site.
+static Expression* copy_literal(Expression* node, const Source::Range& range) {
+  if (node->is_LiteralNull()) return _new LiteralNull(range);
+  if (node->is_LiteralBoolean()) return _new LiteralBoolean(node->as_LiteralBoolean()->value(), range);
+  if (node->is_LiteralInteger()) return _new LiteralInteger(node->as_LiteralInteger()->value(), range);
+  ASSERT(node->is_LiteralFloat());
+  return _new LiteralFloat(node->as_LiteralFloat()->value(), range);
+}
+
+// Copies the argument of the call.  The arguments are trivial (see
+// `is_trivial_argument`), and refer to the locals of the caller, so they are
+// not instantiated again.
+static Expression* copy_argument(Expression* argument, const Source::Range& range) {
+  if (argument->is_ReferenceLocal()) {
+    auto reference = argument->as_ReferenceLocal();
+    return _new ReferenceLocal(reference->target(), reference->block_depth(), range);
+  }
+  return copy_literal(argument, range);
+}
+
+static Expression* instantiate(Expression* node, Method* method, CallStatic* call) {
+  auto range = call->range();
+  if (node->is_ReferenceLocal()) {
+    auto parameter = parameter_of(node, method);
+    ASSERT(parameter != null);
+    return copy_argument(call->arguments()[parameter->index()], range);
+  }
+  if (is_simple_literal(node)) return copy_literal(node, range);
+  if (node->is_FieldLoad()) {
+    auto load = node->as_FieldLoad();
+    return _new FieldLoad(instantiate(load->receiver(), method, call), load->field(), range);
+  }
+  if (node->is_Not()) {
+    return _new Not(instantiate(node->as_Not()->value(), method, call), range);
+  }
+  if (node->is_LogicalBinary()) {
+    auto binary = node->as_LogicalBinary();
+    return _new LogicalBinary(instantiate(binary->left(), method, call),
+                              instantiate(binary->right(), method, call),
+                              binary->op(),
+                              range);
+  }
+  ASSERT(node->is_If());
+  auto node_if = node->as_If();
+  return _new If(instantiate(node_if->condition(), method, call),
+                 instantiate(node_if->yes(), method, call),
+                 instantiate(node_if->no(), method, call),
+                 range);
+}
+
+// Arguments are copied into the inlined body, possibly more than once, so
+// they must be cheap to evaluate and have no side effects.
+static bool is_trivial_argument(Expression* node) {
+  if (is_simple_literal(node)) return true;
+  if (node->is_ReferenceLocal()) return !node->as_ReferenceLocal()->is_block();
+  return false;
+}
+
+static Expression* inline_call(CallStatic* call, bool is_hot) {
+  if (call->is_Lambda() || call->is_CallConstructor()) return call;
+  Method* method = call->target()->target();
+  if (method->is_dead() || method->is_runtime_method() || !method->has_body()) return call;
+  if (!method->is_instance() && !method->is_global_fun()) return call;
+
+  auto arguments = call->arguments();
+  if (arguments.length() != method->parameters().length()) return call;
+  for (auto argument : arguments) {
+    if (!is_trivial_argument(argument)) return call;
+  }
+
+  auto value = returned_value(method->body());
+  if (value == null) return call;
+  int budget = arguments.length() + (is_hot ? LOOP_BUDGET : STRAIGHT_LINE_BUDGET);
+  if (size_of(value, method, budget) < 0) return call;
+  // Field loads need a receiver that we can load more than once.
+  if (method->is_instance() && !arguments[0]->is_ReferenceLocal()) return call;
+  return instantiate(value, method, call);
+}
+
+class InliningVisitor : public ReplacingVisitor {
+ public:
+  Node* visit_Method(Method* node) {
+    if (node->is_dead()) return node;
+    return ReplacingVisitor::visit_Method(node);
+  }
+
+  Node* visit_While(While* node) {
+    loop_depth_++;
+    Node* result = ReplacingVisitor::visit_While(node);
+    loop_depth_--;
+    return result;
+  }
+
+  // Blocks are typically called repeatedly, so we treat their bodies
+  // like the bodies of loops.
+  Node* visit_Code(Code* node) {
+    loop_depth_++;
+    Node* result = ReplacingVisitor::visit_Code(node);
+    loop_depth_--;
+    return result;
+  }
+
+  Node* visit_CallStatic(CallStatic* node) {
+    node = ReplacingVisitor::visit_CallStatic(node)->as_CallStatic();
+    return inline_call(node, loop_depth_ > 0);
+  }
+
+ private:
+  int loop_depth_ = 0;
+};
+
+void inline_calls(Program* program) {
+  InliningVisitor visitor;
+  for (auto klass : program->classes()) {
+    for (auto method : klass->methods()) {
+      visitor.visit(method);
+    }
+  }
+  // The constructors, factories and static methods of classes are in the
+  // program's methods.
+  for (auto method : program->methods()) {
+    visitor.visit(method);
+  }
+  for (auto global : program->globals()) {
+    visitor.visit(global);
+  }
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,29 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "../ir.h"
+
+namespace toit {
+namespace compiler {
+
+/// Replaces static calls to small methods with the value the method returns.
+/// Only methods that can't throw or call other methods are inlined, so
+///   the stack traces stay the same.
+void inline_calls(ir::Program* program);
+
+} // namespace toit::compiler
+} // namespace toit
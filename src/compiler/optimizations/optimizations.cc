@@ -17,6 +17,7 @@
 
 #include "constant_propagation.h"
 #include "dead_code.h"
+#include "inline.h"
 #include "virtual_call.h"
 #include "return_peephole.h"
 #include "simplify_sequence.h"
@@ -204,6 +205,11 @@ void optimize(Program* program, TypeOracle* oracle) {
   for (auto global : program->globals()) {
     visitor.visit(global);
   }
+
+  // Inlining only pays off once the propagated types have removed the
+  // parameter and return checks from the small methods, so we only inline
+  // in the last round of optimizations.
+  if (oracle->is_finalized()) inline_calls(program);
 }
 
 
@@ -0,0 +1,149 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "parallel_parser.h"
+
+#include "ast.h"
+#include "diagnostic.h"
+#include "parser.h"
+#include "scanner.h"
+#include "symbol_canonicalizer.h"
+#include "../flags.h"
+#include "../os.h"
+
+namespace toit {
+namespace compiler {
+
+// The parser is recursive, and the stacks of secondary threads are small
+// on some platforms.
+static const int PARSER_STACK_SIZE = 8 * MB;
+
+class ParserThread : public Thread {
+ public:
+  ParserThread(ParallelParser* parser, SymbolCanonicalizer* symbols)
+      : Thread("Parser")
+      , parser_(parser)
+      , symbols_(symbols) {}
+
+ protected:
+  void entry() {
+    parser_->run_thread(symbols_);
+  }
+
+ private:
+  ParallelParser* parser_;
+  SymbolCanonicalizer* symbols_;
+};
+
+ParallelParser::ParallelParser(SymbolCanonicalizer* symbols, int thread_count)
+    : thread_count_(thread_count)
+    , mutex_(OS::allocate_mutex(101, "ParallelParser"))
+    , batch_started_(OS::allocate_condition_variable(mutex_))
+    , batch_finished_(OS::allocate_condition_variable(mutex_)) {
+  ASSERT(thread_count >= 1);
+  for (int i = 0; i < thread_count; i++) {
+    thread_symbols_.push_back(_new SymbolCanonicalizer(symbols));
+  }
+}
+
+ParallelParser::~ParallelParser() {
+  {
+    Locker locker(mutex_);
+    is_shutting_down_ = true;
+    OS::signal_all(batch_started_);
+  }
+  for (auto thread : threads_) {
+    thread->join();
+    delete thread;
+  }
+  OS::dispose(batch_finished_);
+  OS::dispose(batch_started_);
+  OS::dispose(mutex_);
+}
+
+int ParallelParser::default_thread_count() {
+  if (Flags::parser_threads > 0) return Flags::parser_threads;
+  int cores = OS::num_cores();
+  return cores < 1 ? 1 : cores;
+}
+
+std::vector<ast::Unit*> ParallelParser::parse(const std::vector<Source*>& sources,
+                                              const std::vector<BufferedDiagnostics*>& diagnostics) {
+  ASSERT(sources.size() == diagnostics.size());
+  {
+    Locker locker(mutex_);
+    sources_ = &sources;
+    diagnostics_ = &diagnostics;
+    units_ = std::vector<ast::Unit*>(sources.size(), null);
+    next_index_ = 0;
+
+    int thread_count = thread_count_;
+    if (static_cast<size_t>(thread_count) > sources.size()) thread_count = sources.size();
+    // The current thread is one of the workers. The other threads stay
+    // alive for the next batches.
+    while (static_cast<int>(threads_.size()) < thread_count - 1) {
+      auto thread = _new ParserThread(this, thread_symbols_[threads_.size() + 1]);
+      thread->spawn(PARSER_STACK_SIZE);
+      threads_.push_back(thread);
+    }
+    batch_++;
+    OS::signal_all(batch_started_);
+  }
+  work(thread_symbols_[0]);
+
+  Locker locker(mutex_);
+  while (busy_threads_ > 0) OS::wait(batch_finished_);
+  sources_ = null;
+  diagnostics_ = null;
+  std::vector<ast::Unit*> result;
+  result.swap(units_);
+  return result;
+}
+
+void ParallelParser::run_thread(SymbolCanonicalizer* symbols) {
+  int last_batch = 0;
+  Locker locker(mutex_);
+  while (true) {
+    while (batch_ == last_batch && !is_shutting_down_) OS::wait(batch_started_);
+    if (is_shutting_down_) return;
+    last_batch = batch_;
+    busy_threads_++;
+    {
+      Unlocker unlocker(locker);
+      work(symbols);
+    }
+    if (--busy_threads_ == 0) OS::signal_all(batch_finished_);
+  }
+}
+
+void ParallelParser::work(SymbolCanonicalizer* symbols) {
+  while (true) {
+    size_t index;
+    {
+      Locker locker(mutex_);
+      // A thread that wakes up late might find the batch already done.
+      if (sources_ == null || next_index_ == sources_->size()) return;
+      index = next_index_++;
+    }
+    auto source = (*sources_)[index];
+    auto diagnostics = (*diagnostics_)[index];
+    Scanner scanner(source, symbols, diagnostics);
+    Parser parser(source, &scanner, diagnostics);
+    units_[index] = parser.parse_unit();
+  }
+}
+
+} // namespace toit::compiler
+} // namespace toit
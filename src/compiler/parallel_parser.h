@@ -0,0 +1,89 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include <vector>
+
+#include "../top.h"
+
+namespace toit {
+
+class ConditionVariable;
+class Mutex;
+
+namespace compiler {
+
+namespace ast {
+class Unit;
+}
+class BufferedDiagnostics;
+class ParserThread;
+class Source;
+class SymbolCanonicalizer;
+
+/// Parses sources on multiple threads.
+///
+/// Every thread has its own symbol canonicalizer that forwards new
+///   identifiers to the shared one. The diagnostics are collected for each
+///   source, so that the caller can report them in a deterministic order.
+/// The threads are started when they are first needed, and wait for the
+///   next call to `parse` until the parser is deleted.
+class ParallelParser {
+ public:
+  ParallelParser(SymbolCanonicalizer* symbols, int thread_count);
+  ~ParallelParser();
+
+  /// The number of threads to use when parsing.
+  ///
+  /// This is the `parser_threads` flag if it is set, and the number of
+  ///   cores otherwise.
+  static int default_thread_count();
+
+  /// Parses the given sources.
+  ///
+  /// Returns the units in the same order as the sources. The diagnostics of
+  ///   each source are reported to the [diagnostics] at the same index.
+  std::vector<ast::Unit*> parse(const std::vector<Source*>& sources,
+                                const std::vector<BufferedDiagnostics*>& diagnostics);
+
+ private:
+  int thread_count_;
+  std::vector<SymbolCanonicalizer*> thread_symbols_;
+  std::vector<ParserThread*> threads_;
+  Mutex* mutex_;
+  // Signaled when a call to `parse` has sources for the threads, and when
+  // the parser is deleted.
+  ConditionVariable* batch_started_;
+  // Signaled when the last thread stops working on the current sources.
+  ConditionVariable* batch_finished_;
+  int batch_ = 0;
+  int busy_threads_ = 0;
+  bool is_shutting_down_ = false;
+
+  // The state of the current call to `parse`.
+  const std::vector<Source*>* sources_ = null;
+  const std::vector<BufferedDiagnostics*>* diagnostics_ = null;
+  std::vector<ast::Unit*> units_;
+  size_t next_index_ = 0;
+
+  void run_thread(SymbolCanonicalizer* symbols);
+  void work(SymbolCanonicalizer* symbols);
+
+  friend class ParserThread;
+};
+
+} // namespace toit::compiler
+} // namespace toit
@@ -73,7 +73,7 @@ void TypeDatabase::check_return(uint8* bcp, Object* value) const {
   // propagator allow any value as the top stack element here,
   // but it would achieve the same things as this check.
   uint8 opcode = *bcp;
-  if (opcode > HALT) return;
+  if (opcode >= INTRINSIC_SMI_REPEAT && opcode <= INTRINSIC_HASH_DO) return;
 
   int position = program_->absolute_bci_from_bcp(bcp);
   auto probe = returns_.find(position);
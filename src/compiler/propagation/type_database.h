@@ -91,6 +91,9 @@ class TypeOracle {
   void seed(ir::Program* program);
   void finalize(ir::Program* program, TypeDatabase* types);
 
+  // Whether the oracle has the propagated types of the program.
+  bool is_finalized() const { return types_ != null; }
+
   // Helpers for optimization phase.
   bool is_dead(ir::Method* method) const;
   bool is_dead(ir::Code* code) const;
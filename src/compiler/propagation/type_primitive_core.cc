@@ -234,6 +234,9 @@ TYPE_PRIMITIVE_BOOL(remove_finalizer)
 TYPE_PRIMITIVE_BYTE_ARRAY(create_off_heap_byte_array)  // TODO(kasper): Should we try to get rid of this?
 TYPE_PRIMITIVE_INT(crc)
 TYPE_PRIMITIVE_SMI(gc_count)
+TYPE_PRIMITIVE_NULL(gc_events_enable)
+TYPE_PRIMITIVE_ARRAY(gc_events)
+TYPE_PRIMITIVE_ARRAY(gc_pause_histogram)
 TYPE_PRIMITIVE_SMI(process_current_id)
 TYPE_PRIMITIVE_BOOL(process_signal_kill)
 TYPE_PRIMITIVE_SMI(process_get_priority)
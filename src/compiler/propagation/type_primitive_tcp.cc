@@ -27,7 +27,10 @@ TYPE_PRIMITIVE_ANY(connect)
 TYPE_PRIMITIVE_ANY(accept)
 TYPE_PRIMITIVE_ANY(listen)
 TYPE_PRIMITIVE_ANY(write)
+TYPE_PRIMITIVE_ANY(write_vector)
+TYPE_PRIMITIVE_ANY(send_file)
 TYPE_PRIMITIVE_ANY(read)
+TYPE_PRIMITIVE_ANY(read_into)
 TYPE_PRIMITIVE_ANY(error_number)
 TYPE_PRIMITIVE_ANY(error)
 TYPE_PRIMITIVE_ANY(get_option)
@@ -26,6 +26,7 @@ TYPE_PRIMITIVE_ANY(bind)
 TYPE_PRIMITIVE_ANY(bind_socket)
 TYPE_PRIMITIVE_ANY(connect)
 TYPE_PRIMITIVE_ANY(receive)
+TYPE_PRIMITIVE_ANY(receive_multiple)
 TYPE_PRIMITIVE_ANY(send)
 TYPE_PRIMITIVE_ANY(get_option)
 TYPE_PRIMITIVE_ANY(set_option)
@@ -1207,6 +1207,24 @@ static TypeScope* process(TypeScope* scope, uint8* bcp, std::vector<Worklist*>&
   INVOKE_VIRTUAL_BINARY(INVOKE_AT)
 #undef INVOKE_VIRTUAL_BINARY
 
+  // Superinstructions are analyzed like the first of the fused
+  // bytecodes. The second one follows in the bytecode stream.
+#define INVOKE_VIRTUAL_BINARY_FUSED(opcode, base)                     \
+  OPCODE_BEGIN(opcode);                                               \
+    word offset = program->invoke_bytecode_offset(base);              \
+    propagator->call_virtual(method, scope, bcp, 2, offset, worklists);  \
+    if (stack->top_is_empty()) return scope;                          \
+  OPCODE_END();
+
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_EQ_BRANCH_IF_FALSE, INVOKE_EQ)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_LT_BRANCH_IF_FALSE, INVOKE_LT)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_GT_BRANCH_IF_FALSE, INVOKE_GT)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_LTE_BRANCH_IF_FALSE, INVOKE_LTE)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_GTE_BRANCH_IF_FALSE, INVOKE_GTE)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_ADD_STORE_LOCAL_POP, INVOKE_ADD)
+  INVOKE_VIRTUAL_BINARY_FUSED(INVOKE_SUB_STORE_LOCAL_POP, INVOKE_SUB)
+#undef INVOKE_VIRTUAL_BINARY_FUSED
+
   OPCODE_BEGIN(INVOKE_AT_PUT);
     word offset = program->invoke_bytecode_offset(INVOKE_AT_PUT);
     propagator->call_virtual(method, scope, bcp, 3, offset, worklists);
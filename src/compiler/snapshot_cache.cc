@@ -0,0 +1,407 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snapshot_cache.h"
+
+#include "ast.h"
+#include "filesystem_archive.h"
+#include "lock.h"
+#include "set.h"
+#include "sources.h"
+#include "util.h"
+#include "../flags.h"
+#include "../os.h"
+#include "../sha.h"
+#include "../utils.h"
+
+namespace toit {
+namespace compiler {
+
+static const char* SNAPSHOT_CACHE_PATH = ".cache/toit/snapshots";
+static const char* ENTRY_EXTENSION = ".entry";
+static const char* SNAPSHOT_EXTENSION = ".snapshot";
+static const char* TEMPORARY_EXTENSION = ".tmp";
+
+// Snapshots that no entry refers to, and temporary files, are removed once
+// they are this old. Younger ones might belong to a store that is still
+// running.
+static const int ORPHAN_AGE_SECONDS = 10 * 60;
+
+static const int HASH_HEX_LENGTH = 2 * Sha::HASH_LENGTH_256;
+// Used instead of the hash for paths that must not exist.
+static const char ABSENT_MARKER = '-';
+
+static std::string hex_digest(Sha* sha) {
+  uint8 hash[Sha::HASH_LENGTH_256];
+  sha->get(hash);
+  char buffer[HASH_HEX_LENGTH + 1];
+  for (int i = 0; i < Sha::HASH_LENGTH_256; i++) {
+    snprintf(&buffer[2 * i], 3, "%02x", hash[i]);
+  }
+  return std::string(buffer, HASH_HEX_LENGTH);
+}
+
+static std::string hash_content(const uint8* content, int size) {
+  Sha sha(null, 256);
+  sha.add(content, size);
+  return hex_digest(&sha);
+}
+
+// Adds the string, including its terminating '\0', so that consecutive
+// strings can't run into each other.
+static void add_string(Sha* sha, const char* str) {
+  sha->add(unsigned_cast(str), strlen(str) + 1);
+}
+
+static void add_flag(Sha* sha, bool value) { add_string(sha, value ? "true" : "false"); }
+static void add_flag(Sha* sha, const char* value) { add_string(sha, value == null ? "" : value); }
+static void add_flag(Sha* sha, int value) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%d", value);
+  add_string(sha, buffer);
+}
+
+// The compiler prints something when one of these flags is set, which a
+// cached snapshot couldn't reproduce.
+static bool has_printing_compiler_flag() {
+  return Flags::propagate ||
+      Flags::migrate_dash_ids ||
+      Flags::compiler ||
+      Flags::print_nodes ||
+      Flags::print_ir_tree ||
+      Flags::print_dispatch_table ||
+      Flags::print_bytecodes ||
+      Flags::report_tree_shaking ||
+      Flags::print_dependency_tree;
+}
+
+// Adds an id of the running executable. The SDK version doesn't change when
+// the compiler is rebuilt, but the executable's size and modification time
+// do.
+static bool add_build_id(Sha* sha) {
+  char* executable = OS::get_executable_path();
+  if (executable == null) return false;
+  struct stat info;
+  int result = stat(executable, &info);
+  add_string(sha, executable);
+  free(executable);
+  if (result != 0) return false;
+#if defined(TOIT_LINUX)
+  long long nanoseconds = info.st_mtim.tv_nsec;
+#elif defined(TOIT_DARWIN)
+  long long nanoseconds = info.st_mtimespec.tv_nsec;
+#else
+  long long nanoseconds = 0;
+#endif
+  char buffer[80];
+  snprintf(buffer, sizeof(buffer), "%lld:%lld.%09lld:%lld",
+           static_cast<long long>(info.st_size),
+           static_cast<long long>(info.st_mtime),
+           nanoseconds,
+           static_cast<long long>(info.st_ino));
+  add_string(sha, buffer);
+  return true;
+}
+
+// Adds the library root and the package cache paths, which decide where the
+// imports of a program are found.
+static bool add_package_environment(Sha* sha, Filesystem* fs) {
+  add_string(sha, fs->library_root());
+#ifdef TOIT_WINDOWS
+  const char* home_variable = "USERPROFILE";
+#else
+  const char* home_variable = "HOME";
+#endif
+  // Computing the package cache paths without them is fatal.
+  if (getenv("TOIT_PACKAGE_CACHE_PATHS") == null && getenv(home_variable) == null) return false;
+  auto paths = fs->package_cache_paths();
+  add_flag(sha, static_cast<int>(paths.length()));
+  for (auto path : paths) add_string(sha, path);
+  return true;
+}
+
+static bool ends_with(const char* str, const char* suffix) {
+  size_t length = strlen(str);
+  size_t suffix_length = strlen(suffix);
+  return length >= suffix_length && strcmp(str + length - suffix_length, suffix) == 0;
+}
+
+static bool make_directories(Filesystem* fs, const std::string& path) {
+  if (path.empty() || fs->is_directory(path.c_str())) return true;
+  size_t separator = path.size() - 1;
+  while (separator > 0 && !fs->is_path_separator(path[separator])) separator--;
+  if (separator > 0 && !make_directories(fs, path.substr(0, separator))) return false;
+#ifdef TOIT_WINDOWS
+  int result = mkdir(path.c_str());
+#else
+  int result = mkdir(path.c_str(), 0755);
+#endif
+  return result == 0 || errno == EEXIST;
+}
+
+SnapshotCache* SnapshotCache::for_entry(const char* entry_path,
+                                        const char* project_root,
+                                        int optimization_level) {
+  // Programs in archives are typically not on disk.
+  if (FilesystemArchive::is_probably_archive(entry_path)) return null;
+  if (has_printing_compiler_flag()) return null;
+  auto directory = default_directory();
+  if (directory == null) return null;
+
+  FilesystemLocal fs;
+  auto absolute = [&](const char* path) {
+    PathBuilder builder(&fs);
+    if (!fs.is_absolute(path)) builder.join(fs.relative_anchor(path));
+    builder.join(path);
+    builder.canonicalize();
+    return builder.buffer();
+  };
+
+  Sha sha(null, 256);
+  add_string(&sha, vm_git_version());
+  if (!add_build_id(&sha)) return null;
+  add_string(&sha, absolute(entry_path).c_str());
+  add_string(&sha, project_root == null ? "" : absolute(project_root).c_str());
+  if (!add_package_environment(&sha, &fs)) return null;
+  char level[16];
+  snprintf(level, sizeof(level), "-O%d", optimization_level);
+  add_string(&sha, level);
+  // Some of the flags, like the one for asserts, change the snapshot.
+#define ADD_FLAG(type, prefix, name, value, doc) add_flag(&sha, Flags::name);
+  FLAGS_DO(ADD_FLAG, ADD_FLAG)
+#undef ADD_FLAG
+
+  // The compiler uses the first lock file that exists at these paths.
+  std::vector<std::string> lock_file_paths;
+  if (project_root != null) {
+    PathBuilder builder(&fs);
+    builder.join(absolute(project_root));
+    builder.join("package.lock");
+    lock_file_paths.push_back(builder.buffer());
+  } else {
+    lock_file_paths = lock_file_search_paths(entry_path, &fs);
+  }
+  return _new SnapshotCache(directory, hex_digest(&sha), lock_file_paths);
+}
+
+const char* SnapshotCache::default_directory() {
+  auto path = getenv("TOIT_SNAPSHOT_CACHE_PATH");
+  if (path != null) return path;
+#ifdef TOIT_WINDOWS
+  auto home_path = getenv("USERPROFILE");
+#else
+  auto home_path = getenv("HOME");
+#endif
+  if (home_path == null) return null;
+  FilesystemLocal fs;
+  PathBuilder builder(&fs);
+  builder.join(home_path);
+  builder.join(SNAPSHOT_CACHE_PATH);
+  return builder.strdup();
+}
+
+void SnapshotCache::clear(const char* directory) {
+  DIR* dir = opendir(directory);
+  if (dir == null) return;
+  FilesystemLocal fs;
+  while (true) {
+    struct dirent* entry = readdir(dir);
+    if (entry == null) break;
+    const char* name = entry->d_name;
+    if (ends_with(name, ENTRY_EXTENSION) ||
+        ends_with(name, SNAPSHOT_EXTENSION) ||
+        strstr(name, TEMPORARY_EXTENSION) != null) {
+      PathBuilder builder(&fs);
+      builder.join(directory, name);
+      remove(builder.c_str());
+    }
+  }
+  closedir(dir);
+}
+
+std::string SnapshotCache::path_in_cache(const std::string& name) {
+  PathBuilder builder(&fs_);
+  builder.join(directory_, name);
+  return builder.buffer();
+}
+
+std::string SnapshotCache::read_file(const std::string& name) {
+  int size;
+  auto content = fs_.read_content(path_in_cache(name).c_str(), &size);
+  if (content == null) return "";
+  std::string result(char_cast(content), size);
+  free(const_cast<uint8*>(content));
+  return result;
+}
+
+std::string SnapshotCache::read_entry() {
+  return read_file(key_ + ENTRY_EXTENSION);
+}
+
+SnapshotBundle SnapshotCache::lookup() {
+  // The first line of the entry is the name of the snapshot. Each following
+  // line has the hash and the path of a source, or a line of absent markers
+  // and a path that must not exist.
+  auto entry = read_entry();
+  size_t line_end = entry.find('\n');
+  if (line_end == std::string::npos) return SnapshotBundle::invalid();
+  auto snapshot_name = entry.substr(0, line_end);
+  size_t pos = line_end + 1;
+  while (pos < entry.size()) {
+    line_end = entry.find('\n', pos);
+    if (line_end == std::string::npos || line_end - pos <= static_cast<size_t>(HASH_HEX_LENGTH) + 1) {
+      return SnapshotBundle::invalid();
+    }
+    auto source_path = entry.substr(pos + HASH_HEX_LENGTH + 1, line_end - pos - HASH_HEX_LENGTH - 1);
+    if (entry[pos] == ABSENT_MARKER) {
+      if (fs_.exists(source_path.c_str())) return SnapshotBundle::invalid();
+      pos = line_end + 1;
+      continue;
+    }
+    int size;
+    auto content = fs_.read_content(source_path.c_str(), &size);
+    if (content == null) return SnapshotBundle::invalid();
+    auto hash = hash_content(content, size);
+    free(const_cast<uint8*>(content));
+    if (entry.compare(pos, HASH_HEX_LENGTH, hash) != 0) return SnapshotBundle::invalid();
+    pos = line_end + 1;
+  }
+  return SnapshotBundle::read_from_file(path_in_cache(snapshot_name).c_str(), true);
+}
+
+void SnapshotCache::store(const std::vector<ast::Unit*>& units,
+                          Source* lock_file,
+                          List<uint8> snapshot,
+                          List<uint8> source_map) {
+  std::vector<Source*> sources;
+  if (lock_file != null) sources.push_back(lock_file);
+  UnorderedSet<Source*> seen;
+  for (auto unit : units) {
+    // Units with empty paths are synthetic, like in the dependency writers.
+    auto path = unit->absolute_path();
+    if (path[0] == '\0') continue;
+    // The lookup can only check sources that are files.
+    if (SourceManager::is_virtual_file(path) || strchr(path, '\n') != null) return;
+    if (seen.contains(unit->source())) continue;
+    seen.insert(unit->source());
+    sources.push_back(unit->source());
+  }
+
+  std::string entry_sources;
+  // A lock file that appears closer to the entry than the one that was used
+  // changes how imports are resolved.
+  for (auto& path : lock_file_paths_) {
+    if (lock_file != null && path == lock_file->absolute_path()) break;
+    if (strchr(path.c_str(), '\n') != null) return;
+    entry_sources += std::string(HASH_HEX_LENGTH, ABSENT_MARKER);
+    entry_sources += " ";
+    entry_sources += path;
+    entry_sources += "\n";
+  }
+  for (auto source : sources) {
+    entry_sources += hash_content(source->text(), source->size());
+    entry_sources += " ";
+    entry_sources += source->absolute_path();
+    entry_sources += "\n";
+  }
+  Sha sha(null, 256);
+  add_string(&sha, key_.c_str());
+  add_string(&sha, entry_sources.c_str());
+  auto snapshot_name = hex_digest(&sha) + SNAPSHOT_EXTENSION;
+
+  if (!make_directories(&fs_, directory_)) return;
+  SnapshotBundle bundle(snapshot, source_map);
+  bool succeeded = write_file(snapshot_name, bundle.buffer(), bundle.size());
+  free(bundle.buffer());
+  if (!succeeded) return;
+
+  // Each entry only keeps its latest snapshot.
+  auto old_entry = read_entry();
+  auto old_snapshot_name = old_entry.substr(0, old_entry.find('\n'));
+  std::string entry = snapshot_name + "\n" + entry_sources;
+  if (!write_file(key_ + ENTRY_EXTENSION, unsigned_cast(entry.c_str()), entry.size())) return;
+  if (!old_snapshot_name.empty() && old_snapshot_name != snapshot_name) {
+    remove(path_in_cache(old_snapshot_name).c_str());
+  }
+  remove_orphans();
+}
+
+// Concurrent stores for the same entry can both replace the same old
+// snapshot, and then only one of their new snapshots is referenced. Crashed
+// stores leave temporary files behind.
+void SnapshotCache::remove_orphans() {
+  DIR* dir = opendir(directory_.c_str());
+  if (dir == null) return;
+  std::vector<std::string> entries;
+  std::vector<std::string> candidates;
+  while (true) {
+    struct dirent* entry = readdir(dir);
+    if (entry == null) break;
+    const char* name = entry->d_name;
+    if (ends_with(name, ENTRY_EXTENSION)) {
+      entries.push_back(name);
+    } else if (ends_with(name, SNAPSHOT_EXTENSION) || strstr(name, TEMPORARY_EXTENSION) != null) {
+      candidates.push_back(name);
+    }
+  }
+  closedir(dir);
+
+  UnorderedSet<std::string> referenced;
+  for (auto& name : entries) {
+    auto entry = read_file(name);
+    referenced.insert(entry.substr(0, entry.find('\n')));
+  }
+  time_t now = time(null);
+  for (auto& name : candidates) {
+    if (referenced.contains(name)) continue;
+    auto path = path_in_cache(name);
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) continue;
+    if (now - info.st_mtime < ORPHAN_AGE_SECONDS) continue;
+    remove(path.c_str());
+  }
+}
+
+// Writes the file through a temporary file, so that concurrent runs never
+// see a partially written file.
+bool SnapshotCache::write_file(const std::string& name, const uint8* data, int size) {
+  auto path = path_in_cache(name);
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), "%s%d", TEMPORARY_EXTENSION, static_cast<int>(getpid()));
+  auto temporary_path = path + suffix;
+  FILE* file = fopen(temporary_path.c_str(), "wb");
+  if (file == null) return false;
+  bool succeeded = fwrite(data, 1, size, file) == static_cast<size_t>(size);
+  succeeded = fclose(file) == 0 && succeeded;
+#ifdef TOIT_WINDOWS
+  // Renaming doesn't replace existing files on Windows.
+  if (succeeded) remove(path.c_str());
+#endif
+  if (succeeded && rename(temporary_path.c_str(), path.c_str()) == 0) return true;
+  remove(temporary_path.c_str());
+  return false;
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,104 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../top.h"
+#include "../snapshot_bundle.h"
+#include "filesystem_local.h"
+#include "list.h"
+
+namespace toit {
+namespace compiler {
+
+namespace ast {
+class Unit;
+}
+class Source;
+
+/// An on-disk cache of the snapshots of Toit programs.
+///
+/// Every program has an entry in the cache directory. Its name is a hash
+///   of the SDK version, the build of the executable, the absolute path of the
+///   entry file, and the options that influence the snapshot.
+/// The entry lists the hashes of all sources of the program (the ones a
+///   dependency file lists), and of the package lock file. It also lists the
+///   paths where a lock file was searched but didn't exist. It is only used
+///   if none of the sources changed, and no lock file appeared.
+/// The name of the snapshot is a hash of the entry's name and content.
+/// The entry's name also covers the library root and the package cache
+///   paths, as they decide where imports are found.
+/// Every store removes the snapshots that no entry refers to anymore, and
+///   left-over temporary files, once they are a few minutes old.
+///
+/// Only programs that compiled without any diagnostic are stored. A cache
+///   hit thus doesn't hide any warnings.
+class SnapshotCache {
+ public:
+  /// Returns the cache for the given entry file, or null if the program
+  ///   can't be cached.
+  static SnapshotCache* for_entry(const char* entry_path,
+                                  const char* project_root,
+                                  int optimization_level);
+
+  /// The directory of the cache.
+  ///
+  /// This is the `TOIT_SNAPSHOT_CACHE_PATH` environment variable if it is
+  ///   set, and `.cache/toit/snapshots` in the home directory otherwise.
+  /// Returns null if there is no home directory.
+  static const char* default_directory();
+
+  /// Removes all entries and snapshots from the cache in the given directory.
+  static void clear(const char* directory);
+
+  /// Returns the cached snapshot bundle, or an invalid bundle if there is
+  ///   none, or if one of its sources changed.
+  SnapshotBundle lookup();
+
+  /// Stores the snapshot that was compiled from the given units.
+  ///
+  /// The [lock_file] may be null.
+  void store(const std::vector<ast::Unit*>& units,
+             Source* lock_file,
+             List<uint8> snapshot,
+             List<uint8> source_map);
+
+ private:
+  SnapshotCache(const char* directory,
+                const std::string& key,
+                const std::vector<std::string>& lock_file_paths)
+      : directory_(directory)
+      , key_(key)
+      , lock_file_paths_(lock_file_paths) {}
+
+  FilesystemLocal fs_;
+  std::string directory_;
+  std::string key_;
+  std::vector<std::string> lock_file_paths_;
+
+  std::string path_in_cache(const std::string& name);
+  /// Returns the content of the file, or the empty string if there is none.
+  std::string read_file(const std::string& name);
+  /// Returns the content of the entry, or the empty string if there is none.
+  std::string read_entry();
+  void remove_orphans();
+  bool write_file(const std::string& name, const uint8* data, int size);
+};
+
+} // namespace toit::compiler
+} // namespace toit
@@ -19,33 +19,38 @@
 #include <stdarg.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include "ast.h"
 #include "diagnostic.h"
 #include "lock.h"
 #include "util.h"
 
+#include "../sha.h"
 #include "../utils.h"
 
 namespace toit {
 namespace compiler {
 
-class SourceManagerSource : public Source {
+class SourceManagerSource final : public Source {
  public:
   SourceManagerSource(const char* absolute_path,
                       const Package& package,
                       const std::string& error_path,
                       const uint8* text,
                       int size,
-                      int offset)
+                      int offset,
+                      int generation)
       : absolute_path_(absolute_path)
       , package_(package)
       , error_path_(error_path)
       , text_(text)
       , size_(size),
-      offset_(offset) {}
+      offset_(offset),
+      generation_(generation) {}
 
   static SourceManagerSource invalid() {
-    return SourceManagerSource(null, Package::invalid(), "", null, 0, 0);
+    return SourceManagerSource(null, Package::invalid(), "", null, 0, 0, 0);
   }
 
   bool is_valid() const { return text_ != null; }
@@ -103,6 +108,25 @@ class SourceManagerSource : public Source {
 
   int offset() const { return offset_; }
 
+  /// The generation of the source manager in which the content of this
+  /// source was last checked against the file.
+  int generation() const { return generation_; }
+  void set_generation(int generation) { generation_ = generation; }
+
+  const uint8* content_hash() const { return has_hash_ ? hash_ : null; }
+
+  /// Takes ownership of the text, and records its hash.
+  void set_owned_text(const uint8* hash) {
+    owns_text_ = true;
+    memcpy(hash_, hash, sizeof(hash_));
+    has_hash_ = true;
+  }
+
+  ~SourceManagerSource() {
+    free(const_cast<char*>(absolute_path_));
+    if (owns_text_) free(const_cast<uint8*>(text_));
+  }
+
  private:
   const char* absolute_path_;
   Package package_;
@@ -110,8 +134,18 @@ class SourceManagerSource : public Source {
   const uint8* text_;
   int size_;
   int offset_;
+  int generation_;
+  bool owns_text_ = false;
+  bool has_hash_ = false;
+  uint8 hash_[Sha::HASH_LENGTH_256];
 };
 
+static void hash_content(const uint8* content, int size, uint8* hash) {
+  Sha sha(null, 256);
+  sha.add(content, size);
+  sha.get(hash);
+}
+
 const char* error_message_for_load_error(SourceManager::LoadResult::Status status) {
   switch (status) {
     case SourceManager::LoadResult::OK: UNREACHABLE();
@@ -146,16 +180,45 @@ bool SourceManager::is_loaded(const std::string& path) {
   return path_to_source_.find(path) != path_to_source_.end();
 }
 
+void SourceManager::release(Source* source) {
+  auto entry = static_cast<SourceManagerSource*>(source);
+  auto probe = std::find(sources_.begin(), sources_.end(), entry);
+  ASSERT(probe != sources_.end());
+  sources_.erase(probe);
+  if (cached_source_entry_ == entry) {
+    cached_source_entry_ = null;
+    cached_offset_ = -1;
+  }
+  delete entry;
+}
+
+void SourceManager::revalidate(const std::string& path) {
+  owns_text_ = true;
+  auto probe = path_to_source_.find(path);
+  if (probe == path_to_source_.end()) return;
+  // No generation is negative, so the next load checks the file again.
+  probe->second->set_generation(-1);
+}
+
 SourceManager::LoadResult SourceManager::load_file(const std::string& path, const Package& package) {
+  SourceManagerSource* stale = null;
   auto probe = path_to_source_.find(path);
   if (probe != path_to_source_.end()) {
     // The path is already loaded.
     auto entry = probe->second;
-    return {
-      .source = entry,
-      .absolute_path = path,
-      .status = LoadResult::OK,
-    };
+    if (entry->generation() == generation_) {
+      return {
+        .source = entry,
+        .absolute_path = path,
+        .status = LoadResult::OK,
+      };
+    }
+    // The file was loaded before the last call to `revalidate`, and might
+    // have changed since.
+    stale = entry;
+    path_to_source_.remove(path);
+    // Unless the content turns out to be unchanged, the source is replaced.
+    replaced_sources_.push_back(stale);
   }
   if (!filesystem_->exists(path.c_str())) {
     return {
@@ -180,7 +243,31 @@ SourceManager::LoadResult SourceManager::load_file(const std::string& path, cons
       .status = LoadResult::FILE_ERROR,
     };
   }
-  // This is the first time we encounter this path.
+  uint8 hash[Sha::HASH_LENGTH_256];
+  if (owns_text_) hash_content(buffer, size, hash);
+  if (stale != null &&
+      stale->content_hash() != null &&
+      stale->size() == size &&
+      stale->package().id() == package.id() &&
+      memcmp(stale->content_hash(), hash, sizeof(hash)) == 0) {
+    replaced_sources_.pop_back();
+    stale->set_generation(generation_);
+    path_to_source_[path] = stale;
+    return {
+      .source = stale,
+      .absolute_path = path,
+      .status = LoadResult::OK,
+    };
+  }
+  if (owns_text_) {
+    // Keep our own copy, as the filesystem drops its content between
+    // requests.
+    auto copy = unvoid_cast<uint8*>(malloc(size + 1));
+    memcpy(copy, buffer, size);
+    copy[size] = '\0';
+    buffer = copy;
+  }
+  // This is the first time we encounter this path, or its content changed.
   std::string error_path;
   if (package.is_valid()) {
     error_path = package.build_error_path(filesystem_, path);
@@ -188,6 +275,7 @@ SourceManager::LoadResult SourceManager::load_file(const std::string& path, cons
     error_path = path;
   }
   auto source = register_source(path, package, error_path, buffer, size);
+  if (owns_text_) source->set_owned_text(hash);
   return {
     .source = source,
     .absolute_path = path,
@@ -205,7 +293,8 @@ SourceManagerSource* SourceManager::register_source(const std::string& absolute_
                                         error_path,
                                         source,
                                         size,
-                                        next_offset_);
+                                        next_offset_,
+                                        generation_);
   sources_.push_back(entry);
   if (absolute_path != "") {
     path_to_source_.add(absolute_path, entry);
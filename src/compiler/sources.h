@@ -193,6 +193,11 @@ class Source {
 
   virtual int size() const = 0;
 
+  /// The SHA-256 hash of the text, or null.
+  ///
+  /// Only long-lived compilers hash the sources (see `SourceManager::revalidate`).
+  virtual const uint8* content_hash() const { return null; }
+
   /// Returns the offset of the given [position] in this source.
   /// Returns -1 if the position is not from this source.
   virtual int offset_in_source(Position position) const = 0;
@@ -267,12 +272,55 @@ class SourceManager {
   bool is_loaded(const char* path);
   bool is_loaded(const std::string& path);
 
+  /// Marks all loaded files as possibly changed.
+  ///
+  /// Used by long-lived compilers between requests. The next load of a
+  /// path reads the file again. If the content is unchanged, the load returns
+  /// the existing source, so anything that was derived from it can be reused.
+  /// Otherwise the path gets a new source at a new offset.
+  ///
+  /// Once called, the manager keeps its own copy of the text of the files it
+  /// loads, so the filesystem can drop its content between requests, and
+  /// identifies the content of a file by its hash.
+  void revalidate() {
+    generation_++;
+    owns_text_ = true;
+  }
+
+  /// Variant of `revalidate` that only marks the given file as possibly
+  /// changed.
+  void revalidate(const std::string& path);
+
+  /// Returns the sources that were replaced or dropped because their file
+  /// changed, since the last call.
+  ///
+  /// The sources stay valid until they are released.
+  std::vector<Source*> take_replaced_sources() {
+    std::vector<Source*> result;
+    result.swap(replaced_sources_);
+    return result;
+  }
+
+  /// Frees a source that was returned by `take_replaced_sources`.
+  ///
+  /// Nothing may refer to the source or to positions in it anymore.
+  void release(Source* source);
+
+  /// The offset the next loaded source gets.
+  ///
+  /// Offsets are never reused, so a long-lived compiler must eventually
+  /// start over.
+  int next_offset() const { return next_offset_; }
+
  private:
   Filesystem* filesystem_;
 
   int next_offset_ = 0;
+  int generation_ = 0;
+  bool owns_text_ = false;
 
   std::vector<SourceManagerSource*> sources_;
+  std::vector<Source*> replaced_sources_;
   UnorderedMap<std::string, SourceManagerSource*> path_to_source_;
 
   mutable SourceManagerSource* cached_source_entry_;
@@ -17,6 +17,8 @@
 
 #include "token.h"
 
+#include "../os.h"
+
 namespace toit {
 namespace compiler {
 
@@ -38,7 +40,9 @@ ENTRY_POINTS(E)
 };
 
 SymbolCanonicalizer::SymbolCanonicalizer()
-      : identifier_trie_(0), number_trie_(0) {
+      : identifier_trie_(0)
+      , number_trie_(0)
+      , mutex_(OS::allocate_mutex(100, "SymbolCanonicalizer")) {
   for (unsigned i = 0; i < ARRAY_SIZE(keywords); i++) {
     Token::Kind kind = keywords[i];
     const uint8* syntax = unsigned_cast(Token::symbol(kind).c_str());
@@ -57,9 +61,19 @@ SymbolCanonicalizer::SymbolCanonicalizer()
   }
 }
 
+SymbolCanonicalizer::SymbolCanonicalizer(SymbolCanonicalizer* shared)
+      : identifier_trie_(0)
+      , number_trie_(0)
+      , shared_(shared) {}
+
 SymbolCanonicalizer::TokenSymbol SymbolCanonicalizer::canonicalize_identifier(const uint8* from, const uint8* to) {
   Trie* trie = identifier_trie_.get(from, to);
-  if (trie->kind == 0) {
+  if (trie->kind == 0 && shared_ != null) {
+    Locker locker(shared_->mutex_);
+    auto shared = shared_->canonicalize_identifier(from, to);
+    trie->kind = shared.kind;
+    trie->data = shared.symbol;
+  } else if (trie->kind == 0) {
     trie->kind = Token::IDENTIFIER;
     trie->data = Symbol::synthetic(from, to);
   }
@@ -71,7 +85,11 @@ SymbolCanonicalizer::TokenSymbol SymbolCanonicalizer::canonicalize_identifier(co
 
 Symbol SymbolCanonicalizer::canonicalize_number(const uint8* from, const uint8* to) {
   Trie* trie = number_trie_.get(from, to);
-  if (trie->kind == 0) {
+  if (trie->kind == 0 && shared_ != null) {
+    Locker locker(shared_->mutex_);
+    trie->kind = Token::INTEGER;
+    trie->data = shared_->canonicalize_number(from, to);
+  } else if (trie->kind == 0) {
     // We are arbitrarily using 'integer' as token here.
     // It's not important, and only serves as an indication that we have already seen
     // the symbol.
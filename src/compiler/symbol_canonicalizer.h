@@ -19,6 +19,9 @@
 #include "trie.h"
 
 namespace toit {
+
+class Mutex;
+
 namespace compiler {
 
 class SymbolCanonicalizer {
@@ -30,6 +33,14 @@ class SymbolCanonicalizer {
 
   SymbolCanonicalizer();
 
+  /// A canonicalizer for a different thread than the one of [shared].
+  ///
+  /// Identifiers and numbers that aren't in this canonicalizer yet are
+  ///   canonicalized by [shared], so that all canonicalizers return the
+  ///   same symbols. Any number of these can be used concurrently, as
+  ///   long as [shared] isn't used directly at the same time.
+  explicit SymbolCanonicalizer(SymbolCanonicalizer* shared);
+
   // Returns a TokenSymbol.
   //
   // Keywords have their tokens set to the corresponding token.
@@ -45,6 +56,10 @@ class SymbolCanonicalizer {
 
   // Copy of canonicalized syntax for identifiers and numbers.
   ListBuilder<const uint8*> syntax_;
+
+  SymbolCanonicalizer* shared_ = null;
+  // Guards the tries of a canonicalizer that is shared between threads.
+  Mutex* mutex_ = null;
 };
 
 } // namespace toit::compiler
@@ -26,8 +26,8 @@ namespace toit {
 namespace compiler {
 
 static void print_usage(int exit_code) {
-  // We don't expose the `--lsp` flag in the help. It's internal and not
-  // relevant for users.
+  // We don't expose the `--lsp` and `--daemon` flags in the help. They are
+  // internal and not relevant for users.
   printf("Usage:\n");
   printf("toit\n");
   printf("  [-h] [--help]                            // This help message.\n");
@@ -103,6 +103,7 @@ int main(int argc, char **argv) {
   const char* project_root = null;
   auto dep_format = compiler::Compiler::DepFormat::none;
   bool for_language_server = false;
+  bool as_daemon = false;
   bool for_analysis = false;
   bool for_dependencies = false;
   const char* vessels_root = null;
@@ -245,6 +246,9 @@ int main(int argc, char **argv) {
       for_analysis = strcmp(argv[processed_args], "--analyze") == 0;
       processed_args++;
       ways_to_run++;
+    } else if (strcmp(argv[processed_args], "--daemon") == 0) {
+      as_daemon = true;
+      processed_args++;
     } else if (strcmp(argv[processed_args], "--dependencies") == 0) {
       for_dependencies = true;
       processed_args++;
@@ -339,6 +343,11 @@ int main(int argc, char **argv) {
     print_usage(1);
   }
 
+  if (as_daemon && !for_language_server) {
+    fprintf(stderr, "The --daemon flag can only be used together with --lsp\n");
+    print_usage(1);
+  }
+
   if (for_language_server && dep_file != null) {
     fprintf(stderr, "Can't generate dependency file with --lsp\n");
     print_usage(1);
@@ -353,11 +362,16 @@ int main(int argc, char **argv) {
     .show_package_warnings = show_package_warnings,
     .print_diagnostics_on_stdout = true,
     .optimization_level = optimization_level,
+    .snapshot_cache = null,
   };
 
   if (for_language_server) {
     compiler::Compiler compiler;
-    compiler.language_server(compiler_config);
+    if (as_daemon) {
+      compiler.language_server_daemon(compiler_config);
+    } else {
+      compiler.language_server(compiler_config);
+    }
   } else if (for_analysis || for_dependencies) {
     compiler::Compiler compiler;
     compiler.analyze(List<const char*>(source_paths, source_path_count),
@@ -96,7 +96,14 @@ void EpollEventSourceBase::stop() {
 
 
 void EpollEventSourceBase::on_register_resource(Locker& locker, Resource* resource) {
-  uint64_t cmd = fd_for_resource(resource);
+  int fd = fd_for_resource(resource);
+  if (fd >= static_cast<int>(resource_for_fd_.size())) {
+    resource_for_fd_.resize(Utils::max(fd + 1, static_cast<int>(resource_for_fd_.size()) * 2), null);
+  }
+  ASSERT(resource_for_fd_[fd] == null);
+  resource_for_fd_[fd] = resource;
+
+  uint64_t cmd = fd;
   cmd <<= 32;
   cmd |= kAdd;
   if (!write_full(control_write_, reinterpret_cast<uint8_t*>(&cmd), sizeof(cmd))) {
@@ -105,7 +112,12 @@ void EpollEventSourceBase::on_register_resource(Locker& locker, Resource* resour
 }
 
 void EpollEventSourceBase::on_unregister_resource(Locker& locker, Resource* resource) {
-  uint64_t cmd = fd_for_resource(resource);
+  int fd = fd_for_resource(resource);
+  if (fd < static_cast<int>(resource_for_fd_.size()) && resource_for_fd_[fd] == resource) {
+    resource_for_fd_[fd] = null;
+  }
+
+  uint64_t cmd = fd;
   cmd <<= 32;
   cmd |= kRemove;
   if (!write_full(control_write_, reinterpret_cast<uint8_t*>(&cmd), sizeof(cmd))) {
@@ -114,70 +126,92 @@ void EpollEventSourceBase::on_unregister_resource(Locker& locker, Resource* reso
 }
 
 void EpollEventSourceBase::entry() {
+  static const int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  Resource* resources[MAX_EVENTS];
+  word data[MAX_EVENTS];
+  ObjectNotifier* notifiers[MAX_EVENTS];
+
   while (true) {
-    epoll_event event;
-    int ready = epoll_wait(epoll_fd_, &event, 1, -1);
-    switch (ready) {
-      case 1: {
-        if (event.data.fd == control_read_) {
-          if (event.events & EPOLLHUP) {
-            close(control_read_);
-            control_read_ = -1;
-            return;
-          }
-
-          uint64_t cmd = 0;
-          if (!read_full(control_read_, reinterpret_cast<uint8_t*>(&cmd), sizeof(cmd))) {
-            FATAL("failed to receive 0x%llx in epoll: %d", cmd, errno);
-          }
-
-          int id = cmd >> 32;
-          switch (cmd & ((1LL << 32) - 1)) {
-            case kAdd: {
-                epoll_event event = {0, {0}};
-                event.events = EPOLLIN | EPOLLOUT | EPOLLET;
-                event.data.fd = id;
-                if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, id, &event) == -1) {
-                  FATAL("failed to add 0x%lx to epoll: %d", id, errno);
-                }
-              }
-              break;
-
-            case kRemove: {
-                if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, id, null) == -1) {
-                  FATAL("failed to remove 0x%lx from epoll: %d", id, errno);
-                }
-                on_removed(id);
-              }
-              break;
-          }
-
-          continue;
-        }
+    // Drain as many ready file descriptors as possible per wakeup, so we
+    // only take the event source lock and the scheduler lock once for the
+    // whole batch.
+    int ready = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+    if (ready == -1) {
+      if (errno == EINTR) continue;
+      FATAL("error waiting for epoll events");
+    }
+
+    bool has_control_event = false;
+    bool has_resource_event = false;
+    for (int i = 0; i < ready; i++) {
+      if (events[i].data.fd == control_read_) {
+        has_control_event = true;
+      } else {
+        has_resource_event = true;
+      }
+    }
 
-        Locker locker(mutex());
-        Resource* r = find_resource_for_fd(locker, event.data.fd);
-        if (r != null) dispatch(locker, r, event.events);
-        break;
+    // Dispatch the events for resources before handling any control
+    // commands. A removal command may close a file descriptor, and we
+    // don't want its number to be reused before we're done with the
+    // events we already have for it.
+    if (has_resource_event) {
+      Locker locker(mutex());
+      int count = 0;
+      for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+        if (fd == control_read_) continue;
+        Resource* r = find_resource_for_fd(locker, fd);
+        if (r == null) continue;
+        resources[count] = r;
+        data[count] = events[i].events;
+        count++;
       }
+      if (count > 0) dispatch_batch(locker, count, resources, data, notifiers);
+    }
+
+    if (!has_control_event) continue;
+    for (int i = 0; i < ready; i++) {
+      if (events[i].data.fd != control_read_) continue;
+      if (!handle_control_event(events[i])) return;
+    }
+  }
+}
 
-      case 0:
-        // No events (timeout), loop.
-        break;
+bool EpollEventSourceBase::handle_control_event(const epoll_event& control_event) {
+  if (control_event.events & EPOLLHUP) {
+    close(control_read_);
+    control_read_ = -1;
+    return false;
+  }
+
+  uint64_t cmd = 0;
+  if (!read_full(control_read_, reinterpret_cast<uint8_t*>(&cmd), sizeof(cmd))) {
+    FATAL("failed to receive 0x%llx in epoll: %d", cmd, errno);
+  }
 
-      case  -1: {
-        if (errno == EINTR) {
-          // No events (timeout), loop.
-          break;
+  int id = cmd >> 32;
+  switch (cmd & ((1LL << 32) - 1)) {
+    case kAdd: {
+        epoll_event event = {0, {0}};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.fd = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, id, &event) == -1) {
+          FATAL("failed to add 0x%lx to epoll: %d", id, errno);
         }
-        // FALL THROUGH.
       }
+      break;
 
-      default:
-        FATAL("error waiting for epoll events");
-        break;
-    }
+    case kRemove: {
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, id, null) == -1) {
+          FATAL("failed to remove 0x%lx from epoll: %d", id, errno);
+        }
+        on_removed(id);
+      }
+      break;
   }
+  return true;
 }
 
 EpollEventSource* EpollEventSource::instance_ = null;
@@ -200,10 +234,6 @@ void EpollEventSource::on_removed(int fd) {
   close(fd);
 }
 
-Resource* EpollEventSource::find_resource_for_fd(Locker& locker, int fd) {
-  return find_resource_by_id(locker, fd);
-}
-
 int EpollEventSource::fd_for_resource(Resource* r) {
   return static_cast<IntResource*>(r)->id();
 }
@@ -15,6 +15,9 @@
 
 #pragma once
 
+#include <sys/epoll.h>
+#include <vector>
+
 #include "../resource.h"
 #include "../os.h"
 
@@ -34,11 +37,16 @@ class EpollEventSourceBase : public EventSource, public Thread {
   /// This happens during unregistering of the resource, and is a good
   /// time to close the file descriptor and release any associated resources.
   virtual void on_removed(int fd) = 0;
-  /// Finds the resource object for the given file descriptor.
-  virtual Resource* find_resource_for_fd(Locker& locker, int fd) = 0;
   /// Returns the file descriptor for the given resource.
   virtual int fd_for_resource(Resource* resource) = 0;
 
+  /// Finds the registered resource for the given file descriptor.
+  /// Returns null if no resource is registered for it.
+  Resource* find_resource_for_fd(Locker& locker, int fd) {
+    if (fd < 0 || fd >= static_cast<int>(resource_for_fd_.size())) return null;
+    return resource_for_fd_[fd];
+  }
+
   virtual void on_register_resource(Locker& locker, Resource* resource) override;
   virtual void on_unregister_resource(Locker& locker, Resource* resource) override;
 
@@ -48,9 +56,19 @@ class EpollEventSourceBase : public EventSource, public Thread {
  private:
   void entry() override;
 
+  // Handles a command sent to the epoll thread through the control pipe.
+  // Returns false if the event source has been stopped.
+  bool handle_control_event(const epoll_event& event);
+
   int epoll_fd_ = -1;
   int control_read_ = -1;
   int control_write_ = -1;
+
+  // Registered resources indexed by their file descriptor. File descriptors
+  // are small and dense, so this gives constant time lookups when
+  // dispatching events, independent of the number of open resources.
+  // Only accessed while holding the event source mutex.
+  std::vector<Resource*> resource_for_fd_;
 };
 
 class EpollEventSource : public EpollEventSourceBase {
@@ -63,8 +81,6 @@ class EpollEventSource : public EpollEventSourceBase {
  protected:
   /// Closes the file descriptor.
   void on_removed(int fd) override;
-  /// Uses `find_resource_by_id`, assuming that resources are `IntResource` instances.
-  Resource* find_resource_for_fd(Locker& locker, int fd) override;
   /// Returns the id of the resource. Assumes that the resource is an `IntResource`.
   int fd_for_resource(Resource* resource) override;
 
@@ -71,14 +71,6 @@ void GpioEventSource::on_removed(int fd) {
   }
 }
 
-Resource* GpioEventSource::find_resource_for_fd(Locker& locker, int fd) {
-  return find_resource([&](Resource* r) {
-    auto resource = static_cast<GpioPinResource*>(r);
-    if (resource->fd() == fd) return true;
-    return false;
-  });
-}
-
 int GpioEventSource::fd_for_resource(Resource* r) {
   auto resource = static_cast<GpioPinResource*>(r);
   return resource->fd();
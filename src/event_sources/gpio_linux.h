@@ -32,7 +32,6 @@ class GpioEventSource : public EpollEventSourceBase {
   void on_register_resource(Locker& locker, Resource* r) override;
   void on_unregister_resource(Locker& locker, Resource* r) override;
   void on_removed(int fd) override;
-  Resource* find_resource_for_fd(Locker& locker, int fd) override;
   int fd_for_resource(Resource* r) override;
 
  private:
@@ -20,6 +20,70 @@
 
 namespace toit {
 
+bool TimerHeap::ensure_capacity() {
+  if (size_ < capacity_) return true;
+  word new_capacity = Utils::max<word>(capacity_ * 2, 16);
+  Timer** timers = unvoid_cast<Timer**>(realloc(timers_, new_capacity * sizeof(Timer*)));
+  if (timers == null) return false;
+  timers_ = timers;
+  capacity_ = new_capacity;
+  return true;
+}
+
+void TimerHeap::insert(Timer* timer) {
+  ASSERT(!contains(timer));
+  ASSERT(size_ < capacity_);
+  word index = size_++;
+  place(index, timer);
+  sift_up(index);
+}
+
+void TimerHeap::remove(Timer* timer) {
+  ASSERT(contains(timer));
+  word index = timer->heap_index_;
+  timer->heap_index_ = Timer::NOT_IN_HEAP;
+  word last = --size_;
+  if (index == last) return;
+  place(index, timers_[last]);
+  sift_up(index);
+  sift_down(index);
+}
+
+Timer* TimerHeap::remove_first() {
+  Timer* first = timers_[0];
+  remove(first);
+  return first;
+}
+
+void TimerHeap::update(Timer* timer) {
+  ASSERT(contains(timer));
+  word index = timer->heap_index_;
+  sift_up(index);
+  sift_down(index);
+}
+
+void TimerHeap::sift_up(word index) {
+  while (index > 0) {
+    word parent = (index - 1) / 2;
+    if (!less(index, parent)) return;
+    swap(index, parent);
+    index = parent;
+  }
+}
+
+void TimerHeap::sift_down(word index) {
+  while (true) {
+    word smallest = index;
+    word left = 2 * index + 1;
+    word right = left + 1;
+    if (left < size_ && less(left, smallest)) smallest = left;
+    if (right < size_ && less(right, smallest)) smallest = right;
+    if (smallest == index) return;
+    swap(index, smallest);
+    index = smallest;
+  }
+}
+
 TimerEventSource* TimerEventSource::instance_ = null;
 
 TimerEventSource::TimerEventSource()
@@ -50,27 +114,30 @@ TimerEventSource::~TimerEventSource() {
   instance_ = null;
 }
 
-void TimerEventSource::arm(Timer* timer, int64_t timeout) {
+bool TimerEventSource::arm(Timer* timer, int64_t timeout) {
   Locker locker(mutex());
-  bool is_linked = timers_.is_linked(timer);
-  if (is_linked && timer->timeout() == timeout) {
-    return;
+  bool is_armed = timers_.contains(timer);
+  if (is_armed && timer->timeout() == timeout) {
+    return true;
+  }
+  if (!is_armed) {
+    HeapTagScope scope(ITERATE_CUSTOM_TAGS + EVENT_SOURCE_MALLOC_TAG);
+    if (!timers_.ensure_capacity()) return false;
   }
 
   // Get current timeout, if any.
   auto head = timers_.first();
   int64_t old_timeout = head ? head->timeout() : timeout + 1;
 
-  // Remove in case it was already enqueued.
-  if (is_linked) {
-    timers_.unlink(timer);
-  }
-
-  // Clear and install timer.
+  // Clear and install timer. If it was already enqueued, we just
+  // move it to its new position.
   timer->set_state(0);
   timer->set_timeout(timeout);
-
-  timers_.insert_before(timer, [&timer](Timer* t) { return timer->timeout() < t->timeout(); });
+  if (is_armed) {
+    timers_.update(timer);
+  } else {
+    timers_.insert(timer);
+  }
 
   if (timeout < old_timeout) {
     // Signal if new timeout is less the the old.
@@ -81,6 +148,7 @@ void TimerEventSource::arm(Timer* timer, int64_t timeout) {
     // much less.
     OS::signal(timer_changed_);
   }
+  return true;
 }
 
 void TimerEventSource::on_unregister_resource(Locker& locker, Resource* r) {
@@ -88,8 +156,8 @@ void TimerEventSource::on_unregister_resource(Locker& locker, Resource* r) {
   Timer* timer = r->as<Timer*>();
 
   Timer* first = timers_.first();
-  if (timers_.is_linked(timer)) {
-    timers_.unlink(timer);
+  if (timers_.contains(timer)) {
+    timers_.remove(timer);
     if (first == timer) {
       // Signal if the first one changes.
       OS::signal(timer_changed_);
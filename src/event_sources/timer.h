@@ -21,11 +21,7 @@
 
 namespace toit {
 
-class Timer;
-
-typedef DoubleLinkedList<Timer> TimerList;
-
-class Timer : public Resource, public TimerList::Element {
+class Timer : public Resource {
  public:
   TAG(Timer);
   Timer(ResourceGroup* resource_group)
@@ -33,7 +29,7 @@ class Timer : public Resource, public TimerList::Element {
     , timeout_(-1) {}
 
   ~Timer() {
-    ASSERT(TimerList::Element::is_not_linked());
+    ASSERT(heap_index_ == NOT_IN_HEAP);
   }
 
   void set_timeout(int64_t timeout) { timeout_ = timeout; }
@@ -41,7 +37,65 @@ class Timer : public Resource, public TimerList::Element {
   int64 timeout() const { return timeout_; }
 
  private:
+  static const word NOT_IN_HEAP = -1;
+
   int64 timeout_;
+  word heap_index_ = NOT_IN_HEAP;
+
+  friend class TimerHeap;
+};
+
+// A binary min-heap of armed timers, ordered by their timeouts. Every timer
+// keeps track of its own position in the heap, so arming, re-arming and
+// cancelling a timer are all O(log n).
+class TimerHeap {
+ public:
+  ~TimerHeap() {
+    ASSERT(is_empty());
+    free(timers_);
+  }
+
+  bool is_empty() const { return size_ == 0; }
+  Timer* first() const { return is_empty() ? null : timers_[0]; }
+
+  bool contains(Timer* timer) const {
+    return timer->heap_index_ != Timer::NOT_IN_HEAP;
+  }
+
+  // Makes sure there is room for one more timer. Returns false if
+  // growing the heap failed.
+  bool ensure_capacity();
+
+  // Adds the timer to the heap. Requires capacity for it.
+  void insert(Timer* timer);
+  void remove(Timer* timer);
+  Timer* remove_first();
+
+  // Moves the timer to its correct position after its timeout has changed.
+  void update(Timer* timer);
+
+ private:
+  Timer** timers_ = null;
+  word size_ = 0;
+  word capacity_ = 0;
+
+  bool less(word i, word j) const {
+    return timers_[i]->timeout() < timers_[j]->timeout();
+  }
+
+  void place(word index, Timer* timer) {
+    timers_[index] = timer;
+    timer->heap_index_ = index;
+  }
+
+  void swap(word i, word j) {
+    Timer* timer = timers_[i];
+    place(i, timers_[j]);
+    place(j, timer);
+  }
+
+  void sift_up(word index);
+  void sift_down(word index);
 };
 
 class TimerEventSource : public EventSource, public Thread {
@@ -53,7 +107,8 @@ class TimerEventSource : public EventSource, public Thread {
 
   void on_unregister_resource(Locker& locker, Resource* r) override;
 
-  void arm(Timer* timer, int64_t timeout);
+  // Arms the timer. Returns false if we ran out of memory.
+  bool arm(Timer* timer, int64_t timeout);
 
  private:
   void entry() override;
@@ -61,7 +116,7 @@ class TimerEventSource : public EventSource, public Thread {
   static TimerEventSource* instance_;
 
   ConditionVariable* timer_changed_;
-  TimerList timers_;
+  TimerHeap timers_;
   bool stop_;
 };
 
@@ -52,8 +52,15 @@ namespace toit {
   FLAG_BOOL(deploy,  propagate,             false, "Propagate types")               \
   FLAG_BOOL(debug,   trace,                 false, "Trace interpreter")             \
   FLAG_BOOL(debug,   primitives,            false, "Trace primitives")              \
+  FLAG_BOOL(debug,   bytecode_profile,      false, "Count dispatched bytecodes and bytecode sequences") \
+  FLAG_BOOL(debug,   no_superinstructions,  false, "Don't fuse bytecodes into superinstructions") \
+  FLAG_BOOL(deploy,  no_clone_ir,           false, "Resolve again instead of copying the IR for the second -O2 pass") \
   FLAG_BOOL(deploy,  tracegc,               TRACE_GC, "Trace garbage collector")    \
   FLAG_BOOL(debug,   validate_heap,         false, "Check garbage collector")       \
+  FLAG_BOOL(deploy,  incremental_marking,   false, "Mark large old-spaces incrementally") \
+  FLAG_INT(deploy,   chunk_cache_kb,        4096,  "Memory in freed heap chunks kept for reuse") \
+  FLAG_BOOL(deploy,  pretenuring,           false, "Allocate objects from long-lived allocation sites in old-space") \
+  FLAG_BOOL(debug,   trace_pretenuring,     false, "Trace pretenuring decisions") \
   FLAG_BOOL(debug,   gc_a_lot,              false, "Garbage collect after each allocation in the interpreter") \
   FLAG_BOOL(debug,   preempt_a_lot,         false, "Preempt process after each pop bytecode") \
   FLAG_BOOL(debug,   shrink_stacks_a_lot,   false, "Shrink stacks on every GC")     \
@@ -71,6 +78,7 @@ namespace toit {
   FLAG_BOOL(deploy,  enable_asserts,        _ASSERT_DEFAULT, "Enables asserts")     \
   FLAG_BOOL(deploy,  migrate_dash_ids,      false, "Prints migration information for dash identifiers")  \
   FLAG_INT(deploy,   max_recursion_depth,   2000,  "Max recursion depth in the parser") \
+  FLAG_INT(deploy,   parser_threads,        0,     "Threads that parse sources (0: one per core)") \
   FLAG_STRING(deploy, lib_path,             null,  "The library path")              \
   FLAG_STRING(deploy, archive_entry_path,   null,  "The entry path in an archive")  \
   FLAG_STRING(deploy, sandbox,              null,  "syscall-sandbox: compiler or sandbox")  \
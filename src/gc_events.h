@@ -0,0 +1,105 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "utils.h"
+
+namespace toit {
+
+// Keep in sync with the TYPE- constants in lib/system/gc.toit.
+enum GcEventType {
+  GC_EVENT_SCAVENGE = 0,
+  GC_EVENT_MARK_SWEEP = 1,
+  GC_EVENT_COMPACTION = 2,
+  GC_EVENT_CROSS_PROCESS = 3,
+  GC_EVENT_INCREMENTAL_MARK = 4,
+  GC_EVENT_TYPE_COUNT = 5,
+};
+
+struct GcEvent {
+  GcEventType type;
+  int64 start_us;
+  int64 end_us;
+  // Bytes allocated by the process, including external memory.
+  word bytes_before;
+  word bytes_after;
+  // Bytes moved from new-space to old-space.  Only set for scavenges.
+  word promoted;
+};
+
+// The garbage collections of a process, recorded when the process has
+// enabled it with the gc_events_enable primitive.  The last events are
+// kept in a ring buffer, and the pause times of all the events since the
+// log was enabled are counted in a histogram per event type.
+// The log is only touched from the thread that runs the process (or
+// collects its garbage while it is suspended), so it needs no locking.
+class GcEventLog {
+ public:
+#ifdef TOIT_FREERTOS
+  static const int CAPACITY = 16;
+#else
+  static const int CAPACITY = 64;
+#endif
+  // Bucket 0 counts the pauses that took less than a microsecond.  Bucket
+  // i counts the pauses from 2^(i-1) up to 2^i microseconds.  The last
+  // bucket also counts all longer pauses.
+  static const int HISTOGRAM_BUCKETS = 24;
+
+  GcEventLog() {
+    memset(histograms_, 0, sizeof(histograms_));
+  }
+
+  void record(GcEventType type, int64 start_us, int64 end_us, word bytes_before, word bytes_after, word promoted) {
+    GcEvent* event = &events_[recorded_ % CAPACITY];
+    event->type = type;
+    event->start_us = start_us;
+    event->end_us = end_us;
+    event->bytes_before = bytes_before;
+    event->bytes_after = bytes_after;
+    event->promoted = promoted;
+    recorded_++;
+    histograms_[type][bucket_for(end_us - start_us)]++;
+  }
+
+  // The number of events recorded since the log was enabled.  The events
+  // with the sequence numbers from oldest() up to recorded() are still in
+  // the ring buffer.
+  int64 recorded() const { return recorded_; }
+  int64 oldest() const { return Utils::max<int64>(0, recorded_ - CAPACITY); }
+
+  const GcEvent& at(int64 sequence) const {
+    ASSERT(oldest() <= sequence && sequence < recorded_);
+    return events_[sequence % CAPACITY];
+  }
+
+  uint32 histogram(GcEventType type, int bucket) const {
+    return histograms_[type][bucket];
+  }
+
+  static int bucket_for(int64 microseconds) {
+    if (microseconds <= 0) return 0;
+    int bits = 64 - Utils::clz(static_cast<uint64>(microseconds));
+    return Utils::min(bits, HISTOGRAM_BUCKETS - 1);
+  }
+
+ private:
+  GcEvent events_[CAPACITY];
+  int64 recorded_ = 0;
+  uint32 histograms_[GC_EVENT_TYPE_COUNT][HISTOGRAM_BUCKETS];
+};
+
+} // namespace toit
@@ -15,6 +15,7 @@
 
 #include "heap.h"
 
+#include "allocation_sites.h"
 #include "flags.h"
 #include "heap_report.h"
 #include "heap_roots.h"
@@ -37,8 +38,15 @@ namespace toit {
 Instance* ObjectHeap::allocate_instance(Smi* class_id) {
   word size = program()->allocation_instance_size_for(class_id);
   TypeTag class_tag = program()->class_tag_for(class_id);
-  word result_word = allocate_new_space(size);
-  if (!result_word) return null;  // Allocation failure.
+  word result_word;
+  if (allocation_site_ != null) {
+    HeapObject* object = allocate_at_site(size);
+    if (object == null) return null;  // Allocation failure.
+    result_word = object->_raw();
+  } else {
+    result_word = allocate_new_space(size);
+    if (!result_word) return null;  // Allocation failure.
+  }
   // Initialize object.
   Object* null_object = program()->null_object();
   for (word i = WORD_SIZE; i < size; i += WORD_SIZE) {
@@ -49,6 +57,27 @@ Instance* ObjectHeap::allocate_instance(Smi* class_id) {
   return Instance::cast(result);
 }
 
+HeapObject* ObjectHeap::allocate_at_site(word byte_size) {
+  if (allocation_sites_ == null && !allocation_sites_failed_) {
+    allocation_sites_ = _new AllocationSites();
+    allocation_sites_failed_ = allocation_sites_ == null;
+  }
+  AllocationSite* site = allocation_sites_ == null ? null : allocation_sites_->lookup(allocation_site_);
+  if (site != null && site->pretenure) {
+    HeapObject* result = two_space_heap_.allocate_pretenured(byte_size);
+    if (result != null) {
+      pretenured_objects_++;
+      return result;
+    }
+    // Old-space needs a GC first, so we fall back to new-space.
+  }
+  HeapObject* result = two_space_heap_.allocate(byte_size);
+  if (result != null && site != null && two_space_heap_.new_space()->includes(result->_raw())) {
+    allocation_sites_->record_allocation(site, result);
+  }
+  return result;
+}
+
 Array* ObjectHeap::allocate_array(word length, Object* filler) {
   ASSERT(length >= 0);
   ASSERT(length <= Array::max_length_in_process());
@@ -160,11 +189,25 @@ ObjectHeap::~ObjectHeap() {
   clean_up_finalizers(&runnable_finalizers_);
   clean_up_finalizers(&registered_vm_finalizers_);
 
+  delete allocation_sites_;
   OS::dispose(mutex_);
 
+  delete gc_event_log_;
+
   ASSERT(object_notifiers_.is_empty());
 }
 
+bool ObjectHeap::enable_gc_events(bool enable) {
+  if (!enable) {
+    delete gc_event_log_;
+    gc_event_log_ = null;
+  } else if (gc_event_log_ == null) {
+    gc_event_log_ = _new GcEventLog();
+    if (gc_event_log_ == null) return false;
+  }
+  return true;
+}
+
 word ObjectHeap::update_pending_limit() {
   word length = two_space_heap_.size() + external_memory_;
   // We call a new GC when the heap size has doubled, in an attempt to do
@@ -277,6 +320,16 @@ Stack* ObjectHeap::allocate_stack(word length) {
   // Initialize object.
   result->_set_header(program(), program()->stack_class_id());
   Stack::cast(result)->_initialize(length);
+  // The finalizer deducts the stack again if it becomes garbage while it
+  // is still in use by a task.
+  auto node = _new StackFinalizerNode(result, this);
+  if (node == null) {
+    set_last_allocation_result(ALLOCATION_OUT_OF_MEMORY);
+    return null;  // Allocation failure.
+  }
+  registered_vm_finalizers_.append(node);
+  result->set_has_active_finalizer();
+  update_stack_bytes(result->size());
   return result;
 }
 
@@ -295,6 +348,10 @@ void ObjectHeap::iterate_chunks(void* context, process_chunk_callback_t* callbac
   two_space_heap_.iterate_chunks(context, callback);
 }
 
+void ObjectHeap::process_allocation_site_samples(LivenessOracle* from_space) {
+  if (allocation_sites_ != null) allocation_sites_->process_samples(from_space, program_);
+}
+
 GcType ObjectHeap::gc(bool try_hard) {
   Locker locker(mutex_);
   GcType type = two_space_heap_.collect_new_space(try_hard);
@@ -302,6 +359,7 @@ GcType ObjectHeap::gc(bool try_hard) {
   if (type != NEW_SPACE_GC) {
     full_gc_count_++;
     if (type == COMPACTING_GC) full_compacting_gc_count_++;
+    if (allocation_sites_ != null) allocation_sites_->forget_decisions(program_);
     // Update the pending limit that will be installed after the current
     // primitive (that caused the GC) completes.
     update_pending_limit();
@@ -316,6 +374,16 @@ GcType ObjectHeap::gc(bool try_hard) {
   return type;
 }
 
+void ObjectHeap::incremental_marking_step() {
+  Locker locker(mutex_);
+  two_space_heap_.incremental_marking_step();
+}
+
+void ObjectHeap::background_sweep() {
+  Locker locker(mutex_);
+  two_space_heap_.sweep_until(BACKGROUND_SWEEP_SIZE);
+}
+
 // Install a new allocation limit at the end of a primitive that caused a GC.
 void ObjectHeap::install_heap_limit() {
   word total = external_memory_ + two_space_heap_.size();
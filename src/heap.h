@@ -17,6 +17,7 @@
 
 #include <atomic>
 
+#include "gc_events.h"
 #include "heap_roots.h"
 #include "linked.h"
 #include "objects.h"
@@ -26,6 +27,7 @@
 
 namespace toit {
 
+class AllocationSites;
 class ObjectNotifier;
 
 // A class that uses a RAII destructor to free memory already
@@ -56,6 +58,16 @@ class ObjectHeap {
 
   static word max_allocation_size() { return TOIT_PAGE_SIZE - 96; }
 
+  // Arrays that are bigger than max_allocation_size() are allocated in the
+  // large-object space, up to this size.  Embedded platforms have no
+  // large-object space, since it is hard to find big contiguous areas in
+  // their heaps.  There, collections.toit splits big arrays into arraylets.
+#ifdef TOIT_FREERTOS
+  static word max_large_allocation_size() { return max_allocation_size(); }
+#else
+  static word max_large_allocation_size() { return 128 * MB; }
+#endif
+
   inline void do_objects(const std::function<void (HeapObject*)>& func) {
     two_space_heap_.do_objects(func);
   }
@@ -88,6 +100,23 @@ class ObjectHeap {
   int64 bytes_reserved() const { return external_memory_ + two_space_heap_.size(); }
   int64 bytes_allocated() const { return external_memory_ + two_space_heap_.used(); }
   uword external_memory() const { return external_memory_; }
+
+  // Bytes in the stacks of the tasks of the process.  The stacks are
+  // counted when they are allocated and deducted when they are replaced,
+  // detached from a terminated task, shrunk by the GC, or found to be
+  // garbage by the GC.  See StackFinalizerNode.
+  word stack_bytes() const { return stack_bytes_; }
+  void update_stack_bytes(word delta) { stack_bytes_ += delta; }
+  // Deducts a stack that is no longer used by its task.
+  void release_stack(Stack* stack) {
+    update_stack_bytes(-stack->size());
+    stack->clear_has_active_finalizer();
+  }
+
+  // The number of objects that were allocated directly in old-space,
+  // because their allocation site was pretenured.
+  uint64 pretenured_objects() const { return pretenured_objects_; }
+
   bool has_limit() const { return limit_ != max_heap_size_; }
   uword limit() const { return limit_; }
 
@@ -131,6 +160,17 @@ class ObjectHeap {
   // Garbage collection operation for runtime objects.
   GcType gc(bool try_hard);
 
+  bool is_marking_incrementally() const { return two_space_heap_.is_marking_incrementally(); }
+  // Does a slice of an incremental old-space marking.  Called when the
+  // process is preempted.
+  void incremental_marking_step();
+
+  bool has_unswept_chunks() const { return two_space_heap_.has_unswept_chunks(); }
+  // Sweeps some of the old-space chunks that were left unswept by the last
+  // mark-sweep.  Called by idle scheduler threads while the process is
+  // suspended.
+  void background_sweep();
+
   bool add_callable_finalizer(Instance* key, Object* lambda, bool make_weak);
   bool add_vm_finalizer(HeapObject* key);
 
@@ -145,6 +185,16 @@ class ObjectHeap {
     UNREACHABLE();
   }
 
+  // Starts or stops recording the garbage collections of the process.
+  // Returns false if the log could not be allocated.
+  bool enable_gc_events(bool enable);
+  GcEventLog* gc_event_log() const { return gc_event_log_; }
+  bool has_gc_event_log() const { return gc_event_log_ != null; }
+  void record_gc_event(GcEventType type, int64 start_us, int64 end_us, word bytes_before, word bytes_after, word promoted = 0) {
+    if (gc_event_log_ == null) return;
+    gc_event_log_->record(type, start_us, end_us, bytes_before, bytes_after, promoted);
+  }
+
   void add_external_root(HeapRoot* element) { external_roots_.prepend(element); }
   void remove_external_root(HeapRoot* element) { element->unlink(); }
 
@@ -162,8 +212,16 @@ class ObjectHeap {
 
   bool retrying_primitive() const { return retrying_primitive_; }
 
+  // With -Xpretenuring, the allocating bytecodes and primitives set the
+  // bcp of the allocation site before allocating.  See AllocationSites.
+  void set_allocation_site(uint8* bcp) { allocation_site_ = bcp; }
+
+  // Called during a scavenge, with the space the objects are moved from.
+  void process_allocation_site_samples(LivenessOracle* from_space);
+
   void leave_primitive() {
     retrying_primitive_ = false;
+    allocation_site_ = null;
     if (limit_ != pending_limit_) install_heap_limit();
   }
 
@@ -177,9 +235,12 @@ class ObjectHeap {
  private:
   Program* const program_;
   HeapObject* _allocate_raw(word byte_size) {
+    if (allocation_site_ != null) return allocate_at_site(byte_size);
     return two_space_heap_.allocate(byte_size);
   }
 
+  HeapObject* allocate_at_site(word byte_size);
+
   inline word allocate_new_space(word byte_size) {
     return two_space_heap_.allocate_new_space(byte_size);
   }
@@ -187,6 +248,11 @@ class ObjectHeap {
   void install_heap_limit();
 
   bool retrying_primitive_ = false;
+  uint8* allocation_site_ = null;
+  // Allocated on first use, so heaps that never see an allocation site
+  // don't pay for the sites and samples.
+  AllocationSites* allocation_sites_ = null;
+  bool allocation_sites_failed_ = false;
   AllocationResult last_allocation_result_ = ALLOCATION_SUCCESS;
 
   void process_registered_finalizers_helper(FinalizerNodeFifo* list, RootCallback* cb, LivenessOracle* oracle, bool in_closure_queue);
@@ -195,6 +261,8 @@ class ObjectHeap {
   TwoSpaceHeap two_space_heap_;
 
   static const word _UNLIMITED_EXPANSION = 0x7fffffff;
+  // How much a background sweep sweeps before the process can run again.
+  static const uword BACKGROUND_SWEEP_SIZE = 1 * MB;
 
   // Number of bytes used before forcing a GC, including external memory.
   // Set to max_heap_size_ to have no limit.
@@ -216,6 +284,11 @@ class ObjectHeap {
   // A VM finalizer is on this list.
   FinalizerNodeFifo registered_vm_finalizers_;
 
+  GcEventLog* gc_event_log_ = null;  // Only allocated when enabled.
+
+  word stack_bytes_ = 0;
+  uint64 pretenured_objects_ = 0;
+
   int gc_count_ = 0;
   int full_gc_count_ = 0;
   int full_compacting_gc_count_ = 0;
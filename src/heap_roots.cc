@@ -19,6 +19,7 @@
 #include "objects.h"
 #include "objects_inline.h"
 #include "process.h"
+#include "shared_blob.h"
 
 namespace toit {
 
@@ -184,34 +185,67 @@ bool VmFinalizerNode::weak_processing(bool in_closure_queue, RootCallback* cb, L
     cb->do_root(reinterpret_cast<Object**>(&key_));
     return false;  // Don't unlink me.
   }
-  free_external_memory();
+  free_external_memory(true);
   delete this;
   return true;  // Unlink me.
 }
 
-void VmFinalizerNode::free_external_memory() {
+void StackFinalizerNode::roots_do(RootCallback* cb) {
+  cb->do_root(reinterpret_cast<Object**>(&key_));
+}
+
+bool StackFinalizerNode::weak_processing(bool in_closure_queue, RootCallback* cb, LivenessOracle* oracle) {
+  ASSERT(!in_closure_queue);
+  if (!oracle->has_active_finalizer(key_)) {
+    // The stack was already deducted when it was replaced or detached.
+    delete this;
+    return true;  // Unlink me.
+  }
+  if (oracle->is_alive(key_)) {
+    cb->do_root(reinterpret_cast<Object**>(&key_));
+    return false;  // Don't unlink me.
+  }
+  // The task became garbage without terminating.  The dead stack is still
+  // intact, so we can read its size.
+  heap_->update_stack_bytes(-Stack::cast(key_)->size());
+  delete this;
+  return true;  // Unlink me.
+}
+
+void VmFinalizerNode::free_external_memory(bool recycle) {
   uint8* memory = null;
   word accounting_size = 0;
+  bool is_io_buffer = false;
+  bool is_shared = false;
   if (is_byte_array(key_)) {
     ByteArray* byte_array = ByteArray::cast(key_);
     if (byte_array->external_tag() == MappedFileTag) return;  // TODO(erik): release mapped file, so flash storage can be reclaimed.
     ASSERT(byte_array->has_external_address());
     ByteArray::Bytes bytes(byte_array);
     memory = bytes.address();
-    accounting_size = bytes.length();
     // Accounting size is 0 if the byte array is tagged, since we don't account
     // memory for Resources etc.
     ASSERT(byte_array->external_tag() == RawByteTag || byte_array->external_tag() == NullStructTag);
+    accounting_size = byte_array->external_capacity();
+    is_shared = byte_array->is_shared();
+    is_io_buffer = byte_array->is_pooled();
   } else if (is_string(key_)) {
     String* string = String::cast(key_);
     memory = string->as_external();
+    is_shared = string->is_shared();
     // Add one because the strings are allocated with a null termination byte.
     accounting_size = string->length() + 1;
   }
   if (memory != null) {
+    Process* owner = heap_->owner();
+    owner->unregister_external_allocation(accounting_size);
+    if (is_shared) {
+      SharedBlob::release(memory);
+      return;
+    }
+    if (recycle && is_io_buffer && owner->io_buffer_pool()->release(memory)) return;
     if (Flags::allocation) printf("Deleting external memory for string %p\n", memory);
     free(memory);
-    heap_->owner()->unregister_external_allocation(accounting_size);
   }
 }
 
@@ -91,11 +91,26 @@ class VmFinalizerNode : public FinalizerNode {
     : FinalizerNode(key, heap) {}
 
   virtual void roots_do(RootCallback* cb);
-  virtual void heap_dying() { free_external_memory(); }
+  virtual void heap_dying() { free_external_memory(false); }
   virtual bool weak_processing(bool in_closure_queue, RootCallback* visitor, LivenessOracle* oracle);
 
  private:
-  void free_external_memory();
+  // If [recycle] is true, I/O sized buffers are returned to the owner's
+  // I/O buffer pool instead of being freed.
+  void free_external_memory(bool recycle);
+};
+
+// Deducts the size of a task stack from the stack bytes of the heap when
+// the stack becomes garbage.  Stacks that are replaced or detached from a
+// terminated task are deducted right away, and their finalizer bit is
+// cleared, so the node is just dropped at the next GC.
+class StackFinalizerNode : public FinalizerNode {
+ public:
+  StackFinalizerNode(Stack* key, ObjectHeap* heap)
+    : FinalizerNode(key, heap) {}
+
+  virtual void roots_do(RootCallback* cb);
+  virtual bool weak_processing(bool in_closure_queue, RootCallback* visitor, LivenessOracle* oracle);
 };
 
 typedef DoubleLinkedList<ObjectNotifier> ObjectNotifierList;
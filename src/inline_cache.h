@@ -0,0 +1,93 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+// A cache of virtual call targets with a slot for each call site.
+// The slot is picked by the bytecode offset of the invoke bytecode
+// itself, so finding it is a mask and no hashing is involved, and call
+// sites that are close to each other, like the ones in a hot loop, never
+// share a slot.  Each slot holds the targets of the two most recently
+// seen receiver classes, which makes it polymorphic for call sites that
+// see a couple of different classes.
+// Each process has its own cache, and since the program of a process
+// is immutable, entries never have to be invalidated.
+class InlineCache {
+ public:
+#ifdef TOIT_FREERTOS
+  static const int SLOTS = 32;
+#else
+  static const int SLOTS = 128;
+#endif
+  static_assert((SLOTS & (SLOTS - 1)) == 0, "Inline cache size must be a power of two");
+
+  InlineCache() {
+    for (int i = 0; i < SLOTS; i++) {
+      slots_[i].entries[0].call_site = -1;
+      slots_[i].entries[1].call_site = -1;
+    }
+  }
+
+  // Returns the bytecode offset of the header of the cached target, or -1
+  // if the call site hasn't been cached for the given class id. The call
+  // site is the bytecode offset of the invoke bytecode.
+  int32 lookup(int32 call_site, int32 class_id) {
+    Entry* entries = slots_[call_site & (SLOTS - 1)].entries;
+    if (entries[0].call_site == call_site && entries[0].class_id == class_id) {
+      hits_++;
+      return entries[0].target;
+    }
+    if (entries[1].call_site == call_site && entries[1].class_id == class_id) {
+      hits_++;
+      return entries[1].target;
+    }
+    misses_++;
+    return -1;
+  }
+
+  void update(int32 call_site, int32 class_id, int32 target) {
+    Entry* entries = slots_[call_site & (SLOTS - 1)].entries;
+    // Keep the previous entry if it is for the same call site, so the
+    // slot remembers two receiver classes.
+    if (entries[0].call_site == call_site) entries[1] = entries[0];
+    entries[0].call_site = call_site;
+    entries[0].class_id = class_id;
+    entries[0].target = target;
+  }
+
+  uint64 hits() const { return hits_; }
+  uint64 misses() const { return misses_; }
+
+ private:
+  struct Entry {
+    int32 call_site;
+    int32 class_id;
+    int32 target;
+  };
+
+  struct Slot {
+    Entry entries[2];
+  };
+
+  Slot slots_[SLOTS];
+  uint64 hits_ = 0;
+  uint64 misses_ = 0;
+};
+
+} // namespace toit
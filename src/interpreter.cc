@@ -23,7 +23,10 @@
 #include "scheduler.h"
 #include "vm.h"
 
+#include <algorithm>
 #include <cmath> // isnan, isinf
+#include <unordered_map>
+#include <vector>
 
 namespace toit {
 
@@ -282,8 +285,10 @@ Object** Interpreter::handle_stack_overflow(Object** sp, OverflowState* state, M
   }
 
   store_stack(sp);
-  process->task()->stack()->copy_to(new_stack);
+  Stack* old_stack = process->task()->stack();
+  old_stack->copy_to(new_stack);
   process->task()->set_stack(new_stack);
+  process->object_heap()->release_stack(old_stack);
   sp = load_stack();
   *state = OVERFLOW_RESUME;
   return sp;
@@ -302,6 +307,85 @@ void Interpreter::trace(uint8* bcp) {
 #endif
 }
 
+#ifdef TOIT_BYTECODE_PROFILE
+
+// The bytecode profile is shared by all interpreters. It is only
+// collected when running with -Xbytecode_profile, so we don't
+// care about the cost of taking a lock for every bytecode.
+static Mutex* profile_mutex() {
+  static Mutex* mutex = OS::allocate_mutex(100, "Bytecode profile");
+  return mutex;
+}
+
+static uint64 profile_total = 0;
+static uint64 profile_counts[ILLEGAL_END];
+static uint64 profile_pairs[ILLEGAL_END][ILLEGAL_END];
+static std::unordered_map<uint32, uint64> profile_triples;
+
+void Interpreter::profile(uint8* bcp) {
+  uint8 opcode = *bcp;
+  uint8 first = profile_history_[0];
+  uint8 second = profile_history_[1];
+  Locker locker(profile_mutex());
+  profile_total++;
+  profile_counts[opcode]++;
+  if (second != ILLEGAL_END) {
+    profile_pairs[second][opcode]++;
+    if (first != ILLEGAL_END) {
+      profile_triples[(first << 16) | (second << 8) | opcode]++;
+    }
+  }
+  profile_history_[0] = second;
+  profile_history_[1] = opcode;
+}
+
+#define BYTECODE_NAME(name, length, format, print) #name,
+static const char* profile_names[] { BYTECODES(BYTECODE_NAME) "ILLEGAL_END" };
+#undef BYTECODE_NAME
+
+// Prints the most frequent entries. Each entry is a sequence of 'length'
+// opcodes, packed into a uint32 with the first opcode in the highest byte.
+static void print_top(const char* title, std::vector<std::pair<uint64, uint32>>* entries, int length, int limit) {
+  std::sort(entries->begin(), entries->end(), [](const std::pair<uint64, uint32>& a, const std::pair<uint64, uint32>& b) {
+    return a.first > b.first;
+  });
+  printf("%s:\n", title);
+  int count = Utils::min(limit, static_cast<int>(entries->size()));
+  for (int i = 0; i < count; i++) {
+    uint64 hits = (*entries)[i].first;
+    uint32 sequence = (*entries)[i].second;
+    printf("  %12" PRIu64 " %6.2f%%  ", hits, (100.0 * hits) / profile_total);
+    for (int j = length - 1; j >= 0; j--) {
+      printf("%s%s", profile_names[(sequence >> (j * 8)) & 0xff], j == 0 ? "\n" : " + ");
+    }
+  }
+}
+
+void Interpreter::print_profile() {
+  Locker locker(profile_mutex());
+  printf("Dispatched bytecodes: %" PRIu64 "\n", profile_total);
+  if (profile_total == 0) return;
+  std::vector<std::pair<uint64, uint32>> singles;
+  std::vector<std::pair<uint64, uint32>> pairs;
+  std::vector<std::pair<uint64, uint32>> triples;
+  for (int i = 0; i < ILLEGAL_END; i++) {
+    if (profile_counts[i] != 0) singles.push_back(std::make_pair(profile_counts[i], i));
+    for (int j = 0; j < ILLEGAL_END; j++) {
+      uint64 count = profile_pairs[i][j];
+      if (count != 0) pairs.push_back(std::make_pair(count, (i << 8) | j));
+    }
+  }
+  for (auto it : profile_triples) {
+    triples.push_back(std::make_pair(it.second, it.first));
+  }
+  print_top("Bytecodes", &singles, 1, 30);
+  print_top("Bytecode pairs", &pairs, 2, 30);
+  print_top("Bytecode triples", &triples, 3, 30);
+  fflush(stdout);
+}
+
+#endif  // TOIT_BYTECODE_PROFILE
+
 Object* Interpreter::float_op(Process* process, Object* a, Object* b, double_op* op) {
   word word_result = process->object_heap()->allocate_new_space(Double::allocation_size());
   if (!word_result) return NULL;
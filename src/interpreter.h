@@ -40,10 +40,18 @@
 #define INTERPRETER_HELPER
 #endif
 
+#if defined(TOIT_DEBUG) && !defined(TOIT_FREERTOS)
+// The bytecode profiler (-Xbytecode_profile) is only compiled into
+// debug builds on hosted platforms.
+#define TOIT_BYTECODE_PROFILE
+#endif
+
 namespace toit {
 
 typedef double (double_op)(double a, double b);
 
+class InlineCache;
+
 class Interpreter {
  public:
   // Number of words that are pushed onto the stack whenever there is a call.
@@ -151,6 +159,11 @@ class Interpreter {
   static bool are_smis(Object* a, Object* b);
   static bool are_floats(Object* a, Object* b);
 
+#ifdef TOIT_BYTECODE_PROFILE
+  // Prints the bytecode profile collected with -Xbytecode_profile.
+  static void print_profile();
+#endif
+
  private:
   Object** const PREEMPTION_MARKER = reinterpret_cast<Object**>(UINTPTR_MAX);
   Process* process_;
@@ -167,6 +180,13 @@ class Interpreter {
   // Preemption method.
   uint8* preemption_method_header_bcp_;
 
+#ifdef TOIT_BYTECODE_PROFILE
+  // The two most recently dispatched opcodes, used for profiling.
+  uint8 profile_history_[2] = { ILLEGAL_END, ILLEGAL_END };
+
+  void profile(uint8* bcp);
+#endif
+
   void trace(uint8* bcp);
   Method lookup_entry();
 
@@ -186,6 +206,8 @@ class Interpreter {
 
   inline bool is_true_value(Program* program, Object* value) const;
 
+  inline Method find_method(Program* program, InlineCache* cache, uint8* call_site, Object* receiver, word offset);
+
   inline bool typecheck_class(Program* program, Object* value, int class_index, bool is_nullable) const;
   inline bool typecheck_interface(Program* program, Object* value, int interface_selector_index, bool is_nullable) const;
 
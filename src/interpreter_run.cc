@@ -96,10 +96,37 @@ Method Program::find_method(Object* receiver, word offset) {
   return entry;
 }
 
+inline Method Interpreter::find_method(Program* program,
+                                       InlineCache* cache,
+                                       uint8* call_site,
+                                       Object* receiver,
+                                       word offset) {
+  Smi* class_id = is_smi(receiver) ? program->smi_class_id() : HeapObject::cast(receiver)->class_id();
+  int32 id = Smi::value(class_id);
+  int32 site = call_site - program->bytecodes.data();
+  int32 cached = cache->lookup(site, id);
+  if (cached >= 0) {
+    Method target(program->bytecodes, cached);
+    ASSERT(target.selector_offset() == offset);
+    return target;
+  }
+  Method target = program->find_method(receiver, offset);
+  // Lookup failures are rare and go through the slow path, so we
+  // only cache successful lookups.
+  if (target.is_valid()) cache->update(site, id, target.header_bcp() - program->bytecodes.data());
+  return target;
+}
+
 // OPCODE_TRACE is only called from within Interpreter::run which gives access to:
 //   uint8* bcp;
-#define OPCODE_TRACE() \
+#ifdef TOIT_BYTECODE_PROFILE
+#define OPCODE_TRACE()                    \
+  if (Flags::trace) trace(bcp);           \
+  if (Flags::bytecode_profile) profile(bcp);
+#else
+#define OPCODE_TRACE()                    \
   if (Flags::trace) trace(bcp);
+#endif
 
 // Dispatching helper macros.
 #define DISPATCH(n)                                                                \
@@ -293,6 +320,7 @@ Interpreter::Result Interpreter::run() {
 
   // Interpretation state.
   Program* program = process_->program();
+  InlineCache* inline_cache = process_->inline_cache();
 #ifdef TOIT_CHECK_PROPAGATED_TYPES
   compiler::TypeDatabase* propagated_types = compiler::TypeDatabase::compute(program);
 #endif
@@ -536,6 +564,7 @@ Interpreter::Result Interpreter::run() {
 
   OPCODE_BEGIN_WITH_WIDE(ALLOCATE, class_index);
     process_->set_current_bcp(bcp);
+    if (Flags::pretenuring) process_->object_heap()->set_allocation_site(bcp);
     Object* result = process_->object_heap()->allocate_instance(Smi::from(class_index));
     for (int attempts = 1; result == null && attempts < 4; attempts++) {
 #ifdef TOIT_GC_LOGGING
@@ -698,7 +727,7 @@ Interpreter::Result Interpreter::run() {
   OPCODE_BEGIN_WITH_WIDE(INVOKE_VIRTUAL, stack_offset);
     Object* receiver = STACK_AT(stack_offset);
     word selector_offset = Utils::read_unaligned_uint16(bcp + 2);
-    Method target = program->find_method(receiver, selector_offset);
+    Method target = find_method(program, inline_cache, bcp, receiver, selector_offset);
     if (!target.is_valid()) {
       PUSH(receiver);
       PUSH(Smi::from(selector_offset));
@@ -710,7 +739,7 @@ Interpreter::Result Interpreter::run() {
   OPCODE_BEGIN(INVOKE_VIRTUAL_GET);
     Object* receiver = STACK_AT(0);
     word offset = Utils::read_unaligned_uint16(bcp + 1);
-    Method target = program->find_method(receiver, offset);
+    Method target = find_method(program, inline_cache, bcp, receiver, offset);
     if (!target.is_valid()) {
       PUSH(receiver);
       PUSH(Smi::from(offset));
@@ -742,7 +771,7 @@ Interpreter::Result Interpreter::run() {
   OPCODE_BEGIN(INVOKE_VIRTUAL_SET);
     Object* receiver = STACK_AT(1);
     word offset = Utils::read_unaligned_uint16(bcp + 1);
-    Method target = program->find_method(receiver, offset);
+    Method target = find_method(program, inline_cache, bcp, receiver, offset);
     if (!target.is_valid()) {
       PUSH(receiver);
       PUSH(Smi::from(offset));
@@ -766,7 +795,7 @@ Interpreter::Result Interpreter::run() {
 
   INVOKE_VIRTUAL_FALLBACK: {
     Object* receiver = POP();
-    Method target = program->find_method(receiver, index__);
+    Method target = find_method(program, inline_cache, bcp, receiver, index__);
     if (!target.is_valid()) {
       PUSH(receiver);
       PUSH(Smi::from(index__));
@@ -1095,13 +1124,20 @@ Interpreter::Result Interpreter::run() {
       Method target = program->primitive_lookup_failure();
       CALL_METHOD(target, PRIMITIVE_LENGTH);
     } else {
-      process_->set_current_bcp(bcp);
       int arity = primitive->arity;
       Primitive::Entry* entry = reinterpret_cast<Primitive::Entry*>(primitive->function);
 
-      sp_ = sp;
-      Object* result = entry(process_, sp + parameter_offset + arity - 1); // Skip the frame.
-      sp = sp_;
+      Object* result;
+      if (primitive->is_fast) {
+        // Fast primitives can't trigger a GC, so there is no need to make
+        // the stack pointer and the current bcp visible to the process.
+        result = entry(process_, sp + parameter_offset + arity - 1); // Skip the frame.
+      } else {
+        process_->set_current_bcp(bcp);
+        sp_ = sp;
+        result = entry(process_, sp + parameter_offset + arity - 1); // Skip the frame.
+        sp = sp_;
+      }
 
       for (int attempts = 1; true; attempts++) {
         if (!Primitive::is_error(result)) goto done;
@@ -1130,6 +1166,9 @@ Interpreter::Result Interpreter::run() {
         }
 #endif
 
+        // Fast primitives that failed to allocate are retried like all
+        // other primitives, which requires the interpreter state.
+        process_->set_current_bcp(bcp);
         sp = gc(sp, malloc_failed, attempts, force_cross_process, "primitive", primitive_module, primitive_index);
         sp_ = sp;
         result = entry(process_, sp + parameter_offset + arity - 1); // Skip the frame.
@@ -1591,6 +1630,94 @@ Interpreter::Result Interpreter::run() {
 #endif
   }
   OPCODE_END();
+
+  // Superinstructions. The fused bytecode is still present after the
+  // superinstruction, so the slow paths just behave like the unfused
+  // bytecode and let the fused bytecode be dispatched as usual.
+#define FUSED_BRANCH_IF_FALSE(condition)                               \
+    DROP(2);                                                           \
+    bcp += _length_;                                                   \
+    if (!(condition)) {                                                \
+      bcp += Utils::read_unaligned_uint16(bcp + 1);                    \
+      DISPATCH(0);                                                     \
+    }                                                                  \
+    DISPATCH(BRANCH_IF_FALSE_LENGTH)
+
+  OPCODE_BEGIN(INVOKE_EQ_BRANCH_IF_FALSE);
+    ASSERT(bcp[_length_] == BRANCH_IF_FALSE);
+    Object* a0 = STACK_AT(1);
+    Object* a1 = STACK_AT(0);
+    bool condition;
+    if (a0 == a1) {
+      // All identical objects, except for NaNs, are equal to themselves.
+      condition = !(is_double(a0) && isnan(Double::cast(a0)->value()));
+    } else if (a0 == program->null_object() || a1 == program->null_object()) {
+      condition = false;
+    } else if (are_smis(a0, a1)) {
+      // Smis are only equal if they are identical.
+      condition = false;
+    } else if (int result = compare_numbers(a0, a1)) {
+      condition = (result & COMPARE_FLAG_EQUAL) != 0;
+    } else {
+      PUSH(a0);
+      index__ = program->invoke_bytecode_offset(INVOKE_EQ);
+      goto INVOKE_VIRTUAL_FALLBACK;
+    }
+    FUSED_BRANCH_IF_FALSE(condition);
+  OPCODE_END();
+
+#define INVOKE_RELATIONAL_BRANCH_IF_FALSE(opcode, base, op, bit)       \
+  OPCODE_BEGIN(opcode);                                                \
+    ASSERT(bcp[_length_] == BRANCH_IF_FALSE);                          \
+    Object* a0 = STACK_AT(1);                                          \
+    Object* a1 = STACK_AT(0);                                          \
+    bool condition;                                                    \
+    if (are_smis(a0, a1)) {                                            \
+      condition = Smi::value(a0) op Smi::value(a1);                    \
+    } else if (int result = compare_numbers(a0, a1)) {                 \
+      condition = (result & bit) != 0;                                 \
+    } else {                                                           \
+      PUSH(a0);                                                        \
+      index__ = program->invoke_bytecode_offset(base);                 \
+      goto INVOKE_VIRTUAL_FALLBACK;                                    \
+    }                                                                  \
+    FUSED_BRANCH_IF_FALSE(condition);                                  \
+  OPCODE_END();
+
+  INVOKE_RELATIONAL_BRANCH_IF_FALSE(INVOKE_LT_BRANCH_IF_FALSE,  INVOKE_LT,  <  , COMPARE_FLAG_STRICTLY_LESS)
+  INVOKE_RELATIONAL_BRANCH_IF_FALSE(INVOKE_GT_BRANCH_IF_FALSE,  INVOKE_GT,  >  , COMPARE_FLAG_STRICTLY_GREATER)
+  INVOKE_RELATIONAL_BRANCH_IF_FALSE(INVOKE_LTE_BRANCH_IF_FALSE, INVOKE_LTE, <= , COMPARE_FLAG_LESS_EQUAL)
+  INVOKE_RELATIONAL_BRANCH_IF_FALSE(INVOKE_GTE_BRANCH_IF_FALSE, INVOKE_GTE, >= , COMPARE_FLAG_GREATER_EQUAL)
+#undef INVOKE_RELATIONAL_BRANCH_IF_FALSE
+#undef FUSED_BRANCH_IF_FALSE
+
+#define INVOKE_ARITHMETIC_STORE_LOCAL_POP(opcode, base, op, fop)       \
+  OPCODE_BEGIN(opcode);                                                \
+    ASSERT(bcp[_length_] == STORE_LOCAL_POP);                          \
+    Object* a0 = STACK_AT(1);                                          \
+    Object* a1 = STACK_AT(0);                                          \
+    Object* result = null;                                             \
+    Smi* smi_result;                                                   \
+    if (op(a0, a1, &smi_result)) {                                     \
+      result = smi_result;                                             \
+    } else if (Interpreter::are_floats(a0, a1)) {                      \
+      result = float_op(process(), a0, a1, fop);                       \
+    }                                                                  \
+    if (result == null) {                                              \
+      PUSH(a0);                                                        \
+      index__ = program->invoke_bytecode_offset(base);                 \
+      goto INVOKE_VIRTUAL_FALLBACK;                                    \
+    }                                                                  \
+    DROP(2);                                                           \
+    bcp += _length_;                                                   \
+    B_ARG1(stack_offset);                                              \
+    STACK_AT_PUT(stack_offset - 1, result);                            \
+    DISPATCH(STORE_LOCAL_POP_LENGTH);                                  \
+  OPCODE_END();
+
+  INVOKE_ARITHMETIC_STORE_LOCAL_POP(INVOKE_ADD_STORE_LOCAL_POP, INVOKE_ADD, intrinsic_add, &double_add)
+  INVOKE_ARITHMETIC_STORE_LOCAL_POP(INVOKE_SUB_STORE_LOCAL_POP, INVOKE_SUB, intrinsic_sub, &double_sub)
+#undef INVOKE_ARITHMETIC_STORE_LOCAL_POP
 }
 
 #undef DISPATCH
@@ -1714,30 +1841,29 @@ Object** Interpreter::hash_find(Object** sp, Program* program, Interpreter::Hash
     }
   }
   Object* index_object = collection->at(Instance::MAP_INDEX_INDEX);
-  word index_mask;
+  word index_mask = 0;
+  bool bail = true;
   if (is_array(index_object)) {
+    // Arrays in the large-object space can be long too.
     index_mask = Array::cast(index_object)->length() - 1;
-    ASSERT(Array::ARRAYLET_SIZE < (Smi::MAX_SMI_VALUE >> HASH_SHIFT_));
-  } else {
-    bool bail = true;
-    if (is_instance(index_object) && HeapObject::cast(index_object)->class_id() == program->large_array_class_id()) {
-      Object* size_object = Instance::cast(index_object)->at(Instance::LARGE_ARRAY_SIZE_INDEX);
-      if (is_smi(size_object)) {
-        index_mask = Smi::value(size_object) - 1;
-        bail = false;
-      }
-    }
-    if (bail || index_mask >= (Smi::MAX_SMI_VALUE >> HASH_SHIFT_)) {
-      // We don't want to run into number allocation problems when we construct
-      // the hash-and-position.  This is basically only an issue on the server
-      // in the 32 bit VM - others don't have enough memory to hit it.  Bail out.
-      // Leave one value on the stack, which the compiler expects to find as
-      // the result of the intrinsic.
-      DROP(NUMBER_OF_BYTECODE_LOCALS - 1);
-      *action_return = kBail;
-      return sp;
+    bail = false;
+  } else if (is_instance(index_object) && HeapObject::cast(index_object)->class_id() == program->large_array_class_id()) {
+    Object* size_object = Instance::cast(index_object)->at(Instance::LARGE_ARRAY_SIZE_INDEX);
+    if (is_smi(size_object)) {
+      index_mask = Smi::value(size_object) - 1;
+      bail = false;
     }
   }
+  if (bail || index_mask >= (Smi::MAX_SMI_VALUE >> HASH_SHIFT_)) {
+    // We don't want to run into number allocation problems when we construct
+    // the hash-and-position.  This is basically only an issue on the server
+    // in the 32 bit VM - others don't have enough memory to hit it.  Bail out.
+    // Leave one value on the stack, which the compiler expects to find as
+    // the result of the intrinsic.
+    DROP(NUMBER_OF_BYTECODE_LOCALS - 1);
+    *action_return = kBail;
+    return sp;
+  }
   ASSERT(Utils::is_power_of_two(index_mask + 1));
 
   word hash = Smi::value(hash_object);
@@ -0,0 +1,69 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "objects.h"
+
+namespace toit {
+
+// A small per-process cache of malloced buffers of the preferred I/O size.
+// Network reads produce a steady stream of equally sized external byte
+// arrays that die young.  Instead of returning their backing store to
+// malloc when they are finalized, we keep a few around and hand them out
+// again for the next read.
+// Byte arrays backed by these buffers are marked as pooled.  Only reads
+// that fill a whole buffer use one; a short read is copied into a byte
+// array of the right size and the buffer goes straight back to the pool.
+// Buffers in the pool are not accounted as external memory of the process.
+// The pool is only touched from the thread that runs the process (or
+// collects its garbage), so it needs no locking.
+class IoBufferPool {
+ public:
+#ifdef TOIT_FREERTOS
+  static const int CAPACITY = 2;
+#else
+  static const int CAPACITY = 8;
+#endif
+  static const word BUFFER_SIZE = ByteArray::PREFERRED_IO_BUFFER_SIZE;
+
+  ~IoBufferPool() {
+    while (count_ > 0) free(buffers_[--count_]);
+  }
+
+  // Returns a buffer of BUFFER_SIZE bytes, or null if the pool is empty.
+  uint8* acquire() {
+    if (count_ == 0) return null;
+    return buffers_[--count_];
+  }
+
+  // Takes ownership of the given buffer, which must have been malloced with
+  // a size of BUFFER_SIZE.  Returns false if the pool is full, in which case
+  // the caller is still responsible for freeing the buffer.
+  bool release(uint8* buffer) {
+    if (count_ == CAPACITY) return false;
+    buffers_[count_++] = buffer;
+    return true;
+  }
+
+  int count() const { return count_; }
+
+ private:
+  int count_ = 0;
+  uint8* buffers_[CAPACITY];
+};
+
+} // namespace toit
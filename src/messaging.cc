@@ -19,6 +19,7 @@
 #include "objects.h"
 #include "process.h"
 #include "scheduler.h"
+#include "shared_blob.h"
 #include "vm.h"
 
 #include "objects_inline.h"
@@ -43,6 +44,11 @@ enum MessageTag {
   TAG_STRING_INLINE,
   TAG_BYTE_ARRAY,
   TAG_BYTE_ARRAY_INLINE,
+
+  // Strings and frozen byte arrays backed by a SharedBlob.  Never used
+  // for TISON.
+  TAG_SHARED_STRING,
+  TAG_SHARED_BYTE_ARRAY,
 };
 
 static int TISON_VERSION = 1;
@@ -72,19 +78,80 @@ SystemMessage::SystemMessage(int type, int gid, int pid, MessageEncoder* encoder
     : type_(type)
     , gid_(gid)
     , pid_(pid)
-    , data_(encoder->take_buffer()) {}
+    , data_capacity_(encoder->pooled_capacity()) {
+  data_ = encoder->take_buffer();
+}
 
 SystemMessage::SystemMessage(int type, int gid, int pid, uint8* data)
     : type_(type)
     , gid_(gid)
     , pid_(pid)
-    , data_(data) {}
+    , data_(data)
+    , data_capacity_(0) {}
 
 void SystemMessage::free_data_and_externals() {
-  MessageDecoder::deallocate(data_);
+  MessageDecoder::deallocate_externals(data_);
+  free_buffer();
   data_ = null;
 }
 
+void SystemMessage::free_buffer() {
+  if (data_capacity_ != 0) {
+    MessageBufferPool::release(data_, data_capacity_);
+  } else {
+    free(data_);
+  }
+}
+
+MessageBufferPool::MessageBufferPool() {
+  for (int i = 0; i < CLASSES; i++) counts_[i] = 0;
+}
+
+MessageBufferPool::~MessageBufferPool() {
+  for (int i = 0; i < CLASSES; i++) {
+    for (int j = 0; j < counts_[i]; j++) free(buffers_[i][j]);
+  }
+}
+
+MessageBufferPool* MessageBufferPool::current() {
+  SchedulerThread* thread = Scheduler::current_scheduler_thread();
+  return thread ? thread->message_buffer_pool() : null;
+}
+
+int MessageBufferPool::size_class(word size) {
+  int index = 0;
+  while ((static_cast<word>(1) << (index + MIN_SIZE_LOG2)) < size) index++;
+  return index;
+}
+
+uint8* MessageBufferPool::allocate(word size, word* capacity) {
+  MessageBufferPool* pool = current();
+  if (pool == null || size > MAX_SIZE) {
+    *capacity = 0;
+    return unvoid_cast<uint8*>(malloc(size));
+  }
+  int index = size_class(size);
+  *capacity = static_cast<word>(1) << (index + MIN_SIZE_LOG2);
+  if (pool->counts_[index] > 0) return pool->buffers_[index][--pool->counts_[index]];
+  uint8* result = unvoid_cast<uint8*>(malloc(*capacity));
+  if (result == null) *capacity = 0;
+  return result;
+}
+
+void MessageBufferPool::release(uint8* buffer, word capacity) {
+  MessageBufferPool* pool = current();
+  if (pool != null && buffer != null) {
+    ASSERT(capacity <= MAX_SIZE);
+    int index = size_class(capacity);
+    ASSERT((static_cast<word>(1) << (index + MIN_SIZE_LOG2)) == capacity);
+    if (pool->counts_[index] < BUFFERS_PER_CLASS) {
+      pool->buffers_[index][pool->counts_[index]++] = buffer;
+      return;
+    }
+  }
+  free(buffer);
+}
+
 MessageEncoder::MessageEncoder(Process* process, uint8* buffer, MessageFormat format, bool take_ownership_of_buffer)
     : process_(process)
     , program_(process ? process->program() : null)
@@ -100,14 +167,22 @@ void MessageEncoder::encode_process_message(uint8* buffer, uint8 value) {
 }
 
 MessageEncoder::~MessageEncoder() {
-  for (unsigned i = 0; i < copied_count_; i++) {
+  for (unsigned i = 0; i < copied_count(); i++) {
     free(copied_[i]);
   }
-  if (take_ownership_of_buffer_) free(buffer_);
+  for (unsigned i = 0; i < shared_count(); i++) {
+    SharedBlob::release(shared_[i]);
+  }
+  if (!take_ownership_of_buffer_) return;
+  if (pooled_capacity_ != 0) {
+    MessageBufferPool::release(buffer_, pooled_capacity_);
+  } else {
+    free(buffer_);
+  }
 }
 
 uint8* MessageEncoder::take_buffer() {
-  for (unsigned i = 0; i < externals_count_; i++) {
+  for (unsigned i = 0; i < externals_count(); i++) {
     ByteArray* array = externals_[i];
     // Neuter the byte array. The contents of the array is now linked to from
     // an enqueued SystemMessage and will be used to construct a new external
@@ -118,9 +193,12 @@ uint8* MessageEncoder::take_buffer() {
     // collector does not have to deal with disposing a neutered byte array.
     array->clear_has_active_finalizer();
   }
-  for (unsigned i = 0; i < copied_count_; i++) {
+  for (unsigned i = 0; i < copied_count(); i++) {
     copied_[i] = null;
   }
+  for (unsigned i = 0; i < shared_count(); i++) {
+    shared_[i] = null;
+  }
 
   uint8* result = buffer_;
   buffer_ = null;
@@ -202,6 +280,9 @@ bool MessageEncoder::encode_any(Object* object) {
     } else if (class_id == program->map_class_id()) {
       return encode_map(instance);
     } else if (class_id == program->byte_array_cow_class_id()) {
+      if (instance->at(Instance::BYTE_ARRAY_COW_IS_MUTABLE_INDEX) == program->false_object()) {
+        return encode_copy(object, TAG_SHARED_BYTE_ARRAY);
+      }
       return encode_copy(object, TAG_BYTE_ARRAY);
     } else if (class_id == program->byte_array_slice_class_id()) {
       return encode_copy(object, TAG_BYTE_ARRAY);
@@ -319,11 +400,12 @@ bool MessageEncoder::encode_byte_array(ByteArray* object) {
   write_uint8(TAG_BYTE_ARRAY);
   write_cardinal(bytes.length());
   write_pointer(bytes.address());
-  if (externals_count_ >= MESSAGING_ENCODING_MAX_EXTERNALS) {
-    too_many_externals_ = true;
+  // There is no limit on the number of externals, but tracking many of them
+  // needs memory.  They are only needed when we're really encoding.
+  if (!encoding_for_size() && !externals_.append(object)) {
+    malloc_failed_ = true;
     return false;
   }
-  externals_[externals_count_++] = object;
   return true;
 }
 
@@ -357,11 +439,11 @@ bool MessageEncoder::encode_bytes_external(void* data, word length, bool free_on
   write_cardinal(length);
   write_pointer(data);
   if (!encoding_for_size() && free_on_failure) {
-    if (copied_count() >= ARRAY_SIZE(copied_)) {
-      // TODO(kasper): Report meaningful error.
+    if (!copied_.append(data)) {
+      free(data);
+      malloc_failed_ = true;
       return false;
     }
-    copied_[copied_count_++] = data;
   }
   return true;
 }
@@ -409,7 +491,7 @@ bool MessageEncoder::encode_rpc_reply_external(int id,
 }
 
 bool MessageEncoder::encode_copy(Object* object, int tag) {
-  ASSERT(tag == TAG_STRING || tag == TAG_BYTE_ARRAY);
+  ASSERT(tag == TAG_STRING || tag == TAG_BYTE_ARRAY || tag == TAG_SHARED_BYTE_ARRAY);
   ASSERT(TAG_STRING_INLINE == TAG_STRING + 1);
   ASSERT(TAG_BYTE_ARRAY_INLINE == TAG_BYTE_ARRAY + 1);
 
@@ -422,6 +504,8 @@ bool MessageEncoder::encode_copy(Object* object, int tag) {
 
   // To avoid too many small allocations, we inline the content of the small strings or byte arrays.
   if (encoding_tison() || length <= MESSAGING_ENCODING_MAX_INLINED_SIZE) {
+    // Frozen byte arrays arrive as mutable byte arrays when they are inlined.
+    if (tag == TAG_SHARED_BYTE_ARRAY) tag = TAG_BYTE_ARRAY;
     write_uint8(tag + 1);
     write_cardinal(length);
     if (!encoding_for_size()) {
@@ -432,6 +516,12 @@ bool MessageEncoder::encode_copy(Object* object, int tag) {
   }
 
   ASSERT(!encoding_tison());
+  // Strings are immutable, so the receiver can share their content.
+  if (tag == TAG_STRING) tag = TAG_SHARED_STRING;
+  if (tag == TAG_SHARED_STRING || tag == TAG_SHARED_BYTE_ARRAY) {
+    return encode_shared(object, source, length, tag);
+  }
+
   void* data = null;
   if (!encoding_for_size()) {
     // Strings are '\0'-terminated, so we need to make sure the allocated
@@ -444,11 +534,11 @@ bool MessageEncoder::encode_copy(Object* object, int tag) {
       malloc_failed_ = true;
       return false;
     }
-    if (copied_count_ >= ARRAY_SIZE(copied_)) {
-      // TODO(kasper): Report meaningful error.
+    if (!copied_.append(data)) {
+      free(data);
+      malloc_failed_ = true;
       return false;
     }
-    copied_[copied_count_++] = data;
     memcpy(data, source, length + extra);
   }
   write_uint8(tag);
@@ -457,6 +547,62 @@ bool MessageEncoder::encode_copy(Object* object, int tag) {
   return true;
 }
 
+bool MessageEncoder::encode_shared(Object* object, const uint8* source, word length, int tag) {
+  ASSERT(!encoding_tison());
+  const uint8* content = null;
+  if (!encoding_for_size()) {
+    content = shared_content(object, source, length, tag);
+    if (content == null) {
+      malloc_failed_ = true;
+      return false;
+    }
+    if (!shared_.append(content)) {
+      SharedBlob::release(content);
+      malloc_failed_ = true;
+      return false;
+    }
+  }
+  write_uint8(tag);
+  write_cardinal(length);
+  write_pointer(const_cast<uint8*>(content));
+  return true;
+}
+
+const uint8* MessageEncoder::shared_content(Object* object, const uint8* source, word length, int tag) {
+  if (tag == TAG_SHARED_STRING && is_string(object)) {
+    String* string = String::cast(object);
+    if (string->is_shared()) {
+      SharedBlob::retain(source);
+      return source;
+    }
+    // External strings that the process owns are moved to a blob, so
+    // sending them again doesn't copy them again.  Strings in the
+    // program and strings without a finalizer don't own their content.
+    bool owned = !string->content_on_heap() &&
+        !string->on_program_heap(process_) &&
+        string->has_active_finalizer();
+    HeapTagScope scope(ITERATE_CUSTOM_TAGS + EXTERNAL_STRING_MALLOC_TAG);
+    const uint8* content = SharedBlob::allocate(source, length);
+    if (content == null || !owned) return content;
+    // For external strings the source is the external content.
+    uint8* previous = const_cast<uint8*>(source);
+    string->set_shared_external_address(content);
+    free(previous);
+    SharedBlob::retain(content);
+    return content;
+  }
+  if (tag == TAG_SHARED_BYTE_ARRAY) {
+    Object* backing = Instance::cast(object)->at(Instance::BYTE_ARRAY_COW_BACKING_INDEX);
+    if (is_byte_array(backing) && ByteArray::cast(backing)->is_shared()) {
+      SharedBlob::retain(source);
+      return source;
+    }
+  }
+  int heap_tag = (tag == TAG_SHARED_STRING) ? EXTERNAL_STRING_MALLOC_TAG : EXTERNAL_BYTE_ARRAY_MALLOC_TAG;
+  HeapTagScope scope(ITERATE_CUSTOM_TAGS + heap_tag);
+  return SharedBlob::allocate(source, length);
+}
+
 void MessageEncoder::write_pointer(void* value) {
   if (!encoding_for_size()) memcpy(&buffer_[cursor_], &value, WORD_SIZE);
   cursor_ += WORD_SIZE;
@@ -505,26 +651,21 @@ void MessageDecoder::register_external_allocations() {
   ASSERT(!decoding_tison());
   ObjectHeap* heap = process_->object_heap();
   for (unsigned i = 0; i < externals_count(); i++) {
-    heap->register_external_allocation(externals_sizes_[i]);
+    heap->register_external_allocation(externals_[i].length);
   }
 }
 
 void MessageDecoder::remove_disposing_finalizers() {
   ASSERT(!decoding_tison());
   for (unsigned i = 0; i < externals_count(); i++) {
-    externals_[i]->clear_has_active_finalizer();
+    externals_[i].object->clear_has_active_finalizer();
   }
 }
 
-void MessageDecoder::register_external(HeapObject* object, word length) {
+bool MessageDecoder::register_external(HeapObject* object, word length) {
   ASSERT(!decoding_tison());
-  unsigned index = externals_count();
-  if (index >= ARRAY_SIZE(externals_)) {
-    FATAL("[message decoder: too many externals: %d]", index + 1);
-  }
-  externals_[index] = object;
-  externals_sizes_[index] = length;
-  externals_count_++;
+  External external = { object, length };
+  return externals_.append(external);
 }
 
 Object* TisonDecoder::decode() {
@@ -571,6 +712,10 @@ Object* MessageDecoder::decode_any() {
       return decode_byte_array(false);
     case TAG_BYTE_ARRAY_INLINE:
       return decode_byte_array(true);
+    case TAG_SHARED_STRING:
+      return decode_shared_string();
+    case TAG_SHARED_BYTE_ARRAY:
+      return decode_shared_byte_array();
     case TAG_DOUBLE:
       return decode_double();
     case TAG_LARGE_INTEGER:
@@ -588,10 +733,15 @@ Object* MessageDecoder::decode_any() {
 }
 
 void MessageDecoder::deallocate(uint8* buffer) {
+  if (buffer == null) return;
+  deallocate_externals(buffer);
+  free(buffer);
+}
+
+void MessageDecoder::deallocate_externals(uint8* buffer) {
   if (buffer == null) return;
   MessageDecoder decoder(buffer);
   decoder.deallocate();
-  free(buffer);
 }
 
 void MessageDecoder::deallocate() {
@@ -610,6 +760,11 @@ void MessageDecoder::deallocate() {
       read_cardinal();
       free(read_pointer());
       break;
+    case TAG_SHARED_STRING:
+    case TAG_SHARED_BYTE_ARRAY:
+      read_cardinal();
+      SharedBlob::release(read_pointer());
+      break;
     case TAG_STRING_INLINE:
     case TAG_BYTE_ARRAY_INLINE: {
       word length = read_cardinal();
@@ -645,7 +800,10 @@ Object* MessageDecoder::decode_string(bool inlined) {
   } else {
     uint8* data = read_pointer();
     result = process_->object_heap()->allocate_external_string(length, data, true);
-    if (result) register_external(result, length + 1);  // Account for '\0'-termination.
+    if (result && !register_external(result, length + 1)) {  // Account for '\0'-termination.
+      result->clear_has_active_finalizer();
+      result = null;
+    }
   }
   if (result == null) return mark_allocation_failed();
   return result;
@@ -706,9 +864,48 @@ Object* MessageDecoder::decode_byte_array(bool inlined) {
   } else {
     uint8* data = read_pointer();
     result = process_->object_heap()->allocate_external_byte_array(length, data, true, false);
-    if (result) register_external(result, length);
+    if (result && !register_external(result, length)) {
+      result->clear_has_active_finalizer();
+      result = null;
+    }
+  }
+  if (result == null) return mark_allocation_failed();
+  return result;
+}
+
+Object* MessageDecoder::decode_shared_string() {
+  if (decoding_tison()) return mark_malformed();
+  word length = read_cardinal();
+  uint8* data = read_pointer();
+  // The message's reference to the blob is taken over by the string.
+  String* result = process_->object_heap()->allocate_external_string(length, data, true);
+  if (result == null) return mark_allocation_failed();
+  result->set_shared_external_address(data);
+  if (!register_external(result, length + 1)) {  // Account for '\0'-termination.
+    result->clear_has_active_finalizer();
+    return mark_allocation_failed();
   }
+  return result;
+}
+
+Object* MessageDecoder::decode_shared_byte_array() {
+  if (decoding_tison()) return mark_malformed();
+  word length = read_cardinal();
+  uint8* data = read_pointer();
+  // The message's reference to the blob is taken over by the backing. The
+  // backing is wrapped in a frozen byte array, so it is never written to.
+  ObjectHeap* heap = process_->object_heap();
+  ByteArray* backing = heap->allocate_external_byte_array(length, data, true, false);
+  if (backing == null) return mark_allocation_failed();
+  backing->mark_shared();
+  if (!register_external(backing, length)) {
+    backing->clear_has_active_finalizer();
+    return mark_allocation_failed();
+  }
+  Instance* result = heap->allocate_instance(program_->byte_array_cow_class_id());
   if (result == null) return mark_allocation_failed();
+  result->at_put(Instance::BYTE_ARRAY_COW_BACKING_INDEX, backing);
+  result->at_put(Instance::BYTE_ARRAY_COW_IS_MUTABLE_INDEX, program_->false_object());
   return result;
 }
 
@@ -748,6 +945,20 @@ bool MessageDecoder::decode_external_data(void** data, word* length) {
     *length = encoded_length;  // Exclude the '\0'.
     *data = copy;
     return true;
+  } else if (tag == TAG_SHARED_STRING || tag == TAG_SHARED_BYTE_ARRAY) {
+    // External receivers own and free the data they get, so they get a
+    // copy of the blob, including the '\0' for strings.
+    *length = read_cardinal();
+    uint8* content = read_pointer();
+    void* copy = malloc(*length + 1);
+    if (copy == null) {
+      mark_allocation_failed();
+      return false;
+    }
+    memcpy(copy, content, *length + 1);
+    SharedBlob::release(content);
+    *data = copy;
+    return true;
   }
   return false;
 }
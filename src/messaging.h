@@ -53,7 +53,9 @@ enum {
   MESSAGING_PROCESS_MESSAGE_SIZE = 3,
 
   MESSAGING_ENCODING_MAX_NESTING      = 8,
-  MESSAGING_ENCODING_MAX_EXTERNALS    = 8,
+  // Number of externals that are tracked without allocating. Messages with
+  // more externals are fine, but need a malloced list.
+  MESSAGING_ENCODING_INLINE_EXTERNALS = 8,
   MESSAGING_ENCODING_MAX_INLINED_SIZE = 128,
 
   // This constant needs to be kept in sync with the one in lib/core/message_.toit.
@@ -73,6 +75,90 @@ enum SystemMessageType {
   SYSTEM_EXTERNAL_NOTIFICATION = 8,
 };
 
+// A list that keeps its first few elements inline and moves them to
+// malloced memory when it grows beyond that.  Appending reports malloc
+// failures to the caller, so they can be retried after a GC.
+template<typename T, unsigned INLINE_CAPACITY>
+class ExternalsList {
+ public:
+  ExternalsList() {}
+  ExternalsList(const ExternalsList&) = delete;
+  ExternalsList& operator=(const ExternalsList&) = delete;
+
+  ~ExternalsList() {
+    if (elements_ != inline_elements_) free(elements_);
+  }
+
+  unsigned length() const { return length_; }
+
+  T& operator[](unsigned index) {
+    ASSERT(index < length_);
+    return elements_[index];
+  }
+
+  bool append(T element) {
+    if (length_ == capacity_ && !grow()) return false;
+    elements_[length_++] = element;
+    return true;
+  }
+
+ private:
+  unsigned length_ = 0;
+  unsigned capacity_ = INLINE_CAPACITY;
+  T* elements_ = inline_elements_;
+  T inline_elements_[INLINE_CAPACITY];
+
+  bool grow() {
+    unsigned new_capacity = capacity_ * 2;
+    T* elements = unvoid_cast<T*>(malloc(new_capacity * sizeof(T)));
+    if (elements == null) return false;
+    memcpy(elements, elements_, length_ * sizeof(T));
+    if (elements_ != inline_elements_) free(elements_);
+    elements_ = elements;
+    capacity_ = new_capacity;
+    return true;
+  }
+};
+
+// A cache of buffers for encoded messages, in power-of-two size classes.
+// Most messages are small and die as soon as the receiver has decoded them,
+// so reusing their buffers saves a malloc/free pair per message.
+// Each scheduler thread has its own pool, so allocating and releasing a
+// buffer never takes a lock.  Buffers are allocated by the sending process
+// and released by the receiving one, so a buffer may move to the pool of
+// another thread.  Threads without a pool use malloc and free directly.
+class MessageBufferPool {
+ public:
+  static const int MIN_SIZE_LOG2 = 5;
+  static const int MAX_SIZE_LOG2 = 10;
+  static const word MAX_SIZE = 1 << MAX_SIZE_LOG2;
+#ifdef TOIT_FREERTOS
+  static const int BUFFERS_PER_CLASS = 2;
+#else
+  static const int BUFFERS_PER_CLASS = 16;
+#endif
+
+  MessageBufferPool();
+  ~MessageBufferPool();
+
+  // Returns a buffer of at least [size] bytes and stores its real size in
+  // [capacity].  Sizes above MAX_SIZE are served directly by malloc.
+  static uint8* allocate(word size, word* capacity);
+  // Releases a buffer that was returned by [allocate] with the given capacity.
+  static void release(uint8* buffer, word capacity);
+
+ private:
+  static const int CLASSES = MAX_SIZE_LOG2 - MIN_SIZE_LOG2 + 1;
+
+  static int size_class(word size);
+
+  // The pool of the current scheduler thread, or null.
+  static MessageBufferPool* current();
+
+  int counts_[CLASSES];
+  uint8* buffers_[CLASSES][BUFFERS_PER_CLASS];
+};
+
 class Message : public MessageFIFO::Element {
  public:
   virtual ~Message() {}
@@ -93,7 +179,7 @@ class SystemMessage : public Message {
 
   SystemMessage(int type, int gid, int pid, uint8* data);
   SystemMessage(int type, int gid, int pid, MessageEncoder* encoder);
-  SystemMessage(int type, int gid, int pid) : type_(type), gid_(gid), pid_(pid), data_(null) {}
+  SystemMessage(int type, int gid, int pid) : type_(type), gid_(gid), pid_(pid), data_(null), data_capacity_(0) {}
   virtual ~SystemMessage() override { free_data_and_externals(); }
 
   virtual MessageType message_type() const override { return MESSAGE_SYSTEM; }
@@ -109,7 +195,7 @@ class SystemMessage : public Message {
   // This is used after succesfully decoding a message and thus taking ownership of such
   // external areas.
   void free_data_but_keep_externals() {
-    free(data_);
+    free_buffer();
     data_ = null;
   }
 
@@ -121,6 +207,11 @@ class SystemMessage : public Message {
   const int gid_;  // The process group ID this message comes from.
   int pid_;  // The process ID this message comes from.
   uint8* data_;
+  // The capacity of the data buffer, if it comes from the message buffer
+  // pool, or 0 if it was malloced directly.
+  word data_capacity_;
+
+  void free_buffer();
 };
 
 class ObjectNotifyMessage : public Message {
@@ -168,12 +259,19 @@ class MessageEncoder {
   explicit MessageEncoder(uint8* buffer) : buffer_(buffer) {}
   MessageEncoder(Process* process, uint8* buffer)
       : MessageEncoder(process, buffer, MESSAGE_FORMAT_IPC, true) {}
+  // Takes ownership of a buffer from the MessageBufferPool with the given
+  // capacity.
+  MessageEncoder(Process* process, uint8* buffer, word pooled_capacity)
+      : MessageEncoder(process, buffer, MESSAGE_FORMAT_IPC, true) {
+    pooled_capacity_ = pooled_capacity;
+  }
   ~MessageEncoder();
 
   static void encode_process_message(uint8* buffer, uint8 value);
 
   unsigned size() const { return cursor_; }
   bool malloc_failed() const { return malloc_failed_; }
+  word pooled_capacity() const { return pooled_capacity_; }
 
   /**
   Some encoders can take over the data pointed to by external
@@ -181,8 +279,8 @@ class MessageEncoder {
     been malloced, and are pointed at by the encoded message.
   When all encoding is complete and no retryable (allocation) failures have
     been encountered, this should be called.  It neuters the external byte
-    arrays and forgets the allocated external buffers, which must now be freed
-    by the receiver.
+    arrays and forgets the allocated external buffers and the references to
+    shared blobs, which must now be freed or released by the receiver.
   Also takes ownership of the buffer away.
   */
   uint8* take_buffer();
@@ -207,8 +305,9 @@ class MessageEncoder {
 
   bool encoding_for_size() const { return buffer_ == null; }
   bool encoding_tison() const { return format_ == MESSAGE_FORMAT_TISON; }
-  unsigned copied_count() const { return copied_count_; }
-  unsigned externals_count() const { return externals_count_; }
+  unsigned copied_count() const { return copied_.length(); }
+  unsigned shared_count() const { return shared_.length(); }
+  unsigned externals_count() const { return externals_.length(); }
 
   bool encode_any(Object* object);
 
@@ -226,23 +325,30 @@ class MessageEncoder {
   //   it points at.
   uint8* buffer_;
   bool take_ownership_of_buffer_ = false;
+  word pooled_capacity_ = 0;
   word cursor_ = 0;
   int nesting_ = 0;
   int problematic_class_id_ = -1;
   bool nesting_too_deep_ = false;
-  bool too_many_externals_ = false;
 
   bool malloc_failed_ = false;
 
-  unsigned copied_count_ = 0;
-  void* copied_[MESSAGING_ENCODING_MAX_EXTERNALS];
+  // Malloced copies of the content of strings and on-heap byte arrays.
+  ExternalsList<void*, MESSAGING_ENCODING_INLINE_EXTERNALS> copied_;
+
+  // External byte arrays whose content is handed over to the receiver.
+  ExternalsList<ByteArray*, MESSAGING_ENCODING_INLINE_EXTERNALS> externals_;
 
-  unsigned externals_count_ = 0;
-  ByteArray* externals_[MESSAGING_ENCODING_MAX_EXTERNALS];
+  // References to shared blobs that are handed over to the receiver.
+  ExternalsList<const uint8*, MESSAGING_ENCODING_INLINE_EXTERNALS> shared_;
 
   bool encode_array(Array* object, word from, word to);
   bool encode_byte_array(ByteArray* object);
   bool encode_copy(Object* object, int tag);
+  bool encode_shared(Object* object, const uint8* source, word length, int tag);
+  // Returns a reference to a shared blob with the given content, or null if
+  // the allocation failed.
+  const uint8* shared_content(Object* object, const uint8* source, word length, int tag);
   bool encode_list(Instance* instance, word from, word to);
   bool encode_map(Instance* instance);
 
@@ -270,6 +376,7 @@ class TisonEncoder : public MessageEncoder {
 
   ~TisonEncoder() {
     ASSERT(copied_count() == 0);
+    ASSERT(shared_count() == 0);
     ASSERT(externals_count() == 0);
   }
 
@@ -304,6 +411,8 @@ class MessageDecoder {
   // malloc. To deallocate such messages, we have to traverse them and free
   // all external areas before freeing the buffer itself.
   static void deallocate(uint8* buffer);
+  // Frees the external areas, but leaves the buffer itself alone.
+  static void deallocate_externals(uint8* buffer);
 
  protected:
   MessageDecoder(Process* process, const uint8* buffer, word size, MessageFormat format);
@@ -311,7 +420,7 @@ class MessageDecoder {
   bool decoding_tison() const { return format_ == MESSAGE_FORMAT_TISON; }
   bool overflown() const { return cursor_ > size_; }
   word remaining() const { return size_ - cursor_; }
-  uword externals_count() const { return externals_count_; }
+  uword externals_count() const { return externals_.length(); }
 
   Object* decode_any();
 
@@ -337,16 +446,21 @@ class MessageDecoder {
   word cursor_ = 0;
   Status status_ = DECODE_SUCCESS;
 
-  unsigned externals_count_ = 0;
-  HeapObject* externals_[MESSAGING_ENCODING_MAX_EXTERNALS];
-  word externals_sizes_[MESSAGING_ENCODING_MAX_EXTERNALS];
+  struct External {
+    HeapObject* object;
+    word length;
+  };
+  ExternalsList<External, MESSAGING_ENCODING_INLINE_EXTERNALS> externals_;
 
-  void register_external(HeapObject* object, word length);
+  // Returns false if we ran out of memory while tracking the external.
+  bool register_external(HeapObject* object, word length);
 
   Object* decode_string(bool inlined);
   Object* decode_array();
   Object* decode_map();
   Object* decode_byte_array(bool inlined);
+  Object* decode_shared_string();
+  Object* decode_shared_byte_array();
   Object* decode_double();
   Object* decode_large_integer();
 
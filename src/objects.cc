@@ -289,6 +289,7 @@ void Stack::roots_do(Program* program, RootCallback* cb) {
       _set_length(len);
       _set_top(top);
       _set_try_top(try_top() - reduction);
+      cb->stack_shrunk(reduction * WORD_SIZE);
       // Now that the stack is smaller we need to fill the space after it with
       // something to keep the heap iterable.
       for (word i = 0; i < reduction; i++) {
@@ -197,6 +197,9 @@ class RootCallback {
   void do_root(Object** root) { do_roots(root, 1); }
   virtual void do_roots(Object** roots, word length) = 0;
   virtual bool shrink_stacks() const { return false; }
+  // Called when a stack has been shrunk by the given number of bytes while
+  // its roots were visited.
+  virtual void stack_shrunk(word bytes) {}
   virtual bool skip_marking(HeapObject* object) const { return false; }
 };
 
@@ -423,6 +426,15 @@ class Array : public HeapObject {
   // Must match collections.toit.
   static const word ARRAYLET_SIZE = 500;
 
+  // The array primitives fail for longer arrays, and collections.toit then
+  // splits them into arraylets.
+  static INLINE word max_length_without_arraylets();
+
+  // Large arrays are allocated in the large-object space of the process
+  // heap, where the write barrier records the card of each written element
+  // instead of the card of the header.
+  INLINE bool is_large() const;
+
   INLINE Object* at(word index) const {
     ASSERT(index >= 0 && index < length());
     return _at(_offset_from(index));
@@ -440,6 +452,9 @@ class Array : public HeapObject {
     _at_put(_offset_from(index), value);
   }
 
+  // Write barrier for bulk updates of the elements in [from, to[.
+  INLINE void insert_into_remembered_set(word from, word to);
+
   void copy_from(Array* other, word length) {
     memcpy(content(), other->content(), length * WORD_SIZE);
   }
@@ -480,6 +495,9 @@ class Array : public HeapObject {
   static const word LENGTH_OFFSET = HeapObject::SIZE;
   static const word HEADER_SIZE = LENGTH_OFFSET + WORD_SIZE;
 
+  // Longer arrays are allocated in the large-object space.
+  static INLINE word max_small_length_in_process();
+
   void _set_length(word value) { _word_at_put(LENGTH_OFFSET, value); }
 
   // Can only be called on newly allocated objects that will be either
@@ -641,6 +659,7 @@ class ByteArray : public HeapObject {
   // accounting, so we may overestimate the external memory pressure.  May fail
   // under memory pressure, in which case the size of the Toit ByteArray object
   // is changed, but the backing harmlessly points to a larger area.
+  // Pooled byte arrays keep their backing, so it can be reused.
   void resize_external(Process* process, word new_length);
 
   template<typename T> void set_external_address(T* value) {
@@ -660,7 +679,38 @@ class ByteArray : public HeapObject {
 
   word external_tag() const {
     ASSERT(has_external_address());
-    return _word_at(EXTERNAL_TAG_OFFSET);
+    return _word_at(EXTERNAL_TAG_OFFSET) & ~(EXTERNAL_SHARED_BIT | EXTERNAL_POOLED_BIT);
+  }
+
+  // Whether the external content is a SharedBlob.  Shared byte arrays are
+  // only used as the backing of frozen byte arrays.
+  bool is_shared() const {
+    return has_external_address() && (_word_at(EXTERNAL_TAG_OFFSET) & EXTERNAL_SHARED_BIT) != 0;
+  }
+
+  void mark_shared() {
+    ASSERT(external_tag() == RawByteTag);
+    _set_external_tag(RawByteTag | EXTERNAL_SHARED_BIT);
+  }
+
+  // Whether the external content is a buffer from the I/O buffer pool of
+  // the process.  The buffer has PREFERRED_IO_BUFFER_SIZE bytes, even if the
+  // byte array is shorter, and goes back to the pool when the byte array
+  // dies.
+  bool is_pooled() const {
+    return has_external_address() && (_word_at(EXTERNAL_TAG_OFFSET) & EXTERNAL_POOLED_BIT) != 0;
+  }
+
+  void mark_pooled() {
+    ASSERT(external_tag() == RawByteTag);
+    ASSERT(!is_shared());
+    _set_external_tag(RawByteTag | EXTERNAL_POOLED_BIT);
+  }
+
+  // The size of the external backing, which is accounted as external memory
+  // of the process.
+  word external_capacity() {
+    return is_pooled() ? PREFERRED_IO_BUFFER_SIZE : _external_length();
   }
 
   void do_pointers(PointerCallback* cb);
@@ -678,6 +728,10 @@ class ByteArray : public HeapObject {
   static_assert(EXTERNAL_ADDRESS_OFFSET % WORD_SIZE == 0, "External pointer not word aligned");
   static const word EXTERNAL_TAG_OFFSET = EXTERNAL_ADDRESS_OFFSET + WORD_SIZE;
   static const word EXTERNAL_SIZE = EXTERNAL_TAG_OFFSET + WORD_SIZE;
+  // Set in the external tag of byte arrays that point at a SharedBlob.
+  static const word EXTERNAL_SHARED_BIT = 1 << 24;
+  // Set in the external tag of byte arrays that point at a pooled I/O buffer.
+  static const word EXTERNAL_POOLED_BIT = 1 << 25;
 
   // Any byte-array that is bigger than this size is snapshotted as external
   // byte array.
@@ -1094,6 +1148,20 @@ class String : public HeapObject {
   // Tells whether the string content is on the heap or external.
   bool content_on_heap() const { return _internal_length() != SENTINEL; }
 
+  // Tells whether the external content is a SharedBlob.
+  bool is_shared() const {
+    return !content_on_heap() && (_word_at(EXTERNAL_LENGTH_OFFSET) & EXTERNAL_SHARED_BIT) != 0;
+  }
+
+  // Makes the string point at the given SharedBlob content, which must be
+  // equal to the current content.  The caller is responsible for the
+  // previous external content.
+  void set_shared_external_address(const uint8* content) {
+    ASSERT(!content_on_heap());
+    _set_external_address(content);
+    _word_at_put(EXTERNAL_LENGTH_OFFSET, _external_length() | EXTERNAL_SHARED_BIT);
+  }
+
   static INLINE word max_length_in_process();
   static INLINE word max_length_in_program();
 
@@ -1309,6 +1377,8 @@ class String : public HeapObject {
   static const word EXTERNAL_ADDRESS_OFFSET = EXTERNAL_LENGTH_OFFSET + WORD_SIZE;
   static_assert(EXTERNAL_ADDRESS_OFFSET % WORD_SIZE == 0, "External pointer not word aligned");
   static const word EXTERNAL_OBJECT_SIZE = EXTERNAL_ADDRESS_OFFSET + WORD_SIZE;
+  // Set in the external length of strings that point at a SharedBlob.
+  static const word EXTERNAL_SHARED_BIT = static_cast<word>(1) << (WORD_BIT_SIZE - 2);
 
   // Any string that is bigger than this size is snapshotted as external string.
   static const word SNAPSHOT_INTERNAL_SIZE_CUTOFF = TOIT_PAGE_SIZE_32 >> 2;
@@ -1346,7 +1416,7 @@ class String : public HeapObject {
 
   word _external_length() const {
      ASSERT(_internal_length() == SENTINEL);
-     return _word_at(EXTERNAL_LENGTH_OFFSET);
+     return _word_at(EXTERNAL_LENGTH_OFFSET) & ~EXTERNAL_SHARED_BIT;
   }
 
   void _set_external_length(word value) {
@@ -25,9 +25,20 @@
 namespace toit {
 
 word Array::max_length_in_process() {
+  return (ObjectHeap::max_large_allocation_size() - HEADER_SIZE) / WORD_SIZE;
+}
+
+word Array::max_small_length_in_process() {
   return (ObjectHeap::max_allocation_size() - HEADER_SIZE) / WORD_SIZE;
 }
 
+word Array::max_length_without_arraylets() {
+  // Without a large-object space the arrays must fit in a page.
+  return max_length_in_process() > max_small_length_in_process()
+      ? max_length_in_process()
+      : ARRAYLET_SIZE;
+}
+
 word Array::max_length_in_program() {
   return (ProgramHeap::max_allocation_size() - HEADER_SIZE) / WORD_SIZE;
 }
@@ -70,15 +81,34 @@ inline bool HeapObject::on_program_heap(Process* process) const {
   return process->on_program_heap(this);
 }
 
+bool Array::is_large() const {
+  return length() > max_small_length_in_process();
+}
+
 inline void Array::at_put(word index, Object* value) {
   ASSERT(index >= 0 && index < length());
-  GcMetadata::insert_into_remembered_set(this);
-  _at_put(_offset_from(index), value);
+  word offset = _offset_from(index);
+  if (is_large()) {
+    GcMetadata::insert_into_remembered_set(_raw_at(offset));
+  } else {
+    GcMetadata::insert_into_remembered_set(this);
+  }
+  _at_put(offset, value);
+}
+
+inline void Array::insert_into_remembered_set(word from, word to) {
+  if (!is_large()) {
+    GcMetadata::insert_into_remembered_set(this);
+  } else if (from < to) {
+    uword start = reinterpret_cast<uword>(_raw_at(_offset_from(from)));
+    uword end = reinterpret_cast<uword>(_raw_at(_offset_from(to)));
+    GcMetadata::insert_range_into_remembered_set(start, end);
+  }
 }
 
 inline void Array::fill(word from, Object* filler) {
-  GcMetadata::insert_into_remembered_set(this);
   word len = length();
+  insert_into_remembered_set(from, len);
   for (word index = from; index < len; index++) {
     at_put_no_write_barrier(index, filler);
   }
@@ -98,17 +98,25 @@ bool Object::mutable_byte_content(Process* process, MutableBlob* blob, Error** e
 uint8* ByteArray::neuter(Process* process) {
   ASSERT(has_external_address());
   ASSERT(external_tag() == RawByteTag);
+  ASSERT(!is_shared());
   Bytes bytes(this);
-  process->unregister_external_allocation(bytes.length());
+  process->unregister_external_allocation(external_capacity());
   _set_external_address(null);
   _set_external_length(0);
+  _set_external_tag(RawByteTag);
   return bytes.address();
 }
 
 void ByteArray::resize_external(Process* process, word new_length) {
   ASSERT(has_external_address());
   ASSERT(external_tag() == RawByteTag);
+  ASSERT(!is_shared());
   ASSERT(new_length <= _external_length());
+  if (is_pooled()) {
+    // The whole buffer stays accounted, and is recycled when we die.
+    _set_external_length(new_length);
+    return;
+  }
   process->unregister_external_allocation(_external_length());
   process->register_external_allocation(new_length);
   _set_external_length(new_length);
@@ -23,6 +23,7 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "flags.h"
 #include "utils.h"
 
 #ifndef TIMEVAL_TO_TIMESPEC
@@ -149,12 +150,37 @@ static uint64* toit_heap_bits;        // Free bits for the range.
 
 static const int BITS_PER_UINT64_LOG_2 = 6;
 
+// Scans forwards from start of the bitmaps to find a set of free pages that
+// are big enough for a chunk of the large-object space.  These allocations
+// start at the beginning of a bitmap and use as many whole bitmaps as needed.
+static void* find_free_large_area(const Locker& locker, uword size) {
+  int bitmaps = toit_heap_size >> (TOIT_PAGE_SIZE_LOG2 + BITS_PER_UINT64_LOG_2);
+  int needed = (size + 63) >> BITS_PER_UINT64_LOG_2;
+  int run = 0;
+  for (int i = 0; i < bitmaps; i++) {
+    if (toit_heap_bits[i] != 0) {
+      run = 0;
+      continue;
+    }
+    if (++run < needed) continue;
+    int first = i - needed + 1;
+    uint64 zero = 0;
+    for (int j = first; j < i; j++) toit_heap_bits[j] = zero - 1;  // All ones.
+    uword rest = size - ((needed - 1) << BITS_PER_UINT64_LOG_2);
+    uint64 one = 1;
+    toit_heap_bits[i] = rest == 64 ? zero - 1 : (one << rest) - 1;
+    return Utils::void_add(toit_heap_range, static_cast<uword>(first) << (TOIT_PAGE_SIZE_LOG2 + BITS_PER_UINT64_LOG_2));
+  }
+  return null;
+}
+
 // Scans forwards from start of the bitmaps to find a set of free pages that
 // are big enough.  On 64 bit platforms there are 512 bitmaps (each 64 bit) for
 // the default max heap size of 1Gbyte.  We don't make allocations that cross
-// the boundary between bitmaps. Currently the max allocation size requested is
-// 256k, which is 8 pages.
+// the boundary between bitmaps, except for the large-object space. Apart from
+// that, the max allocation size requested is 256k, which is 8 pages.
 static void* find_free_area(const Locker& locker, uword size) {
+  if (size > 64) return find_free_large_area(locker, size);
   int bitmaps = toit_heap_size >> (TOIT_PAGE_SIZE_LOG2 + BITS_PER_UINT64_LOG_2);
   for (int i = 0; i < bitmaps; i++) {
     uint64 map = toit_heap_bits[i];
@@ -183,22 +209,114 @@ static void* find_free_area(const Locker& locker, uword size) {
   return null;
 }
 
+// Freed chunks are kept in a VM-wide cache instead of being returned to the
+// OS right away.  Processes that oscillate around a GC threshold keep freeing
+// and allocating chunks of the same size, and each round trip would cost
+// two system calls and a round of page faults.  The cached memory is limited
+// by -Xchunk_cache_kb.  The chunks that are evicted from the cache, oldest
+// first, are returned to the OS.  The cache is emptied when the address
+// range runs out, since the cached chunks may be in the way.
+// The cached chunks keep their bits in the bitmaps, and the links are stored
+// in the chunks themselves.
+struct CachedPages {
+  CachedPages* newer;
+  CachedPages* older;
+  uword size;
+};
+
+// Multi-page chunks are only used for old-spaces that are already large, and
+// for large objects.  We only cache the chunks used for the default old-space
+// growth.
+static const uword MAX_CACHED_SIZE = 256 * KB;
+
+// Protected by the resource mutex.
+static CachedPages* page_cache_newest = null;
+static CachedPages* page_cache_oldest = null;
+static uword page_cache_size = 0;
+static uint64 page_cache_hits = 0;
+static uint64 page_cache_misses = 0;
+
+static void release_pages(const Locker& locker, void* address, uword size);
+
+static void* take_cached_pages(const Locker& locker, uword size) {
+  for (CachedPages* entry = page_cache_newest; entry != null; entry = entry->older) {
+    if (entry->size != size) continue;
+    if (entry->newer) entry->newer->older = entry->older; else page_cache_newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer; else page_cache_oldest = entry->newer;
+    page_cache_size -= size;
+    return entry;
+  }
+  return null;
+}
+
+static void trim_page_cache(const Locker& locker, uword limit) {
+  while (page_cache_size > limit) {
+    CachedPages* entry = page_cache_oldest;
+    page_cache_oldest = entry->newer;
+    if (page_cache_oldest) page_cache_oldest->older = null; else page_cache_newest = null;
+    page_cache_size -= entry->size;
+    release_pages(locker, entry, entry->size);
+  }
+}
+
 void* OS::allocate_pages(uword size) {
   Locker locker(OS::resource_mutex());
   ASSERT(Utils::is_aligned(size, TOIT_PAGE_SIZE));
-  size >>= TOIT_PAGE_SIZE_LOG2;
-  ASSERT(size <= 64);  // 64 bits per bitmap, since we use uint64.
-  void* result = find_free_area(locker, size);
-  if (result) use_virtual_memory(result, size << TOIT_PAGE_SIZE_LOG2);
+  if (size <= MAX_CACHED_SIZE) {
+    void* cached = take_cached_pages(locker, size);
+    if (cached) {
+      page_cache_hits++;
+      return cached;
+    }
+    page_cache_misses++;
+  }
+  void* result = find_free_area(locker, size >> TOIT_PAGE_SIZE_LOG2);
+  if (result == null && page_cache_size != 0) {
+    trim_page_cache(locker, 0);
+    result = find_free_area(locker, size >> TOIT_PAGE_SIZE_LOG2);
+  }
+  if (result) use_virtual_memory(result, size);
   return result;
 }
 
 void OS::free_pages(void* address, uword size) {
   Locker locker(OS::resource_mutex());
+  uword limit = static_cast<uword>(Utils::max(Flags::chunk_cache_kb, 0)) * KB;
+  if (size > MAX_CACHED_SIZE || size > limit) {
+    release_pages(locker, address, size);
+    return;
+  }
+  CachedPages* entry = reinterpret_cast<CachedPages*>(address);
+  entry->size = size;
+  entry->older = page_cache_newest;
+  entry->newer = null;
+  if (page_cache_newest) page_cache_newest->newer = entry; else page_cache_oldest = entry;
+  page_cache_newest = entry;
+  page_cache_size += size;
+  trim_page_cache(locker, limit);
+}
+
+void OS::page_cache_stats(uword* cached, uint64* hits, uint64* misses) {
+  Locker locker(OS::resource_mutex());
+  *cached = page_cache_size;
+  *hits = page_cache_hits;
+  *misses = page_cache_misses;
+}
+
+static void release_pages(const Locker& locker, void* address, uword size) {
   word size_in_pages = size >> TOIT_PAGE_SIZE_LOG2;
   uword page_number = Utils::void_sub(address, toit_heap_range) >> TOIT_PAGE_SIZE_LOG2;
   uword index = page_number >> BITS_PER_UINT64_LOG_2;
-  ASSERT(size_in_pages <= 64);  // 64 bits per bitmap, since we use uint64.
+  if (size_in_pages > 64) {
+    // Large-object space chunks start at the beginning of a bitmap.
+    ASSERT((page_number & 63) == 0);
+    while (size_in_pages > 64) {
+      ASSERT(toit_heap_bits[index] + 1 == 0);  // All 1's.
+      toit_heap_bits[index++] = 0;
+      size_in_pages -= 64;
+    }
+    page_number = 0;
+  }
   uint64 old_bits = toit_heap_bits[index];
   if (size_in_pages == 64) {
     ASSERT(old_bits + 1 == 0);  // All 1's.
@@ -210,7 +328,7 @@ void OS::free_pages(void* address, uword size) {
     ASSERT(Utils::popcount(old_bits) - Utils::popcount(new_bits) == size_in_pages);
     toit_heap_bits[index] = new_bits;
   }
-  unuse_virtual_memory(address, size);
+  OS::unuse_virtual_memory(address, size);
 }
 
 OS::HeapMemoryRange OS::get_heap_memory_range() {
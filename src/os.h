@@ -192,6 +192,10 @@ class OS {
   // returned by get_heap_memory_range.
   static void* allocate_pages(uword size);
   static void free_pages(void* address, uword size);
+  // Freed pages are cached for reuse on systems with virtual memory.  Returns
+  // the size of the cache, and the number of page allocations that were and
+  // were not served from it.
+  static void page_cache_stats(uword* cached, uint64* hits, uint64* misses);
 
   static Block* allocate_block();
   static void free_block(Block* block);
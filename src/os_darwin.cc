@@ -95,6 +95,9 @@ void OS::unuse_virtual_memory(void* addr, uword sz) {
   uword rounded = Utils::round_up(address, getpagesize());
   uword size = Utils::round_down(end - rounded, getpagesize());
   if (size != 0) {
+    // Changing the protection doesn't free the memory, so we tell the kernel
+    // that it can take the pages back.
+    madvise(reinterpret_cast<void*>(rounded), size, MADV_FREE);
     int result = mprotect(reinterpret_cast<void*>(rounded), size, PROT_NONE);
     if (result == 0) return;
     perror("mprotect");
@@ -393,6 +393,12 @@ void OS::free_pages(void* address, uword size) {
   heap_caps_free(address);
 }
 
+void OS::page_cache_stats(uword* cached, uint64* hits, uint64* misses) {
+  *cached = 0;
+  *hits = 0;
+  *misses = 0;
+}
+
 void* OS::grab_virtual_memory(void* address, uword size) {
   // On ESP32 this is only used for allocating the heap metadata.  We put this
   // in the same space as the heap itself.
@@ -130,7 +130,18 @@ void Thread::_boot() {
 }
 
 bool Thread::spawn(int stack_size, int core) {
-  int result = pthread_create(reinterpret_cast<pthread_t*>(&handle_), null, &thread_start, void_cast(this));
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  // Only grow the stack. The small sizes requested for embedded targets
+  // would be too small for the host.
+  size_t default_stack_size;
+  if (pthread_attr_getstacksize(&attributes, &default_stack_size) == 0 &&
+      stack_size > 0 &&
+      static_cast<size_t>(stack_size) > default_stack_size) {
+    pthread_attr_setstacksize(&attributes, stack_size);
+  }
+  int result = pthread_create(reinterpret_cast<pthread_t*>(&handle_), &attributes, &thread_start, void_cast(this));
+  pthread_attr_destroy(&attributes);
   if (result != 0) {
     FATAL("pthread_create failed");
   }
@@ -69,6 +69,21 @@ Object* Primitive::allocate_array(word length, Object* filler, Process* process)
   return mark_as_error(process->program()->allocation_failed());
 }
 
+Array* Primitive::list_backing(Object* object, Process* process, word* length) {
+  if (is_array(object)) {
+    Array* array = Array::cast(object);
+    *length = array->length();
+    return array;
+  }
+  if (!is_instance(object)) return null;
+  Instance* list = Instance::cast(object);
+  if (list->class_id() != process->program()->list_class_id()) return null;
+  Object* backing = list->at(Instance::LIST_ARRAY_INDEX);
+  if (!is_array(backing)) return null;
+  *length = Smi::value(list->at(Instance::LIST_SIZE_INDEX));
+  return Array::cast(backing);
+}
+
 Object* Primitive::os_error(int error, Process* process, const char* operation) {
 #ifdef TOIT_ESP32
   if (error == ESP_ERR_NO_MEM) FAIL(MALLOC_FAILED);
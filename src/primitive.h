@@ -194,6 +194,9 @@ namespace toit {
   PRIMITIVE(task_new, 1)                     \
   PRIMITIVE(task_transfer, 2)                \
   PRIMITIVE(gc_count, 0)                     \
+  PRIMITIVE(gc_events_enable, 1)             \
+  PRIMITIVE(gc_events, 1)                    \
+  PRIMITIVE(gc_pause_histogram, 1)           \
   PRIMITIVE(byte_array_is_raw_bytes, 1)      \
   PRIMITIVE(byte_array_length, 1)            \
   PRIMITIVE(byte_array_at, 2)                \
@@ -261,6 +264,29 @@ namespace toit {
   PRIMITIVE(rtc_user_bytes, 0)               \
   PRIMITIVE(hostname, 0)                     \
 
+// Fast primitives are called by the interpreter without spilling its state
+// (stack pointer and current bcp) to the process. They must not trigger a
+// GC, call back into Toit code, or look at the stack beyond their
+// arguments. They may fail, and if they fail with an allocation failure
+// they are retried through the normal path.
+#define MODULE_CORE_FAST(FAST_PRIMITIVE)     \
+  FAST_PRIMITIVE(string_length)              \
+  FAST_PRIMITIVE(string_raw_at)              \
+  FAST_PRIMITIVE(array_length)               \
+  FAST_PRIMITIVE(array_at)                   \
+  FAST_PRIMITIVE(array_at_put)               \
+  FAST_PRIMITIVE(smi_not)                    \
+  FAST_PRIMITIVE(smi_and)                    \
+  FAST_PRIMITIVE(smi_or)                     \
+  FAST_PRIMITIVE(smi_xor)                    \
+  FAST_PRIMITIVE(compare_to)                 \
+  FAST_PRIMITIVE(blob_equals)                \
+  FAST_PRIMITIVE(smi_add)                    \
+  FAST_PRIMITIVE(smi_subtract)               \
+  FAST_PRIMITIVE(byte_array_length)          \
+  FAST_PRIMITIVE(byte_array_at)              \
+  FAST_PRIMITIVE(byte_array_at_put)          \
+
 #define MODULE_TIMER(PRIMITIVE)              \
   PRIMITIVE(init, 0)                         \
   PRIMITIVE(create, 1)                       \
@@ -275,7 +301,10 @@ namespace toit {
   PRIMITIVE(accept, 2)                       \
   PRIMITIVE(listen, 4)                       \
   PRIMITIVE(write, 5)                        \
+  PRIMITIVE(write_vector, 4)                 \
+  PRIMITIVE(send_file, 5)                    \
   PRIMITIVE(read, 2)                         \
+  PRIMITIVE(read_into, 5)                    \
   PRIMITIVE(error_number, 1)                 \
   PRIMITIVE(error, 1)                        \
   PRIMITIVE(get_option, 3)                   \
@@ -289,6 +318,7 @@ namespace toit {
   PRIMITIVE(bind_socket, 4)                  \
   PRIMITIVE(connect, 4)                      \
   PRIMITIVE(receive, 3)                      \
+  PRIMITIVE(receive_multiple, 5)             \
   PRIMITIVE(send, 7)                         \
   PRIMITIVE(get_option, 3)                   \
   PRIMITIVE(set_option, 4)                   \
@@ -807,20 +837,41 @@ namespace toit {
 
 #define MODULE_IMPLEMENTATION_PRIMITIVE(name, arity)                \
   static Object* primitive_##name(Process*, Object**);
+#define MODULE_IMPLEMENTATION_SLOW(name, arity)                     \
+  is_fast_##name = false,
+#define MODULE_IMPLEMENTATION_FAST(name)                            \
+  is_fast_##name = true,
 #define MODULE_IMPLEMENTATION_ENTRY(name, arity)                    \
-  { (void*) primitive_##name, arity },
-#define MODULE_IMPLEMENTATION(name, entries)                        \
+  { (void*) primitive_##name, arity, is_fast_##name },
+#define MODULE_NO_FAST_PRIMITIVES(FAST_PRIMITIVE)
+
+// The attributes of the fast primitives are declared in a nested
+// namespace, so they shadow the default attributes of all primitives
+// when the entry table is built.
+#define MODULE_IMPLEMENTATION_WITH_FAST(name, entries, fast_entries) \
   entries(MODULE_IMPLEMENTATION_PRIMITIVE)                          \
-  static const PrimitiveEntry name##_primitive_table[] = {          \
-    entries(MODULE_IMPLEMENTATION_ENTRY)                            \
-  };                                                                \
-  const PrimitiveEntry* name##_primitives_ = name##_primitive_table;
+  namespace name##_primitive_attributes {                           \
+    enum SlowAttributes { entries(MODULE_IMPLEMENTATION_SLOW) };    \
+    namespace fast {                                                \
+      enum FastAttributes { fast_entries(MODULE_IMPLEMENTATION_FAST) }; \
+      static const PrimitiveEntry table[] = {                       \
+        entries(MODULE_IMPLEMENTATION_ENTRY)                        \
+      };                                                            \
+    }                                                               \
+  }                                                                 \
+  const PrimitiveEntry* name##_primitives_ = name##_primitive_attributes::fast::table;
+#define MODULE_IMPLEMENTATION(name, entries)                        \
+  MODULE_IMPLEMENTATION_WITH_FAST(name, entries, MODULE_NO_FAST_PRIMITIVES)
 
 // ----------------------------------------------------------------------------
 
 #define PRIMITIVE(name) \
   static Object* primitive_##name(Process* process, Object** __args)
 
+// The bcp of the call to the method that contains the primitive.  Below the
+// arguments are the return address and the frame marker.
+#define CALLER_BCP(arity) reinterpret_cast<uint8*>(__args[-(arity)])
+
 // Usage to extract primitive arguments:
 //   ARGS(int, fd, String, name)
 //
@@ -1325,6 +1376,7 @@ Object* get_absolute_path(Process* process, const wchar_t* pathname, wchar_t* ou
 struct PrimitiveEntry {
   void* function;
   int arity;
+  bool is_fast;
 };
 
 class Primitive {
@@ -1351,6 +1403,11 @@ class Primitive {
   static Object* allocate_large_integer(int64 value, Process* process);
   static Object* allocate_array(word length, Object* filler, Process* process);
 
+  // Returns the given array, or the backing array of the given list, and
+  //   stores the number of elements in [length].  Returns null for other
+  //   objects and for lists that are so large that they use arraylets.
+  static Array* list_backing(Object* object, Process* process, word* length);
+
   static Object* integer(int64 value, Process* process) {
     if (Smi::is_valid(value)) return Smi::from((word) value);
     return allocate_large_integer(value, process);
@@ -77,7 +77,7 @@ typedef __m128i uint128_t;
 
 namespace toit {
 
-MODULE_IMPLEMENTATION(core, MODULE_CORE)
+MODULE_IMPLEMENTATION_WITH_FAST(core, MODULE_CORE, MODULE_CORE_FAST)
 
 #if defined(TOIT_WINDOWS)
 
@@ -1810,7 +1810,7 @@ PRIMITIVE(array_expand) {
   ARGS(Array, old, word, old_length, word, length, Object, filler);
   if (length == 0) return process->program()->empty_array();
   if (length < 0) FAIL(OUT_OF_BOUNDS);
-  if (length > Array::ARRAYLET_SIZE) FAIL(OUT_OF_RANGE);
+  if (length > Array::max_length_without_arraylets()) FAIL(OUT_OF_RANGE);
   if (old_length < 0 || old_length > old->length()) FAIL(OUT_OF_RANGE);
   Object* result = process->object_heap()->allocate_array(length, filler);
   if (result == null) FAIL(ALLOCATION_FAILED);
@@ -1829,10 +1829,12 @@ PRIMITIVE(array_replace) {
   word len = to - from;
   if (index + len > dest_length) FAIL(OUT_OF_BOUNDS);
   // Our write barrier is only there to record the presence of pointers
-  // from old-space to new-space, and the resolution is per-object.  If
-  // there were no pointers from old-space to new-space then an intra-
-  // array copy is not going to create any.
-  if (len != 0 && dest != source) GcMetadata::insert_into_remembered_set(dest);
+  // from old-space to new-space, and the resolution is per-object, except
+  // for large arrays.  If there were no pointers from old-space to new-space
+  // then an intra-array copy of a small array is not going to create any.
+  if (len != 0 && (dest != source || dest->is_large())) {
+    dest->insert_into_remembered_set(index, index + len);
+  }
   memmove(dest->content() + index * WORD_SIZE,
           source->content() + from * WORD_SIZE,
           len * WORD_SIZE);
@@ -1843,7 +1845,8 @@ PRIMITIVE(array_new) {
   ARGS(int, length, Object, filler);
   if (length == 0) return process->program()->empty_array();
   if (length < 0) FAIL(OUT_OF_BOUNDS);
-  if (length > Array::ARRAYLET_SIZE) FAIL(OUT_OF_RANGE);
+  if (length > Array::max_length_without_arraylets()) FAIL(OUT_OF_RANGE);
+  if (Flags::pretenuring) process->object_heap()->set_allocation_site(CALLER_BCP(2));
   return Primitive::allocate_array(length, filler, process);
 }
 
@@ -1918,6 +1921,7 @@ PRIMITIVE(byte_array_at_put) {
 PRIMITIVE(byte_array_new) {
   ARGS(int, length, int, filler);
   if (length < 0) FAIL(OUT_OF_BOUNDS);
+  if (Flags::pretenuring) process->object_heap()->set_allocation_site(CALLER_BCP(2));
   ByteArray* result = process->allocate_byte_array(length);
   if (result == null) FAIL(ALLOCATION_FAILED);
   if (filler != 0) {
@@ -2040,7 +2044,10 @@ PRIMITIVE(task_transfer) {
     Interpreter* interpreter = process->scheduler_thread()->interpreter();
     interpreter->store_stack();
     // Remove the link from the task to the stack if requested.
-    if (detach_stack) from->detach_stack();
+    if (detach_stack) {
+      process->object_heap()->release_stack(from->stack());
+      from->detach_stack();
+    }
     process->object_heap()->set_task(to);
     interpreter->load_stack();
   }
@@ -2059,10 +2066,11 @@ PRIMITIVE(process_send) {
   }
 
   HeapTagScope scope(ITERATE_CUSTOM_TAGS + EXTERNAL_BYTE_ARRAY_MALLOC_TAG);
-  uint8* buffer = unvoid_cast<uint8*>(malloc(size));
+  word capacity = 0;
+  uint8* buffer = MessageBufferPool::allocate(size, &capacity);
   if (buffer == null) FAIL(MALLOC_FAILED);
 
-  MessageEncoder encoder(process, buffer);  // Takes over buffer.
+  MessageEncoder encoder(process, buffer, capacity);  // Takes over buffer.
   if (!encoder.encode(array)) {
     return encoder.create_error_object(process);
   }
@@ -2091,8 +2099,6 @@ Object* MessageEncoder::create_error_object(Process* process) {
     result = process->allocate_string_or_error("NESTING_TOO_DEEP");
   } else if (problematic_class_id_ >= 0) {
     result = Primitive::allocate_array(1, Smi::from(problematic_class_id_), process);
-  } else if (too_many_externals_) {
-    result = process->allocate_string_or_error("TOO_MANY_EXTERNALS");
   }
   if (result) {
     if (Primitive::is_error(result)) return result;
@@ -2188,6 +2194,60 @@ PRIMITIVE(gc_count) {
   return Smi::from(process->object_heap()->gc_count(NEW_SPACE_GC));
 }
 
+PRIMITIVE(gc_events_enable) {
+  ARGS(bool, enable);
+  if (!process->object_heap()->enable_gc_events(enable)) FAIL(MALLOC_FAILED);
+  return process->null_object();
+}
+
+// Returns the recorded GC events that are still in the ring buffer, starting
+// at the given sequence number.  Each event takes up GC_EVENT_FIELDS
+// entries in the returned array.
+PRIMITIVE(gc_events) {
+  ARGS(int64, since);
+  static const int GC_EVENT_FIELDS = 7;
+  GcEventLog* log = process->object_heap()->gc_event_log();
+  if (log == null) FAIL(INVALID_ARGUMENT);
+  if (since < 0) FAIL(OUT_OF_BOUNDS);
+  int64 first = Utils::max(since, log->oldest());
+  int64 count = Utils::max<int64>(0, log->recorded() - first);
+  if (count == 0) return process->program()->empty_array();
+  Array* result = process->object_heap()->allocate_array(count * GC_EVENT_FIELDS, Smi::zero());
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  for (int64 i = 0; i < count; i++) {
+    const GcEvent& event = log->at(first + i);
+    Object* fields[GC_EVENT_FIELDS] = {
+      Primitive::integer(first + i, process),
+      Smi::from(event.type),
+      Primitive::integer(event.start_us, process),
+      Primitive::integer(event.end_us, process),
+      Primitive::integer(event.bytes_before, process),
+      Primitive::integer(event.bytes_after, process),
+      Primitive::integer(event.promoted, process),
+    };
+    for (int j = 0; j < GC_EVENT_FIELDS; j++) {
+      if (Primitive::is_error(fields[j])) return fields[j];
+      result->at_put(i * GC_EVENT_FIELDS + j, fields[j]);
+    }
+  }
+  return result;
+}
+
+PRIMITIVE(gc_pause_histogram) {
+  ARGS(int, type);
+  GcEventLog* log = process->object_heap()->gc_event_log();
+  if (log == null) FAIL(INVALID_ARGUMENT);
+  if (type < 0 || type >= GC_EVENT_TYPE_COUNT) FAIL(OUT_OF_BOUNDS);
+  Array* result = process->object_heap()->allocate_array(GcEventLog::HISTOGRAM_BUCKETS, Smi::zero());
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  for (int i = 0; i < GcEventLog::HISTOGRAM_BUCKETS; i++) {
+    Object* count = Primitive::integer(log->histogram(static_cast<GcEventType>(type), i), process);
+    if (Primitive::is_error(count)) return count;
+    result->at_put(i, count);
+  }
+  return result;
+}
+
 PRIMITIVE(create_off_heap_byte_array) {
   ARGS(int, length);
   if (length < 0) FAIL(NEGATIVE_ARGUMENT);
@@ -289,6 +289,45 @@ ByteArray* Process::allocate_byte_array(word length, bool force_external) {
   return null;
 }
 
+ByteArray* Process::allocate_io_buffer() {
+  const word length = IoBufferPool::BUFFER_SIZE;
+  uint8* memory = io_buffer_pool_.acquire();
+  if (memory == null) {
+    ByteArray* result = allocate_byte_array(length, /*force_external*/ true);
+    if (result != null) result->mark_pooled();
+    return result;
+  }
+  register_external_allocation(length);
+  if (ByteArray* result = object_heap()->allocate_external_byte_array(length, memory, true)) {
+    result->mark_pooled();
+    return result;
+  }
+  unregister_external_allocation(length);
+  io_buffer_pool_.release(memory);
+  return null;
+}
+
+ByteArray* Process::trim_io_buffer(ByteArray* array, word length) {
+  ByteArray::Bytes bytes(array);
+  if (length == bytes.length()) return array;
+  if (array->is_pooled()) {
+    ByteArray* result = allocate_byte_array(length);
+    if (result != null) {
+      memcpy(ByteArray::Bytes(result).address(), bytes.address(), length);
+      release_io_buffer(array);
+      return result;
+    }
+  }
+  array->resize_external(this, length);
+  return array;
+}
+
+void Process::release_io_buffer(ByteArray* array) {
+  ASSERT(array->is_pooled());
+  uint8* memory = array->neuter(this);
+  if (!io_buffer_pool_.release(memory)) free(memory);
+}
+
 void Process::_append_message(Message* message) {
   Locker locker(OS::process_mutex());
   if (message->is_object_notify()) {
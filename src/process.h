@@ -16,6 +16,8 @@
 #pragma once
 
 #include "heap.h"
+#include "inline_cache.h"
+#include "io_buffer_pool.h"
 #include "interpreter.h"
 #include "linked.h"
 #include "messaging.h"
@@ -117,6 +119,11 @@ class Process : public ProcessListFromProcessGroup::Element,
   bool idle_since_gc() const { return idle_since_gc_; }
   void set_idle_since_gc(bool value) { idle_since_gc_ = value; }
 
+  // The number of times this process was collected while idle, because
+  // another process ran out of memory.
+  int idle_gc_count() const { return idle_gc_count_; }
+  void increment_idle_gc_count() { idle_gc_count_++; }
+
   Program* program() { return program_; }
   ProcessGroup* group() { return group_; }
   ObjectHeap* object_heap() { return &object_heap_; }
@@ -154,6 +161,13 @@ class Process : public ProcessListFromProcessGroup::Element,
     scheduler_thread_ = scheduler_thread;
   }
 
+  // The scheduler thread whose ready queue holds this process while it is
+  // scheduled.
+  SchedulerThread* ready_thread() { return ready_thread_; }
+  void set_ready_thread(SchedulerThread* ready_thread) {
+    ready_thread_ = ready_thread;
+  }
+
   void signal(Signal signal);
   void clear_signal(Signal signal);
   uint32 signals() const { return signals_; }
@@ -193,6 +207,17 @@ class Process : public ProcessListFromProcessGroup::Element,
   String* allocate_string(const wchar_t* content, word length);
 #endif
   ByteArray* allocate_byte_array(word length, bool force_external=false);
+  // Allocates an external byte array of IoBufferPool::BUFFER_SIZE bytes,
+  // reusing a recycled buffer from the I/O buffer pool when possible.
+  ByteArray* allocate_io_buffer();
+  // Shrinks a byte array that was read into to the given length. A pooled
+  // buffer is copied into a byte array of the right size, and given back
+  // to the pool right away. If that allocation fails, the pooled byte array
+  // is shortened instead.
+  ByteArray* trim_io_buffer(ByteArray* array, word length);
+  // Gives the buffer of a pooled byte array back to the pool and leaves the
+  // byte array empty.
+  void release_io_buffer(ByteArray* array);
 
   void set_max_heap_size(word bytes) {
     object_heap_.set_max_heap_size(bytes);
@@ -224,6 +249,9 @@ class Process : public ProcessListFromProcessGroup::Element,
     return result;
   }
 
+  InlineCache* inline_cache() { return &inline_cache_; }
+  IoBufferPool* io_buffer_pool() { return &io_buffer_pool_; }
+
   Profiler* profiler() const { return profiler_; }
 
   int install_profiler(int task_id) {
@@ -317,6 +345,9 @@ class Process : public ProcessListFromProcessGroup::Element,
   uint8* main_arguments_ = null;
   uint8* spawn_arguments_ = null;
 
+  // Must be declared before the heap, so it outlives the finalizers that
+  // run when the heap is torn down.
+  IoBufferPool io_buffer_pool_;
   ObjectHeap object_heap_;
   int64 last_bytes_allocated_;
 
@@ -337,14 +368,18 @@ class Process : public ProcessListFromProcessGroup::Element,
   uint32_t signals_;
   State state_;
   SchedulerThread* scheduler_thread_;
+  SchedulerThread* ready_thread_ = null;
 
   bool construction_failed_ = false;
   bool idle_since_gc_ = true;
+  int idle_gc_count_ = 0;
 
   UnparsedRootCertificateList root_certificates_;
 
   Profiler* profiler_ = null;
 
+  InlineCache inline_cache_;
+
   HeapObject* false_object_;
   HeapObject* true_object_;
   HeapObject* null_;
@@ -151,6 +151,20 @@ void EventSource::dispatch(const Locker& locker, Resource* r, word data) {
   try_notify(r, locker);
 }
 
+void EventSource::dispatch_batch(const Locker& locker, int count, Resource** resources, word* data, ObjectNotifier** notifiers) {
+  int notify_count = 0;
+  for (int i = 0; i < count; i++) {
+    Resource* r = resources[i];
+    r->set_state(r->resource_group()->on_event(r, data[i], r->state()));
+    if (r->state() == 0) continue;
+    ObjectNotifier* notifier = r->object_notifier();
+    if (notifier != null) notifiers[notify_count++] = notifier;
+  }
+  if (notify_count > 0) {
+    VM::current()->scheduler()->send_notify_messages(notify_count, notifiers);
+  }
+}
+
 // Called on the event source's thread, while holding the event source's lock.
 void EventSource::try_notify(Resource* r, const Locker& locker, bool force) {
   if (!force && r->state() == 0) return;
@@ -255,6 +255,11 @@ class EventSource : public EventSourceList::Element {
   void dispatch(Resource* resource, word data);
   void dispatch(const Locker& locker, Resource* resource, word data);
 
+  // Dispatches a batch of events, and then hands all resulting notifications
+  // to the scheduler in one go. The notifiers array must have room for
+  // count entries.
+  void dispatch_batch(const Locker& locker, int count, Resource** resources, word* data, ObjectNotifier** notifiers);
+
   // Only for EventSources that use the IntResource subclass.
   IntResource* find_resource_by_id(const Locker& locker, word id);
 
@@ -27,6 +27,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "../objects.h"
@@ -290,6 +291,68 @@ PRIMITIVE(write) {
   return Smi::from(wrote);
 }
 
+PRIMITIVE(write_vector) {
+  ARGS(ByteArray, proxy, IntResource, fd_resource, Array, parts, word, skip);
+  USE(proxy);
+  int fd = fd_resource->id();
+
+  if (skip < 0) FAIL(OUT_OF_BOUNDS);
+
+  // Gather the parts into a single system call.  The first [skip] bytes have
+  // already been written by earlier calls.
+  static const int MAX_PARTS = 64;
+  struct iovec vectors[MAX_PARTS];
+  int count = 0;
+  for (word i = 0; i < parts->length() && count < MAX_PARTS; i++) {
+    Blob part;
+    if (!parts->at(i)->byte_content(process->program(), &part, STRINGS_OR_BYTE_ARRAYS)) FAIL(WRONG_BYTES_TYPE);
+    if (skip >= part.length()) {
+      skip -= part.length();
+      continue;
+    }
+    vectors[count].iov_base = const_cast<uint8*>(part.address() + skip);
+    vectors[count].iov_len = part.length() - skip;
+    skip = 0;
+    count++;
+  }
+  if (skip != 0) FAIL(OUT_OF_BOUNDS);
+  if (count == 0) return Smi::from(0);
+
+  struct msghdr message;
+  bzero(&message, sizeof(message));
+  message.msg_iov = vectors;
+  message.msg_iovlen = count;
+  ssize_t wrote = sendmsg(fd, &message, 0);
+  if (wrote == -1) {
+    if (errno == EWOULDBLOCK) return Smi::from(-1);
+    return Primitive::os_error(errno, process);
+  }
+
+  return Smi::from(wrote);
+}
+
+PRIMITIVE(send_file) {
+  ARGS(ByteArray, proxy, IntResource, fd_resource, int, file_fd, int64, offset, word, length);
+  USE(proxy);
+  int fd = fd_resource->id();
+
+  if (offset < 0 || length < 0) FAIL(OUT_OF_BOUNDS);
+
+  // The kernel copies straight from the file to the socket, so the file
+  // content never passes through the Toit heap.
+  off_t sent = length;
+  int result = sendfile(file_fd, fd, offset, &sent, null, 0);
+  if (result == -1) {
+    // A non-blocking socket can accept part of the data and still report
+    // EAGAIN.
+    if (errno == EWOULDBLOCK) return Smi::from(sent > 0 ? sent : -1);
+    if (errno == EINVAL || errno == EBADF || errno == ENOTSOCK) FAIL(INVALID_ARGUMENT);
+    return Primitive::os_error(errno, process);
+  }
+
+  return Smi::from(sent);
+}
+
 PRIMITIVE(read)  {
   ARGS(ByteArray, proxy, IntResource, fd_resource);
   USE(proxy);
@@ -300,22 +363,47 @@ PRIMITIVE(read)  {
     return Primitive::os_error(errno, process);
   }
 
-  available = Utils::max(available, ByteArray::MIN_IO_BUFFER_SIZE);
-  available = Utils::min(available, ByteArray::PREFERRED_IO_BUFFER_SIZE);
-
-  ByteArray* array = process->allocate_byte_array(available, /*force_external*/ true);
+  // Allocate the buffer before reading, so we never consume data from the
+  // socket and then fail to allocate.  Full-sized reads use a buffer from
+  // the process' I/O buffer pool.  Smaller reads get a byte array of the
+  // available size, so they don't keep a whole buffer alive.
+  ByteArray* array;
+  if (available >= ByteArray::PREFERRED_IO_BUFFER_SIZE) {
+    array = process->allocate_io_buffer();
+  } else {
+    available = Utils::max(available, ByteArray::MIN_IO_BUFFER_SIZE);
+    array = process->allocate_byte_array(available, /*force_external*/ true);
+  }
   if (array == null) FAIL(ALLOCATION_FAILED);
 
-  int read = recv(fd, ByteArray::Bytes(array).address(), available, 0);
+  word size = ByteArray::Bytes(array).length();
+  int read = recv(fd, ByteArray::Bytes(array).address(), size, 0);
+  if (read == -1 || read == 0) {
+    int error = errno;
+    if (array->is_pooled()) process->release_io_buffer(array);
+    if (read == 0) return process->null_object();
+    if (error == EWOULDBLOCK) return Smi::from(-1);
+    return Primitive::os_error(error, process);
+  }
+
+  return process->trim_io_buffer(array, read);
+}
+
+PRIMITIVE(read_into)  {
+  ARGS(ByteArray, proxy, IntResource, fd_resource, MutableBlob, buffer, word, from, word, to);
+  USE(proxy);
+  int fd = fd_resource->id();
+
+  if (from < 0 || from > to || to > buffer.length()) FAIL(OUT_OF_BOUNDS);
+
+  int read = recv(fd, buffer.address() + from, to - from, 0);
   if (read == -1) {
     if (errno == EWOULDBLOCK) return Smi::from(-1);
     return Primitive::os_error(errno, process);
   }
-  if (read == 0) return process->null_object();
-
-  array->resize_external(process, read);
+  if (read == 0 && to != from) return process->null_object();
 
-  return array;
+  return Smi::from(read);
 }
 
 PRIMITIVE(error_number) {
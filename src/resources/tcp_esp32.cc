@@ -376,6 +376,50 @@ PRIMITIVE(accept) {
   });
 }
 
+PRIMITIVE(write_vector) {
+  // The Toit code falls back to writing the parts one at a time.
+  FAIL(UNIMPLEMENTED);
+}
+
+PRIMITIVE(send_file) {
+  FAIL(UNIMPLEMENTED);
+}
+
+// Copies [size] bytes from the socket's received pbufs to [destination],
+// releasing the pbufs that have been consumed.  The caller must ensure that
+// at least [size] bytes are available.
+static void consume_read_buffer(LwipSocket* socket, pbuf* p, int offset, uint8* destination, int size) {
+  int bytes_to_ack = 0;
+  int copied = 0;
+  while (copied < size) {
+    int to_copy = Utils::min(p->len - offset, size - copied);
+    uint8* payload = unvoid_cast<uint8*>(p->payload);
+    memcpy(destination + copied, payload + offset, to_copy);
+    copied += to_copy;
+    offset += to_copy;
+    if (offset == p->len) {
+      pbuf* n = p->next;
+      bytes_to_ack += p->len;
+      // Free the first part of the chain.  Increment the ref count of the
+      // next packet in the chain first, so the whole chain doesn't get
+      // freed.
+      if (n != null) pbuf_ref(n);
+      pbuf_free(p);
+      // We don't have to check for null because tot_len won't extend past the last packet.
+      p = n;
+      offset = 0;
+    }
+  }
+
+  socket->set_read_buffer(p, offset);
+
+  // Notify peer that we finished processing some packets and they can send
+  // more on the TCP socket.
+  if (socket->tpcb() != null && bytes_to_ack != 0) {
+    tcp_recved(socket->tpcb(), bytes_to_ack);
+  }
+}
+
 PRIMITIVE(read)  {
   ARGS(SocketResourceGroup, resource_group, LwipSocket, socket);
 
@@ -399,39 +443,35 @@ PRIMITIVE(read)  {
     ByteArray* array = process->allocate_byte_array(allocation_size, false);  // On-heap byte array.
     if (array == null) FAIL(ALLOCATION_FAILED);
 
-    ByteArray::Bytes bytes(array);
-
-    int bytes_to_ack = 0;
-    int copied = 0;
-    while (copied < allocation_size) {
-      int to_copy = Utils::min(p->len - offset, allocation_size - copied);
-      uint8* payload = unvoid_cast<uint8*>(p->payload);
-      memcpy(bytes.address() + copied, payload + offset, to_copy);
-      copied += to_copy;
-      offset += to_copy;
-      if (offset == p->len) {
-        pbuf* n = p->next;
-        bytes_to_ack += p->len;
-        // Free the first part of the chain.  Increment the ref count of the
-        // next packet in the chain first, so the whole chain doesn't get
-        // freed.
-        if (n != null) pbuf_ref(n);
-        pbuf_free(p);
-        // We don't have to check for null because tot_len won't extend past the last packet.
-        p = n;
-        offset = 0;
-      }
-    }
+    consume_read_buffer(socket, p, offset, ByteArray::Bytes(array).address(), allocation_size);
+
+    return array;
+  });
+}
+
+PRIMITIVE(read_into)  {
+  ARGS(SocketResourceGroup, resource_group, LwipSocket, socket, MutableBlob, buffer, word, from, word, to);
+
+  if (from < 0 || from > to || to > buffer.length()) FAIL(OUT_OF_BOUNDS);
+
+  return resource_group->event_source()->call_on_thread([&]() -> Object* {
+    if (socket->error() != ERR_OK) return lwip_error(process, socket->error());
 
-    socket->set_read_buffer(p, offset);
+    int offset;
+    pbuf* p = socket->get_read_buffer(&offset);
 
-    // Notify peer that we finished processing some packets and they can send
-    // more on the TCP socket.
-    if (socket->tpcb() != null && bytes_to_ack != 0) {
-      tcp_recved(socket->tpcb(), bytes_to_ack);
+    if (p == null) {
+      if (socket->read_closed()) return process->null_object();
+      return Smi::from(-1);
     }
 
-    return array;
+    int total_available = p->tot_len - offset;
+    if (total_available < 0) return Smi::from(-1);
+
+    int size = Utils::min<word>(to - from, total_available);
+    consume_read_buffer(socket, p, offset, buffer.address() + from, size);
+
+    return Smi::from(size);
   });
 }
 
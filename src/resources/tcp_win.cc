@@ -454,6 +454,21 @@ PRIMITIVE(read)  {
   return array;
 }
 
+PRIMITIVE(write_vector) {
+  // The Toit code falls back to writing the parts one at a time.
+  FAIL(UNIMPLEMENTED);
+}
+
+PRIMITIVE(send_file) {
+  FAIL(UNIMPLEMENTED);
+}
+
+PRIMITIVE(read_into)  {
+  // Overlapped reads complete into the resource's own buffer, so reading
+  // into a caller supplied buffer would not save a copy.
+  FAIL(UNIMPLEMENTED);
+}
+
 static Object* get_address(SOCKET socket, Process* process, bool peer) {
   ToitSocketAddress socket_address;
 
@@ -62,7 +62,7 @@ PRIMITIVE(create) {
 PRIMITIVE(arm) {
   ARGS(Timer, timer, int64, usec);
 
-  TimerEventSource::instance()->arm(timer, usec);
+  if (!TimerEventSource::instance()->arm(timer, usec)) FAIL(MALLOC_FAILED);
 
   return process->null_object();
 }
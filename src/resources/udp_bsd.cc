@@ -257,6 +257,67 @@ PRIMITIVE(receive) {
   return array;
 }
 
+PRIMITIVE(receive_multiple) {
+  ARGS(ByteArray, proxy, IntResource, connection, Object, buffer_list, Object, size_list, Object, addresses);
+  USE(proxy);
+  int fd = connection->id();
+
+  word count;
+  word sizes_length;
+  Array* buffers = Primitive::list_backing(buffer_list, process, &count);
+  Array* sizes = Primitive::list_backing(size_list, process, &sizes_length);
+  if (buffers == null || sizes == null) FAIL(WRONG_OBJECT_TYPE);
+  if (sizes_length < count) FAIL(OUT_OF_BOUNDS);
+  Array* address_array = null;
+  if (addresses != process->null_object()) {
+    word addresses_length;
+    address_array = Primitive::list_backing(addresses, process, &addresses_length);
+    if (address_array == null) FAIL(WRONG_OBJECT_TYPE);
+    if (addresses_length < 2 * count) FAIL(OUT_OF_BOUNDS);
+  }
+
+  // Validate all arguments before receiving anything, so we never drop
+  // datagrams on the floor.
+  for (word i = 0; i < count; i++) {
+    MutableBlob buffer;
+    Error* error = null;
+    if (!buffers->at(i)->mutable_byte_content(process, &buffer, &error)) return error;
+    if (address_array != null) {
+      Object* address = address_array->at(2 * i);
+      if (!is_byte_array(address)) FAIL(WRONG_OBJECT_TYPE);
+      // TODO: Support IPv6.
+      if (ByteArray::Bytes(ByteArray::cast(address)).length() != 4) FAIL(INVALID_ARGUMENT);
+    }
+  }
+
+  // There is no recvmmsg, so we receive the datagrams one at a time, without
+  // returning to Toit in between.
+  word received = 0;
+  for (; received < count; received++) {
+    MutableBlob buffer;
+    Error* error = null;
+    buffers->at(received)->mutable_byte_content(process, &buffer, &error);
+    struct sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    socklen_t addr_len = sizeof(addr);
+    int read = recvfrom(fd, buffer.address(), buffer.length(), 0, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    if (read == -1) {
+      if (errno == EWOULDBLOCK) break;
+      if (received > 0) break;  // Report the error on the next call.
+      return Primitive::os_error(errno, process);
+    }
+    sizes->at_put(received, Smi::from(read));
+    if (address_array != null) {
+      ByteArray* address = ByteArray::cast(address_array->at(2 * received));
+      memcpy(ByteArray::Bytes(address).address(), &addr.sin_addr.s_addr, 4);
+      address_array->at_put(2 * received + 1, Smi::from(ntohs(addr.sin_port)));
+    }
+  }
+
+  if (received == 0 && count > 0) return Smi::from(-1);
+  return Smi::from(received);
+}
+
 PRIMITIVE(send) {
   ARGS(ByteArray, proxy, IntResource, connection_resource, Blob, data, int, from, int, to, Object, address, int, port);
   USE(proxy);
@@ -428,6 +428,10 @@ PRIMITIVE(receive)  {
   });
 }
 
+PRIMITIVE(receive_multiple) {
+  FAIL(UNIMPLEMENTED);
+}
+
 PRIMITIVE(send) {
   ARGS(UdpResourceGroup, resource_group, UdpSocket, socket, Blob, data, int, from, int, to, Object, address, int, port);
 
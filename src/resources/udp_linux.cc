@@ -237,6 +237,71 @@ PRIMITIVE(receive) {
   return array;
 }
 
+PRIMITIVE(receive_multiple) {
+  ARGS(ByteArray, proxy, IntResource, connection_resource, Object, buffer_list, Object, size_list, Object, addresses);
+  USE(proxy);
+  int fd = connection_resource->id();
+
+  word buffers_length;
+  word sizes_length;
+  Array* buffers = Primitive::list_backing(buffer_list, process, &buffers_length);
+  Array* sizes = Primitive::list_backing(size_list, process, &sizes_length);
+  if (buffers == null || sizes == null) FAIL(WRONG_OBJECT_TYPE);
+
+  // Receive at most this many datagrams per call to limit the stack usage.
+  static const int MAX_DATAGRAMS = 32;
+  word count = Utils::min<word>(buffers_length, MAX_DATAGRAMS);
+  if (sizes_length < count) FAIL(OUT_OF_BOUNDS);
+  Array* address_array = null;
+  if (addresses != process->null_object()) {
+    word addresses_length;
+    address_array = Primitive::list_backing(addresses, process, &addresses_length);
+    if (address_array == null) FAIL(WRONG_OBJECT_TYPE);
+    if (addresses_length < 2 * count) FAIL(OUT_OF_BOUNDS);
+  }
+
+  // Validate all arguments before receiving anything, so we never drop
+  // datagrams on the floor.
+  struct mmsghdr messages[MAX_DATAGRAMS];
+  struct iovec vectors[MAX_DATAGRAMS];
+  struct sockaddr_in addrs[MAX_DATAGRAMS];
+  bzero(messages, sizeof(messages[0]) * count);
+  for (word i = 0; i < count; i++) {
+    MutableBlob buffer;
+    Error* error = null;
+    if (!buffers->at(i)->mutable_byte_content(process, &buffer, &error)) return error;
+    if (address_array != null) {
+      Object* address = address_array->at(2 * i);
+      if (!is_byte_array(address)) FAIL(WRONG_OBJECT_TYPE);
+      // TODO: Support IPv6.
+      if (ByteArray::Bytes(ByteArray::cast(address)).length() != 4) FAIL(INVALID_ARGUMENT);
+    }
+    vectors[i].iov_base = buffer.address();
+    vectors[i].iov_len = buffer.length();
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+    messages[i].msg_hdr.msg_name = &addrs[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+  }
+
+  int received = recvmmsg(fd, messages, count, 0, null);
+  if (received == -1) {
+    if (errno == EWOULDBLOCK || errno == EAGAIN) return Smi::from(-1);
+    return Primitive::os_error(errno, process);
+  }
+
+  for (int i = 0; i < received; i++) {
+    sizes->at_put(i, Smi::from(messages[i].msg_len));
+    if (address_array != null) {
+      ByteArray* address = ByteArray::cast(address_array->at(2 * i));
+      memcpy(ByteArray::Bytes(address).address(), &addrs[i].sin_addr.s_addr, 4);
+      address_array->at_put(2 * i + 1, Smi::from(ntohs(addrs[i].sin_port)));
+    }
+  }
+
+  return Smi::from(received);
+}
+
 PRIMITIVE(send) {
   ARGS(ByteArray, proxy, IntResource, connection_resource, Blob, data, int, from, int, to, Object, address, int, port);
   USE(proxy);
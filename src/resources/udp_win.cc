@@ -328,6 +328,10 @@ PRIMITIVE(connect) {
   return udp_resource_proxy;
 }
 
+PRIMITIVE(receive_multiple) {
+  FAIL(UNIMPLEMENTED);
+}
+
 PRIMITIVE(send) {
   ARGS(ByteArray, proxy, UdpSocketResource, udp_resource, Blob, data, int, from, int, to, Object, address, int, port);
   USE(proxy);
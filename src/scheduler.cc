@@ -44,13 +44,27 @@ static const bool PROCESS_MAX_RUN_TIME_ENFORCE = true;
 static const bool PROCESS_MAX_RUN_TIME_ENFORCE = false;
 #endif
 
+SchedulerThread::SchedulerThread(Scheduler* scheduler, Mutex* mutex)
+    : Thread("Toit")
+    , scheduler_(scheduler)
+    , has_processes_(OS::allocate_condition_variable(mutex)) {}
+
+SchedulerThread::~SchedulerThread() {
+  ASSERT(ready_queue_.is_empty());
+  OS::dispose(has_processes_);
+}
+
+// The scheduler thread that runs on the current OS thread, if any.
+static thread_local SchedulerThread* current_scheduler_thread_ = null;
+
 void SchedulerThread::entry() {
+  current_scheduler_thread_ = this;
   scheduler_->run(this);
+  current_scheduler_thread_ = null;
 }
 
 Scheduler::Scheduler()
     : mutex_(OS::allocate_mutex(2, "Scheduler"))
-    , has_processes_(OS::allocate_condition_variable(mutex_))
     , has_threads_(OS::allocate_condition_variable(mutex_))
     , gc_condition_(OS::allocate_condition_variable(mutex_))
     , gc_cross_processes_(false)
@@ -73,14 +87,11 @@ Scheduler::Scheduler()
 }
 
 Scheduler::~Scheduler() {
-  for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
-    ASSERT(ready_queue_[i].is_empty());
-  }
+  ASSERT(ready_count_ == 0);
   ASSERT(groups_.is_empty());
   ASSERT(threads_.is_empty());
   OS::dispose(gc_condition_);
   OS::dispose(has_threads_);
-  OS::dispose(has_processes_);
   OS::dispose(mutex_);
 }
 
@@ -187,18 +198,20 @@ Scheduler::ExitState Scheduler::launch_program(Locker& locker, Process* process)
   }
 
   while (SchedulerThread* thread = threads_.remove_first()) {
-    Unlocker unlock(locker);
-    thread->join();
-    delete thread;
-  }
-
-  for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
-    ProcessListFromScheduler& ready_queue = ready_queue_[i];
-    while (ready_queue.remove_first()) {
-      // Clear out the list of ready processes, so we don't have any dangling
-      // pointers to processes that we delete in a moment.
-      ready_count_--;
+    { Unlocker unlock(locker);
+      thread->join();
     }
+    ReadyQueue* ready_queue = thread->ready_queue();
+    for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
+      while (Process* process = ready_queue->remove_first(i)) {
+        // Clear out the list of ready processes, so we don't have any dangling
+        // pointers to processes that we delete in a moment.
+        process->set_ready_thread(null);
+        ready_level_count_[i]--;
+        ready_count_--;
+      }
+    }
+    delete thread;
   }
 
   while (ProcessGroup* group = groups_.remove_first()) {
@@ -315,6 +328,17 @@ message_err_t Scheduler::send_system_message(Locker& locker, SystemMessage* mess
 
 void Scheduler::send_notify_message(ObjectNotifier* notifier) {
   Locker locker(mutex_);
+  send_notify_message(locker, notifier);
+}
+
+void Scheduler::send_notify_messages(int count, ObjectNotifier** notifiers) {
+  Locker locker(mutex_);
+  for (int i = 0; i < count; i++) {
+    send_notify_message(locker, notifiers[i]);
+  }
+}
+
+void Scheduler::send_notify_message(Locker& locker, ObjectNotifier* notifier) {
   Process* process = notifier->process();
   if (process->state() == Process::TERMINATING) return;
   process->_append_message(notifier->message());
@@ -394,31 +418,32 @@ void Scheduler::run(SchedulerThread* scheduler_thread) {
   // all OS threads at startup on platforms that may have a hard time starting
   // such threads later due to memory pressure.
   while (!has_exit_reason()) {
-    if (ready_count_ == 0) {
-      OS::wait(has_processes_);
+    // Help with collecting idle processes before picking up new work.
+    if (gc_next_idle_process(locker)) continue;
+    Process* process = next_ready_process(locker, scheduler_thread);
+    if (process == null) {
+      // Use the idle time to sweep the heaps of processes that aren't running.
+      if (sweep_next_idle_process(locker)) continue;
+      waiting_threads_.append(scheduler_thread);
+      OS::wait(scheduler_thread->has_processes_);
+      // We may have been woken up without being picked.
+      if (waiting_threads_.is_linked(scheduler_thread)) {
+        waiting_threads_.unlink(scheduler_thread);
+      }
       continue;
     }
-
-    Process* process = null;
-    for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
-      ProcessListFromScheduler& ready_queue = ready_queue_[i];
-      if (ready_queue.is_empty()) continue;
-      process = ready_queue.remove_first();
-      ready_count_--;
-      break;
-    }
     ASSERT(process->state() == Process::SCHEDULED);
 
     if (ready_count_ > 0) {
       // Notify potential other thread that there are more processes ready.
-      OS::signal(has_processes_);
+      wake_waiting_thread(locker);
     }
 
     run_process(locker, process, scheduler_thread);
   }
 
-  // Notify potential other thread, that no more processes are left.
-  OS::signal(has_processes_);
+  // Notify potential other threads, that no more processes are left.
+  wake_all_threads(locker);
 
   num_threads_--;
 
@@ -454,6 +479,8 @@ void Scheduler::gc(Process* process, bool malloc_failed, bool try_hard) {
   // Avoid getting time if we don't need it.  Best-case scavenges
   // are around 1us on desktop and this call is surprisingly expensive.
   uint64 start = try_hard ? OS::get_monotonic_time() : 0;
+  bool has_heap = process && process->program() != null;  // Not external process.
+  word bytes_before = (try_hard && has_heap) ? process->object_heap()->bytes_allocated() : 0;
 #ifdef TOIT_GC_LOGGING
   bool is_boot_process = process && VM::current()->scheduler()->is_boot_process(process);
 #endif
@@ -496,45 +523,59 @@ void Scheduler::gc(Process* process, bool malloc_failed, bool try_hard) {
   int gcs = 0;
   USE(gcs);
   if (doing_idle_process_gc) {
-    ProcessListFromScheduler targets;
-    { Locker locker(mutex_);
+    int64 idle_start = OS::get_monotonic_time();
+    Locker locker(mutex_);
+    if (gc_idle_in_progress_ > 0 || !gc_idle_pending_.is_empty()) {
+      // Another thread is already collecting the idle processes, so we
+      // just help it.
+      while (gc_next_idle_process(locker)) gcs++;
+    } else {
       for (ProcessGroup* group : groups_) {
         for (Process* target : group->processes()) {
           if (target->program() == null) continue;  // External process.
+          if (target->is_suspended()) continue;  // Being swept in the background.
           if (target->state() != Process::RUNNING && !target->idle_since_gc()) {
             if (target->state() != Process::SUSPENDED_AWAITING_GC) {
               gc_suspend_process(locker, target);
             }
-            targets.append(target);
+            gc_idle_pending_.append(target);
           }
         }
       }
-    }
-
-    for (Process* target : targets) {
-      GcType type = target->gc(try_hard);
-      if (type != NEW_SPACE_GC) {
-        Locker locker(mutex_);
-        target->set_idle_since_gc(true);
-      }
-      gcs++;
-    }
 
-    { Locker locker(mutex_);
-      while (!targets.is_empty()) {
-        Process* target = targets.remove_first();
-        if (target->state() != Process::SUSPENDED_AWAITING_GC) {
-          gc_resume_process(locker, target);
+      if (!gc_idle_pending_.is_empty()) {
+        // Each process has its own heap, so the collections are independent
+        // of each other.  Get the waiting scheduler threads, and the threads
+        // whose processes are waiting for this GC, to help out.
+        gc_idle_try_hard_ = try_hard;
+        wake_all_threads(locker);
+        OS::signal_all(gc_condition_);
+        while (gc_next_idle_process(locker)) gcs++;
+        while (gc_idle_in_progress_ > 0) OS::wait(gc_condition_);
+
+        while (!gc_idle_collected_.is_empty()) {
+          Process* target = gc_idle_collected_.remove_first();
+          if (target->state() != Process::SUSPENDED_AWAITING_GC) {
+            gc_resume_process(locker, target);
+          }
         }
+        gc_idle_rounds_++;
+        gc_idle_pause_us_ += OS::get_monotonic_time() - idle_start;
       }
     }
   }
 
-  if (process && process->program() != null) {
-    // Not external process.
-    process->gc(try_hard);
+  // The collection of the process's own heap records its own events, so the
+  // cross-process event only covers the time before it: stopping the other
+  // processes and collecting their heaps.
+  if (doing_cross_process_gc && has_heap) {
+    ObjectHeap* heap = process->object_heap();
+    heap->record_gc_event(GC_EVENT_CROSS_PROCESS, start, OS::get_monotonic_time(),
+        bytes_before, heap->bytes_allocated());
   }
 
+  if (has_heap) process->gc(try_hard);
+
   if (doing_cross_process_gc) {
     Locker locker(mutex_);
     gc_cross_processes_ = false;
@@ -550,6 +591,41 @@ void Scheduler::gc(Process* process, bool malloc_failed, bool try_hard) {
   }
 }
 
+bool Scheduler::gc_next_idle_process(Locker& locker) {
+  Process* target = gc_idle_pending_.remove_first();
+  if (target == null) return false;
+  gc_idle_in_progress_++;
+  GcType type;
+  { Unlocker unlocker(locker);
+    type = target->gc(gc_idle_try_hard_);
+  }
+  if (type != NEW_SPACE_GC) target->set_idle_since_gc(true);
+  target->increment_idle_gc_count();
+  gc_idle_collected_.append(target);
+  if (--gc_idle_in_progress_ == 0 && gc_idle_pending_.is_empty()) {
+    OS::signal_all(gc_condition_);
+  }
+  return true;
+}
+
+bool Scheduler::sweep_next_idle_process(Locker& locker) {
+  if (gc_cross_processes_ || !gc_idle_pending_.is_empty()) return false;
+  for (ProcessGroup* group : groups_) {
+    for (Process* target : group->processes()) {
+      if (target->program() == null) continue;  // External process.
+      if (target->state() != Process::IDLE) continue;
+      if (!target->object_heap()->has_unswept_chunks()) continue;
+      gc_suspend_process(locker, target);
+      { Unlocker unlocker(locker);
+        target->object_heap()->background_sweep();
+      }
+      gc_resume_process(locker, target);
+      return true;
+    }
+  }
+  return false;
+}
+
 void Scheduler::add_process(Locker& locker, Process* process) {
   num_processes_++;
   process_ready(locker, process);
@@ -577,8 +653,57 @@ Object* Scheduler::process_stats(Array* array, int group_id, int process_id, Pro
   info.largest_free_block = Smi::MAX_SMI_VALUE;
 #endif
   uword max = Smi::MAX_SMI_VALUE;
+  uword page_cache_size;
+  uint64 page_cache_hits;
+  uint64 page_cache_misses;
+  OS::page_cache_stats(&page_cache_size, &page_cache_hits, &page_cache_misses);
   switch (length) {
     default:
+    case 20: {
+      Object* pretenured = Primitive::integer(subject_process->object_heap()->pretenured_objects(), calling_process);
+      if (Primitive::is_error(pretenured)) return pretenured;
+      array->at_put(19, pretenured);
+    }
+      [[fallthrough]];
+    case 19:
+      array->at_put(18, Smi::from(subject_process->object_heap()->stack_bytes()));
+      [[fallthrough]];
+    case 18: {
+      Object* misses = Primitive::integer(page_cache_misses, calling_process);
+      if (Primitive::is_error(misses)) return misses;
+      array->at_put(17, misses);
+    }
+      [[fallthrough]];
+    case 17: {
+      Object* hits = Primitive::integer(page_cache_hits, calling_process);
+      if (Primitive::is_error(hits)) return hits;
+      array->at_put(16, hits);
+    }
+      [[fallthrough]];
+    case 16:
+      array->at_put(15, Smi::from(subject_process->idle_gc_count()));
+      [[fallthrough]];
+    case 15: {
+      Object* pause = Primitive::integer(gc_idle_pause_us_, calling_process);
+      if (Primitive::is_error(pause)) return pause;
+      array->at_put(14, pause);
+    }
+      [[fallthrough]];
+    case 14:
+      array->at_put(13, Smi::from(gc_idle_rounds_));
+      [[fallthrough]];
+    case 13: {
+      Object* misses = Primitive::integer(subject_process->inline_cache()->misses(), calling_process);
+      if (Primitive::is_error(misses)) return misses;
+      array->at_put(12, misses);
+    }
+      [[fallthrough]];
+    case 12: {
+      Object* hits = Primitive::integer(subject_process->inline_cache()->hits(), calling_process);
+      if (Primitive::is_error(hits)) return hits;
+      array->at_put(11, hits);
+    }
+      [[fallthrough]];
     case 11:
       array->at_put(10, Smi::from(subject_process->gc_count(COMPACTING_GC)));
       [[fallthrough]];
@@ -688,6 +813,10 @@ void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* s
           }
         }
       }
+      if (interpreted && process->object_heap()->is_marking_incrementally()) {
+        Unlocker unlock(locker);
+        process->object_heap()->incremental_marking_step();
+      }
       wait_for_any_gc_to_complete(locker, process, Process::IDLE);
       process_ready(locker, process);
       break;
@@ -764,8 +893,7 @@ void Scheduler::update_priority(Locker& locker, Process* process, uint8 priority
   if (process->state() == Process::RUNNING) {
     process->signal(Process::PREEMPT);
   } else if (process->state() == Process::SCHEDULED) {
-    ready_queue(process->priority()).remove(process);
-    ready_count_--;
+    remove_ready_process(locker, process);
     process->set_state(Process::IDLE);
     process_ready(locker, process);
   }
@@ -779,8 +907,7 @@ void Scheduler::gc_suspend_process(Locker& locker, Process* process) {
     process->set_state(Process::SUSPENDED_IDLE);
   } else if (process->state() == Process::SCHEDULED) {
     process->set_state(Process::SUSPENDED_SCHEDULED);
-    ready_queue(process->priority()).remove(process);
-    ready_count_--;
+    remove_ready_process(locker, process);
   }
   ASSERT(process->is_suspended());
 }
@@ -801,7 +928,8 @@ void Scheduler::wait_for_any_gc_to_complete(Locker& locker, Process* process, Pr
     gc_waiting_for_preemption_--;
     OS::signal_all(gc_condition_);
     do {
-      OS::wait(gc_condition_);
+      // While we wait, we help collecting the idle processes.
+      if (!gc_next_idle_process(locker)) OS::wait(gc_condition_);
     } while (gc_cross_processes_);
   }
   process->set_state(new_state);
@@ -813,7 +941,7 @@ SchedulerThread* Scheduler::start_thread(Locker& locker) {
   // other threads. This should be enough, and should ensure that allocation
   // does not fail. On other platforms we assume that allocation will
   // not fail.
-  SchedulerThread* new_thread = _new SchedulerThread(this);
+  SchedulerThread* new_thread = _new SchedulerThread(this, mutex_);
   if (new_thread == null) FATAL("OS thread spawn failed");
   int core = num_threads_++;
   threads_.prepend(new_thread);
@@ -841,11 +969,29 @@ void Scheduler::process_ready(Locker& locker, Process* process) {
   process->set_state(Process::SCHEDULED);
 
   uint8 priority = process->update_priority();
-  ready_queue(priority).append(process);
-  if (++ready_count_ == 1) {
-    // Only signal if we added the first ready process.
-    OS::signal(has_processes_);
+
+  // Processes made ready by a scheduler thread stay on that thread, which
+  // keeps communicating processes close together. Otherwise they go to a
+  // waiting thread, if any. Other threads steal them if they run out of
+  // equally important work.
+  SchedulerThread* target = current_scheduler_thread();
+  bool woken = false;
+  if (target == null) {
+    target = waiting_threads_.remove_first();
+    if (target != null) {
+      OS::signal(target->has_processes_);
+      woken = true;
+    }
   }
+  if (target == null) target = threads_.first();
+  if (target == null) target = start_thread(locker);
+  int level = compute_ready_queue_index(priority);
+  target->ready_queue()->append(level, process);
+  process->set_ready_thread(target);
+  ready_level_count_[level]++;
+  // Only wake a thread if we added the first ready process. Threads that
+  // pick up a process wake the next one if there is more work.
+  if (++ready_count_ == 1 && !woken) wake_waiting_thread(locker);
 
   // Count the number of idle scheduler threads.
   int idle = 0;
@@ -900,18 +1046,69 @@ void Scheduler::terminate_execution(Locker& locker, ExitState exit) {
     }
   }
 
-  OS::signal(has_processes_);
+  wake_all_threads(locker);
 }
 
-void Scheduler::tick(Locker& locker, int64 now) {
-  tick_schedule(locker, now, true);
+SchedulerThread* Scheduler::current_scheduler_thread() {
+  return current_scheduler_thread_;
+}
+
+Process* Scheduler::next_ready_process(Locker& locker, SchedulerThread* scheduler_thread) {
+  for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
+    if (ready_level_count_[i] == 0) continue;
+    Process* process = scheduler_thread->ready_queue()->remove_first(i);
+    if (process == null) {
+      // Another thread has a process at this level, so we steal it.
+      for (SchedulerThread* thread : threads_) {
+        if (thread == scheduler_thread) continue;
+        process = thread->ready_queue()->remove_first(i);
+        if (process != null) break;
+      }
+    }
+    if (process == null) continue;
+    process->set_ready_thread(null);
+    ready_level_count_[i]--;
+    ready_count_--;
+    return process;
+  }
+  return null;
+}
+
+void Scheduler::remove_ready_process(Locker& locker, Process* process) {
+  int level = compute_ready_queue_index(process->priority());
+  SchedulerThread* thread = process->ready_thread();
+  bool removed = thread->ready_queue()->remove(level, process);
+  ASSERT(removed);
+  USE(removed);
+  process->set_ready_thread(null);
+  ready_level_count_[level]--;
+  ready_count_--;
+}
 
-  int first_non_empty_ready_queue = NUMBER_OF_READY_QUEUES;
+int Scheduler::first_non_empty_ready_level(Locker& locker) {
   for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
-    if (ready_queue_[i].is_empty()) continue;
-    first_non_empty_ready_queue = i;
-    break;
+    if (ready_level_count_[i] != 0) return i;
+  }
+  return NUMBER_OF_READY_QUEUES;
+}
+
+void Scheduler::wake_waiting_thread(Locker& locker) {
+  // Unlink the thread, so the next wake-up goes to another thread even
+  // if this one hasn't gotten the mutex yet.
+  SchedulerThread* thread = waiting_threads_.remove_first();
+  if (thread != null) OS::signal(thread->has_processes_);
+}
+
+void Scheduler::wake_all_threads(Locker& locker) {
+  for (SchedulerThread* thread : threads_) {
+    OS::signal(thread->has_processes_);
   }
+}
+
+void Scheduler::tick(Locker& locker, int64 now) {
+  tick_schedule(locker, now, true);
+
+  int first_non_empty_ready_queue = first_non_empty_ready_level(locker);
 
   bool any_profiling = num_profiled_processes_ > 0;
   bool any_ready = first_non_empty_ready_queue < NUMBER_OF_READY_QUEUES;
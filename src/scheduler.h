@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "heap.h"
 #include "linked.h"
 #include "messaging.h"
@@ -26,22 +28,74 @@
 namespace toit {
 
 typedef LinkedList<SchedulerThread> SchedulerThreadList;
+typedef DoubleLinkedList<SchedulerThread> WaitingSchedulerThreadList;
 
-class SchedulerThread : public Thread, public SchedulerThreadList::Element {
+// The ready processes of a single scheduler thread, with a queue for each
+// priority level. The queues are protected by their own lock, which is
+// never held while taking another lock, so adding and removing processes
+// doesn't need the scheduler mutex.
+class ReadyQueue {
  public:
-  explicit SchedulerThread(Scheduler* scheduler)
-      : Thread("Toit")
-      , scheduler_(scheduler) {}
+  static const int LEVELS = 5;
+
+  ReadyQueue() : mutex_(OS::allocate_mutex(3, "Ready queue")) {}
+  ~ReadyQueue() { OS::dispose(mutex_); }
+
+  // The count can be read without taking the lock.
+  bool is_empty() const { return count_ == 0; }
+  int count() const { return count_; }
+
+  void append(int level, Process* process) {
+    Locker locker(mutex_);
+    queues_[level].append(process);
+    count_++;
+  }
+
+  Process* remove_first(int level) {
+    if (is_empty()) return null;
+    Locker locker(mutex_);
+    Process* process = queues_[level].remove_first();
+    if (process != null) count_--;
+    return process;
+  }
 
-  ~SchedulerThread() {}
+  bool remove(int level, Process* process) {
+    Locker locker(mutex_);
+    if (queues_[level].remove(process) == null) return false;
+    count_--;
+    return true;
+  }
+
+ private:
+  Mutex* const mutex_;
+  ProcessListFromScheduler queues_[LEVELS];
+  std::atomic<int> count_ { 0 };
+};
+
+class SchedulerThread : public Thread,
+                        public SchedulerThreadList::Element,
+                        public WaitingSchedulerThreadList::Element {
+ public:
+  SchedulerThread(Scheduler* scheduler, Mutex* mutex);
+  ~SchedulerThread();
 
   Interpreter* interpreter() { return &interpreter_; }
+  ReadyQueue* ready_queue() { return &ready_queue_; }
+  MessageBufferPool* message_buffer_pool() { return &message_buffer_pool_; }
 
   void entry();
 
  private:
   Scheduler* const scheduler_;
   Interpreter interpreter_;
+  ReadyQueue ready_queue_;
+  MessageBufferPool message_buffer_pool_;
+
+  // Signaled when there are ready processes for an idle thread. Uses
+  // the scheduler mutex.
+  ConditionVariable* has_processes_;
+
+  friend class Scheduler;
 };
 
 class Scheduler {
@@ -99,6 +153,11 @@ class Scheduler {
   // Send notify message.
   void send_notify_message(ObjectNotifier* notifier);
 
+  // Send notify messages for a batch of notifiers, taking the scheduler
+  // lock only once. Processes that are notified more than once are
+  // only made ready once.
+  void send_notify_messages(int count, ObjectNotifier** notifiers);
+
   // Send a signal to a target process. Returns true if sender was able to
   // deliver the signal.
   bool signal_process(Process* sender, int target_id, Process::Signal signal);
@@ -149,6 +208,10 @@ class Scheduler {
 
   void iterate_process_chunks(void* context, process_chunk_callback_t callback);
 
+  // Returns the scheduler thread we are running on, or null if the
+  // current thread isn't a scheduler thread.
+  static SchedulerThread* current_scheduler_thread();
+
  private:
   // Introduce a new process to the scheduler. The scheduler will not terminate until
   // all processes has completed.
@@ -175,14 +238,37 @@ class Scheduler {
   // waiting transition to the new state.
   void wait_for_any_gc_to_complete(Locker& locker, Process* process, Process::State new_state);
 
+  // Collects the garbage of the next idle process that is waiting to be
+  // collected, if any.  Releases the scheduler lock while collecting, so
+  // all scheduler threads that are not running processes can help.
+  // Returns false if there was nothing to collect.
+  bool gc_next_idle_process(Locker& locker);
+
+  // Sweeps some of the unswept old-space chunks of an idle process, if any.
+  // The process is suspended while its heap is swept with the scheduler lock
+  // released.  Returns false if there was nothing to sweep.
+  bool sweep_next_idle_process(Locker& locker);
+
   SchedulerThread* start_thread(Locker& locker);
 
   void process_ready(Process* process);
   void process_ready(Locker& locker, Process* process);
 
+  // Finds the most important ready process. Processes in the ready queue
+  // of the given thread are preferred over equally important processes
+  // that are stolen from other threads.
+  Process* next_ready_process(Locker& locker, SchedulerThread* scheduler_thread);
+  void remove_ready_process(Locker& locker, Process* process);
+  int first_non_empty_ready_level(Locker& locker);
+
+  // Wakes up a single waiting scheduler thread.
+  void wake_waiting_thread(Locker& locker);
+  void wake_all_threads(Locker& locker);
+
   bool has_exit_reason() { return exit_state_.reason != EXIT_NONE; }
 
   message_err_t send_system_message(Locker& locker, SystemMessage* message);
+  void send_notify_message(Locker& locker, ObjectNotifier* notifier);
 
   void terminate_execution(Locker& locker, ExitState exit);
 
@@ -209,7 +295,6 @@ class Scheduler {
   int64 tick_next() const { return next_tick_; }
 
   Mutex* mutex_;
-  ConditionVariable* has_processes_;
   ConditionVariable* has_threads_;
   ExitState exit_state_;
 
@@ -222,18 +307,36 @@ class Scheduler {
   // Number of OS threads that we're waiting for to be preempted for GC.
   int gc_waiting_for_preemption_;
 
+  // Idle processes that have been suspended for GC and are waiting to be
+  // collected, the ones that have been collected, and the number of them
+  // that are being collected right now.  Any scheduler thread that isn't
+  // running a process helps with the collection.
+  ProcessListFromScheduler gc_idle_pending_;
+  ProcessListFromScheduler gc_idle_collected_;
+  int gc_idle_in_progress_ = 0;
+  bool gc_idle_try_hard_ = false;
+
+  // Statistics for the collections of idle processes.
+  int gc_idle_rounds_ = 0;
+  int64 gc_idle_pause_us_ = 0;
+
   int num_processes_;
   int next_group_id_;
   int next_process_id_;
   int64 next_tick_ = 0;
 
-  static const int NUMBER_OF_READY_QUEUES = 5;
-  ProcessListFromScheduler ready_queue_[NUMBER_OF_READY_QUEUES];
-  int ready_count_ = 0;
-
-  ProcessListFromScheduler& ready_queue(uint8 priority) {
-    return ready_queue_[compute_ready_queue_index(priority)];
-  }
+  // Each scheduler thread has its own ready queues. Threads take work from
+  // their own queues first and steal from the other threads when they run
+  // out of equally important work. This is the total number of ready
+  // processes across all threads, and the number of them at each priority
+  // level, so the scheduler can find work without visiting every thread.
+  // They are updated together with the queues and read without locking.
+  static const int NUMBER_OF_READY_QUEUES = ReadyQueue::LEVELS;
+  std::atomic<int> ready_count_ { 0 };
+  std::atomic<int> ready_level_count_[NUMBER_OF_READY_QUEUES] = {};
+
+  // Scheduler threads that are waiting for ready processes.
+  WaitingSchedulerThreadList waiting_threads_;
 
   static int compute_ready_queue_index(uint8 priority) {
     if (priority == Process::PRIORITY_CRITICAL) return 0;
@@ -0,0 +1,80 @@
+// Copyright (C) 2026 Toit contributors.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include <atomic>
+
+#include "top.h"
+
+namespace toit {
+
+// A reference counted block of immutable bytes that lives outside the
+// process heaps.  Strings and frozen byte arrays that are sent to other
+// processes are backed by shared blobs, so sending them again only has to
+// add a reference instead of copying the content.
+// Objects point directly at the content of a blob.  The reference count
+// lives in a header just in front of it.  Each external string or byte
+// array that points at a blob holds one reference, and so does each
+// encoded message that hasn't been received yet.  The references held by
+// objects are dropped by their VM finalizers.
+// Blobs are shared between the threads of the VM, so the reference count
+// is atomic.  The content never changes after the blob has been created.
+class SharedBlob {
+ public:
+  // Returns the content of a new blob with a copy of the given bytes, or
+  // null if the allocation failed.  The content is followed by a '\0', so
+  // the blob can also back an external string.  The blob starts out with
+  // one reference.
+  static uint8* allocate(const uint8* source, word length) {
+    void* memory = malloc(sizeof(SharedBlob) + length + 1);
+    if (memory == null) return null;
+    SharedBlob* blob = new (memory) SharedBlob();
+    uint8* content = blob->content();
+    memcpy(content, source, length);
+    content[length] = '\0';
+    return content;
+  }
+
+  static void retain(const uint8* content) {
+    from_content(content)->references_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Drops a reference, and frees the blob when it was the last one.
+  // Ignores null, so callers can forget their references by clearing them.
+  static void release(const uint8* content) {
+    if (content == null) return;
+    SharedBlob* blob = from_content(content);
+    if (blob->references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      blob->~SharedBlob();
+      free(blob);
+    }
+  }
+
+ private:
+  SharedBlob() : references_(1) {}
+
+  uint8* content() { return reinterpret_cast<uint8*>(this + 1); }
+
+  static SharedBlob* from_content(const uint8* content) {
+    return reinterpret_cast<SharedBlob*>(const_cast<uint8*>(content)) - 1;
+  }
+
+  std::atomic<word> references_;
+};
+
+static_assert(sizeof(SharedBlob) % WORD_SIZE == 0, "Shared blob content not word aligned");
+
+} // namespace toit
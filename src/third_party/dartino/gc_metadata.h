@@ -160,6 +160,13 @@ class GcMetadata {
     return page_type != UNKNOWN_SPACE_PAGE;
   }
 
+  // The objects that are marked in place by an old-space GC.  Safe to call
+  // with any object, even a Smi.
+  static INLINE bool in_old_or_large_object_space(Object* object) {
+    PageType page_type = get_page_type(object);
+    return page_type == OLD_SPACE_PAGE || page_type == LARGE_OBJECT_PAGE;
+  }
+
   static inline uint8* starts_for(uword address) {
     ASSERT(in_metadata_range(address));
     return reinterpret_cast<uint8*>((address >> CARD_SIZE_LOG_2) +
@@ -448,6 +455,16 @@ class GcMetadata {
     *reinterpret_cast<uint8*>(mark_byte) = NEW_SPACE_POINTERS;
   }
 
+  // The words in [from, to) may contain pointers from old-space to
+  // new-space.  Used for the precise remembered set of the large-object
+  // space.
+  static void insert_range_into_remembered_set(uword from, uword to) {
+    ASSERT(from < to);
+    uint8* first = remembered_set_for(from);
+    uint8* last = remembered_set_for(to - 1);
+    memset(first, NEW_SPACE_POINTERS, last + 1 - first);
+  }
+
   // May this card contain pointers from old-space to new-space?
   inline static bool is_marked_dirty(uword address) {
     address >>= CARD_SIZE_LOG_2;
@@ -34,7 +34,10 @@ class MarkingStack {
   void clear_overflow() { overflowed_ = false; }
 
   void empty(RootCallback* visitor);
-  void process(RootCallback* visitor, Space* old_space, Space* new_space);
+  // Like empty, but stops after having scanned about [budget] bytes of
+  // objects.  Returns true if the stack was emptied.
+  bool empty(RootCallback* visitor, uword budget);
+  void process(RootCallback* visitor, Space* old_space, Space* new_space, Space* large_object_space);
 
  private:
   static const int CHUNK_SIZE = 128;
@@ -47,11 +50,12 @@ class MarkingStack {
 
 class MarkingVisitor : public RootCallback {
  public:
-  MarkingVisitor(SemiSpace* new_space, MarkingStack* marking_stack)
+  MarkingVisitor(SemiSpace* new_space, MarkingStack* marking_stack, bool shrink_stacks = true)
       : program_(new_space->program()),
         new_space_address_(new_space->single_chunk_start()),
         new_space_size_(new_space->size()),
-        marking_stack_(marking_stack) {}
+        marking_stack_(marking_stack),
+        shrink_stacks_(shrink_stacks) {}
 
   virtual void do_roots(Object** start, word length) override {
     Object** end = start + length;
@@ -59,14 +63,21 @@ class MarkingVisitor : public RootCallback {
     for (Object** p = start; p < end; p++) mark_pointer(*p);
   }
 
-  bool shrink_stacks() const override { return true; }
+  bool shrink_stacks() const override { return shrink_stacks_; }
+
+  void stack_shrunk(word bytes) override { shrunk_stack_bytes_ += bytes; }
+  word shrunk_stack_bytes() const { return shrunk_stack_bytes_; }
 
   // Should we skip marking of a weak map.
   // TODO - only when forced to compact.
   bool skip_marking(HeapObject* object) const override {
+    return is_weak_map(program_, object);
+  }
+
+  static bool is_weak_map(Program* program, HeapObject* object) {
     if (!object->has_active_finalizer()) return false;
     if (!is_instance(object)) return false;
-    if (object->class_id() != program_->map_class_id()) return false;
+    if (object->class_id() != program->map_class_id()) return false;
     return true;
   }
 
@@ -83,6 +94,44 @@ class MarkingVisitor : public RootCallback {
   uword new_space_address_;
   uword new_space_size_;
   MarkingStack* marking_stack_;
+  bool shrink_stacks_;
+  word shrunk_stack_bytes_ = 0;
+};
+
+// Used for the marking slices of an incremental old-space GC, which run
+// while the process is between two runs of the interpreter.  New-space
+// objects move at every scavenge, so only old-space and large objects are
+// marked here.  New-space is traced when the marking is finished.
+class IncrementalMarkingVisitor : public RootCallback {
+ public:
+  IncrementalMarkingVisitor(Program* program, MarkingStack* marking_stack)
+      : program_(program),
+        marking_stack_(marking_stack) {}
+
+  virtual void do_roots(Object** start, word length) override {
+    Object** end = start + length;
+    for (Object** p = start; p < end; p++) mark_pointer(*p);
+  }
+
+  // Black objects must keep their size until the heap is swept, so stacks
+  // are only shrunk by the non-incremental marking.
+  bool shrink_stacks() const override { return false; }
+
+  bool skip_marking(HeapObject* object) const override {
+    return MarkingVisitor::is_weak_map(program_, object);
+  }
+
+ private:
+  void INLINE mark_pointer(Object* object) {
+    if (!GcMetadata::in_old_or_large_object_space(object)) return;
+    HeapObject* heap_object = HeapObject::cast(object);
+    if (!GcMetadata::mark_grey_if_not_marked(heap_object)) {
+      marking_stack_->push(heap_object);
+    }
+  }
+
+  Program* program_;
+  MarkingStack* marking_stack_;
 };
 
 class FixPointersVisitor : public RootCallback {
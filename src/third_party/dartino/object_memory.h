@@ -21,6 +21,7 @@ class FreeList;
 class ScavengeVisitor;
 class HeapObject;
 class HeapObjectVisitor;
+class LargeObjectSpace;
 class MarkingStack;
 class Object;
 class OldSpace;
@@ -46,7 +47,8 @@ static inline bool has_sentinel_at(uword address) {
 enum PageType {
   UNKNOWN_SPACE_PAGE,  // Probably a metadata page.
   OLD_SPACE_PAGE,
-  NEW_SPACE_PAGE
+  NEW_SPACE_PAGE,
+  LARGE_OBJECT_PAGE
 };
 
 typedef DoubleLinkedList<Chunk> ChunkList;
@@ -86,6 +88,10 @@ class Chunk : public ChunkList::Element {
   }
   uword scavenge_pointer() const { return scavenge_pointer_; }
 
+  // Old-space chunks are swept lazily after a mark-sweep.
+  bool needs_sweeping() const { return needs_sweeping_; }
+  void set_needs_sweeping(bool value) { needs_sweeping_ = value; }
+
   void initialize_metadata() const;
 
 #ifdef TOIT_DEBUG
@@ -104,6 +110,7 @@ class Chunk : public ChunkList::Element {
   const uword end_;
   uword scavenge_pointer_;
   uword compaction_top_;
+  bool needs_sweeping_ = false;
 
   Chunk(Space* owner, uword start, uword size);
 
@@ -450,6 +457,20 @@ class OldSpace : public Space {
   // Find pointers to young-space.
   void visit_remembered_set(ScavengeVisitor* visitor);
 
+  // Visit the pointers of all marked objects that may have been written to
+  // since the last scavenge.  Used to finish an incremental marking.
+  void visit_marked_dirty_objects(RootCallback* visitor);
+
+  // While an incremental marking is in progress all newly allocated objects
+  // are marked black.  Their pointers are visited by the scavenger or when
+  // the marking is finished.
+  void set_allocating_black(bool value) { allocating_black_ = value; }
+  bool is_allocating_black() const { return allocating_black_; }
+
+  // Clears the mark and mark stack overflow bits left behind by an
+  // abandoned incremental marking.
+  void clear_marking_state();
+
   // For the objects promoted to the old space during scavenge.
   void start_scavenge();
   bool complete_scavenge(ScavengeVisitor* visitor);
@@ -469,7 +490,21 @@ class OldSpace : public Space {
 
   void set_used_after_last_gc(uword used) { used_after_last_gc_ = used; }
 
-  uword sweep();
+  // Lazy sweeping.  After a non-compacting mark-sweep, the empty chunks are
+  // freed and the rest are left unswept.  They are swept one at a time when
+  // the free list runs dry, before scavenges, and by idle scheduler threads.
+  // Returns the number of live bytes.
+  uword start_lazy_sweep();
+  bool has_unswept_chunks() const { return unswept_chunks_ != 0; }
+  // Sweeps the next unswept chunk.  Returns its size, or 0 if all chunks
+  // have been swept.
+  uword sweep_next_chunk();
+  // Sweeps chunks until at least [bytes] of chunks have been swept.
+  void sweep_until(uword bytes);
+  void complete_sweep();
+  // Called before marking.  The unswept chunks are treated like the other
+  // chunks by the marking and swept or compacted afterwards.
+  void abandon_lazy_sweep();
 
   // Tells whether garbage collection is needed.  Only to be called when
   // bump allocation has failed, or on old space after a new-space GC.
@@ -488,12 +523,24 @@ class OldSpace : public Space {
   uword allocate_in_new_chunk(uword size);
   Chunk* allocate_and_use_chunk(uword size);
   void validate_sweep(Chunk* chunk);
+  void sweep_chunk(Chunk* chunk);
+
+  template <typename CardCallback, typename ObjectCallback>
+  void iterate_dirty_cards(const CardCallback& card_callback, const ObjectCallback& object_callback);
 
   TwoSpaceHeap* heap_;
   FreeList free_list_;  // Free list structure.
   bool tracking_allocations_ = false;
   PromotedTrack* promoted_track_ = null;
   bool compacting_ = true;
+  bool allocating_black_ = false;
+
+  int unswept_chunks_ = 0;
+  // All unswept chunks are at or after the cursor.
+  ChunkListIterator sweep_cursor_;
+  // Only used for tracegc.
+  int lazy_sweep_chunks_ = 0;
+  uint64 lazy_sweep_us_ = 0;
 
   // Actually new space garbage found since last compacting GC. Used to
   // evaluate whether we are out of memory.
@@ -507,6 +554,62 @@ class OldSpace : public Space {
   bool promotion_failed_ = false;
 };
 
+// The large-object space holds the objects that are too big for a page.
+// Currently these are only arrays, since big strings and byte arrays are
+// external.  Each object gets a page-aligned chunk of its own.  The objects
+// are never moved: the scavenger leaves them alone, and the mark-sweep GC
+// marks them in place and frees the chunks of the dead ones.
+//
+// Unlike the rest of the heap, the objects in this space have a precise
+// remembered set.  The write barrier marks the card of the written array
+// element rather than the card of the object header, so a scavenge only
+// visits the elements in the dirty cards.
+class LargeObjectSpace : public Space {
+ public:
+  LargeObjectSpace(Program* program, TwoSpaceHeap* heap);
+
+  virtual bool is_alive(HeapObject* old_location);
+  virtual bool has_active_finalizer(HeapObject* object);
+
+  virtual uword used() const { return used_; }
+
+  // The objects fill their chunks, so there is nothing to flush.
+  virtual void flush() {}
+  virtual bool is_flushed() { return true; }
+
+  // Allocate raw object in a new chunk.  Returns 0 if the heap limit does
+  // not allow the chunk, or if the chunk could not be allocated.
+  uword allocate(uword size);
+
+  // Find pointers to young-space.
+  void visit_remembered_set(ScavengeVisitor* visitor);
+
+  // Visit the elements in dirty cards of the marked objects.  Used to finish
+  // an incremental marking.
+  void visit_marked_dirty_objects(RootCallback* visitor);
+
+  // See OldSpace::set_allocating_black.
+  void set_allocating_black(bool value) { allocating_black_ = value; }
+
+  // Called after marking.  Frees the chunks of the unmarked objects and
+  // clears the mark bits of the others.  Returns the number of live bytes.
+  uword sweep();
+
+  // Clears the mark and mark stack overflow bits left behind by an
+  // abandoned incremental marking.
+  void clear_marking_state();
+
+  void validate();
+
+ private:
+  template <typename CardCallback, typename SlotsCallback>
+  void iterate_dirty_cards(const CardCallback& card_callback, const SlotsCallback& slots_callback);
+
+  TwoSpaceHeap* heap_;
+  uword used_ = 0;
+  bool allocating_black_ = false;
+};
+
 // ObjectMemory controls all memory used by object heaps.
 class ObjectMemory {
  public:
@@ -4,6 +4,7 @@
 
 #include "../../top.h"
 
+#include "../../flags.h"
 #include "../../utils.h"
 #include "../../objects.h"
 #include "mark_sweep.h"
@@ -19,7 +20,8 @@ namespace toit {
 
 OldSpace::OldSpace(Program* program, TwoSpaceHeap* owner)
     : Space(program, CAN_RESIZE, OLD_SPACE_PAGE),
-      heap_(owner) {}
+      heap_(owner),
+      sweep_cursor_(chunk_list_.end()) {}
 
 OldSpace::~OldSpace() {}
 
@@ -165,6 +167,11 @@ uword OldSpace::allocate(uword size) {
     uword result = top_;
     top_ += size;
     GcMetadata::record_start(result);
+    if (allocating_black_) {
+      HeapObject* object = HeapObject::from_address(result);
+      GcMetadata::mark(object);
+      GcMetadata::mark_all(object, size);
+    }
     return result;
   }
 
@@ -174,6 +181,11 @@ uword OldSpace::allocate(uword size) {
 
   // Can't use bump allocation. Allocate from free lists.
   uword result = allocate_from_free_list(size);
+  // Sweeping a chunk while scavenging could free a dead object that is being
+  // visited, so the chunks are swept before the scavenge starts instead.
+  while (result == 0 && !tracking_allocations_ && sweep_next_chunk() != 0) {
+    result = allocate_from_free_list(size);
+  }
   if (result == 0) result = allocate_in_new_chunk(size);
   return result;
 }
@@ -256,9 +268,14 @@ class RememberedSetRebuilder : public HeapObjectVisitor {
   RememberedSetRebuilder2 pointer_callback;
 };
 
-void OldSpace::visit_remembered_set(ScavengeVisitor* visitor) {
-  flush();
+// Calls card_callback with the remembered set byte of every dirty card, and
+// then object_callback with every object that starts in that card.
+// In chunks that are not swept yet, only the marked objects are live.  The
+// dead ones may point at memory that has been reused, so they are skipped.
+template <typename CardCallback, typename ObjectCallback>
+void OldSpace::iterate_dirty_cards(const CardCallback& card_callback, const ObjectCallback& object_callback) {
   for (auto chunk : chunk_list_) {
+    bool only_marked = chunk->needs_sweeping();
     // Scan the byte-map for cards that may have new-space pointers.
     uword current = chunk->start();
     uword bytes = reinterpret_cast<uword>(GcMetadata::remembered_set_for(current));
@@ -320,14 +337,12 @@ void OldSpace::visit_remembered_set(ScavengeVisitor* visitor) {
           HeapObject* object = HeapObject::from_address(iteration_start);
           iteration_start += object->size(program_);
         }
-        // Reset in case there are no new-space pointers any more.
-        *byte = GcMetadata::NO_NEW_SPACE_POINTERS;
-        visitor->set_record_new_space_pointers(byte);
+        card_callback(byte);
         // Iterate objects that start in the relevant card.
         while (iteration_start < current + GcMetadata::CARD_SIZE) {
           if (has_sentinel_at(iteration_start)) break;
           HeapObject* object = HeapObject::from_address(iteration_start);
-          object->roots_do(program_, visitor);
+          if (!only_marked || GcMetadata::is_marked(object)) object_callback(object);
           iteration_start += object->size(program_);
         }
         earliest_iteration_start = iteration_start;
@@ -338,6 +353,38 @@ void OldSpace::visit_remembered_set(ScavengeVisitor* visitor) {
   }
 }
 
+void OldSpace::visit_remembered_set(ScavengeVisitor* visitor) {
+  flush();
+  iterate_dirty_cards(
+    [&](uint8* byte) {
+      // Reset in case there are no new-space pointers any more.
+      *byte = GcMetadata::NO_NEW_SPACE_POINTERS;
+      visitor->set_record_new_space_pointers(byte);
+    },
+    [&](HeapObject* object) {
+      object->roots_do(program_, visitor);
+    });
+}
+
+void OldSpace::visit_marked_dirty_objects(RootCallback* visitor) {
+  flush();
+  // The write barrier dirties the card of every object that is written to,
+  // so the objects that were written to after they were scanned by the
+  // incremental marking are all in dirty cards.  Cards that were cleaned by
+  // a scavenge in the meantime have had their old-space pointers marked by
+  // the scavenger.
+  iterate_dirty_cards(
+    [&](uint8* byte) {},
+    [&](HeapObject* object) {
+      if (GcMetadata::is_marked(object)) object->roots_do(program_, visitor);
+    });
+}
+
+void OldSpace::clear_marking_state() {
+  clear_mark_bits();
+  for (auto chunk : chunk_list_) GcMetadata::initialize_overflow_bits_for_chunk(chunk);
+}
+
 void OldSpace::unlink_promoted_track() {
   PromotedTrack* promoted = promoted_track_;
   promoted_track_ = null;
@@ -495,117 +542,185 @@ uword CompactingVisitor::visit(HeapObject* object) {
   return size;
 }
 
-// Sweep method that mostly looks at the mark bits.  For speed it doesn't touch
-// the live objects, but writes freelist structures in the gaps between them.
-uword OldSpace::sweep() {
+// After a mark-sweep, the chunks are swept lazily.  Here we only look at the
+// mark bits to free the chunks that are completely empty and to find the
+// number of live bytes.  The remaining chunks keep their mark bits and are
+// swept one at a time later.  Until then their dead objects are still
+// iterable, but they must not be followed since they may point at memory
+// that has been reused.
+uword OldSpace::start_lazy_sweep() {
   // Clear the free list. It will be rebuilt during sweeping.
   free_list_.clear();
   uword used = 0;
-  const word SINGLE_FREE_WORD = -108;
-  ASSERT(reinterpret_cast<Object*>(SINGLE_FREE_WORD) == FreeListRegion::single_free_word_header());
+  unswept_chunks_ = 0;
   chunk_list_.remove_wherever([&](Chunk* chunk) -> bool {
-    uword line = chunk->start();
-    uword end = line + chunk->size();
     uint32* mark_bits = GcMetadata::mark_bits_for(chunk->start());
-    while (line < end) {
-      ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
-      // Only put complete empty lines on the freelist.
-      uint32 bits = *mark_bits;
-      if (bits != 0) {
-        if (bits != 0xffffffff) {
-          // Not entirely free.  Zap any free words with single-word marker.
-          // We may end up zapping the tail of a free area here, but that's
-          // OK because the FreeListRegion header is only 3 words and the free
-          // areas are at least 32 words long.
-          // The object starts may end up pointing at one of these single free
-          // word things, but that's OK because they are iterable.
-          for (int i = 0; i < GcMetadata::CARD_SIZE / WORD_SIZE; i++) {
-            if ((bits & (1U << i)) == 0) {
-              *reinterpret_cast<word*>(line + (i << WORD_SIZE_LOG_2)) = SINGLE_FREE_WORD;
-            }
-          }
-        }
-        line += GcMetadata::CARD_SIZE;
-        mark_bits++;
-        ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
-        used += Utils::popcount(bits);
-        continue;
-      }
-      // All 32 bits are zero so we have found a free area at least 32 words long.
-      uword start_of_free = line;
-      uint8* object_start_location = GcMetadata::starts_for(line);
-      if (line != chunk->start()) {
-        // Free area may have started in previous line.
-        uint32 previous_mark_bits = mark_bits[-1];
-        if ((previous_mark_bits & 0x80000000) == 0) {  // Check last bit.
-          ASSERT(previous_mark_bits != 0);
-          // Count most significant zeros to get free bytes at end of previous line.
-          start_of_free -= Utils::clz(previous_mark_bits) << WORD_SIZE_LOG_2;
-          // Object starts may be pointing into the free area, which we have to
-          // fix.
-          uint8* previous_object_start_location = object_start_location - 1;
-          ASSERT(previous_object_start_location == GcMetadata::starts_for(start_of_free));
-          // The object starts may point to the middle of this free area, which
-          // is not the valid start of an object.  So we reset it to the start of
-          // the free area, which is a place we can always iterate from.
-          *previous_object_start_location = start_of_free;
-        }
-      }
-      // Scan to find the end of the free area.
-      while (bits == 0) {
-        ASSERT(object_start_location == GcMetadata::starts_for(line));
-        *object_start_location++ = GcMetadata::NO_OBJECT_START;
-        line += GcMetadata::CARD_SIZE;
-        mark_bits++;
-        ASSERT(object_start_location == GcMetadata::starts_for(line));
-        ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
-        if (line == end) {
-          if (start_of_free == chunk->start()) {
-            ObjectMemory::free_chunk(chunk);
-            return true;  // Remove empty chunks from list.
-          }
-          // The last free space must end one word earlier to make space for
-          // the end-of-chunk sentinel.
-          free_list_.add_region(start_of_free, end - start_of_free - WORD_SIZE);
-          goto end_of_chunk;
-        }
-        bits = *mark_bits;
-      }
-      // Found a mark bit indicating the end of the free area.
-      ASSERT(bits == *mark_bits);
-      ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
-      used += Utils::popcount(bits);
-      int free_words_at_start = Utils::ctz(bits);
-      if (bits + (1U << free_words_at_start) != 0) {
-        // The bits don't follow the pattern 1*0*, so we have to zap more
-        // free areas in this line.
-        for (int i = free_words_at_start; i < 32; i++) {
+    uint32* limit = GcMetadata::mark_bits_for(chunk->end());
+    uword live = 0;
+    for (uint32* bits = mark_bits; bits < limit; bits++) live += Utils::popcount(*bits);
+    if (live == 0) {
+      ObjectMemory::free_chunk(chunk);
+      return true;  // Remove empty chunks from list.
+    }
+    chunk->set_needs_sweeping(true);
+    unswept_chunks_++;
+    used += live << WORD_SIZE_LOG_2;
+    return false;  // Keep chunk in space.
+  });
+  sweep_cursor_ = chunk_list_.begin();
+  return used;
+}
+
+uword OldSpace::sweep_next_chunk() {
+  if (unswept_chunks_ == 0) return 0;
+  // Chunks that are allocated while we are sweeping lazily are appended to
+  // the chunk list and never need sweeping, so the unswept chunks are all
+  // found from the cursor onwards.
+  while (!sweep_cursor_->needs_sweeping()) ++sweep_cursor_;
+  Chunk* chunk = *sweep_cursor_;
+  ++sweep_cursor_;
+  uint64 start = Flags::tracegc ? OS::get_monotonic_time() : 0;
+  sweep_chunk(chunk);
+  chunk->set_needs_sweeping(false);
+  unswept_chunks_--;
+  if (Flags::tracegc) {
+    lazy_sweep_us_ += OS::get_monotonic_time() - start;
+    lazy_sweep_chunks_++;
+    if (unswept_chunks_ == 0) {
+      printf("%p Lazy sweep: %d chunks %dus\n",
+          heap_->process(),
+          lazy_sweep_chunks_,
+          static_cast<int>(lazy_sweep_us_));
+      lazy_sweep_us_ = 0;
+      lazy_sweep_chunks_ = 0;
+    }
+  }
+  return chunk->size();
+}
+
+void OldSpace::sweep_until(uword bytes) {
+  uword swept = 0;
+  while (swept < bytes) {
+    uword chunk_size = sweep_next_chunk();
+    if (chunk_size == 0) break;
+    swept += chunk_size;
+  }
+}
+
+void OldSpace::complete_sweep() {
+  while (sweep_next_chunk() != 0) {}
+}
+
+void OldSpace::abandon_lazy_sweep() {
+  if (unswept_chunks_ == 0) return;
+  // The unswept chunks are swept or compacted after the next marking, which
+  // needs their mark bits to be clear.
+  for (auto chunk : chunk_list_) {
+    if (!chunk->needs_sweeping()) continue;
+    GcMetadata::clear_mark_bits_for_chunk(chunk);
+    chunk->set_needs_sweeping(false);
+  }
+  unswept_chunks_ = 0;
+}
+
+// Sweep method that mostly looks at the mark bits.  For speed it doesn't touch
+// the live objects, but writes freelist structures in the gaps between them.
+void OldSpace::sweep_chunk(Chunk* chunk) {
+  const word SINGLE_FREE_WORD = -108;
+  ASSERT(reinterpret_cast<Object*>(SINGLE_FREE_WORD) == FreeListRegion::single_free_word_header());
+  uword line = chunk->start();
+  uword end = line + chunk->size();
+  uint32* mark_bits = GcMetadata::mark_bits_for(chunk->start());
+  while (line < end) {
+    ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
+    // Only put complete empty lines on the freelist.
+    uint32 bits = *mark_bits;
+    if (bits != 0) {
+      if (bits != 0xffffffff) {
+        // Not entirely free.  Zap any free words with single-word marker.
+        // We may end up zapping the tail of a free area here, but that's
+        // OK because the FreeListRegion header is only 3 words and the free
+        // areas are at least 32 words long.
+        // The object starts may end up pointing at one of these single free
+        // word things, but that's OK because they are iterable.
+        for (int i = 0; i < GcMetadata::CARD_SIZE / WORD_SIZE; i++) {
           if ((bits & (1U << i)) == 0) {
             *reinterpret_cast<word*>(line + (i << WORD_SIZE_LOG_2)) = SINGLE_FREE_WORD;
           }
         }
       }
-      uword end_of_free = line + (free_words_at_start << WORD_SIZE_LOG_2);
-      free_list_.add_region(start_of_free, end_of_free - start_of_free);
-      // We set the object starts for this card to NO_OBJECT_START, but
-      // that's not very helpful.  Repair it to point to the end of the
-      // free area, which is a valid place to iterate from.
-      uint8* end_starts_location = GcMetadata::starts_for(end_of_free);
-      ASSERT(end_of_free < end);
-      *end_starts_location = end_of_free;
       line += GcMetadata::CARD_SIZE;
       mark_bits++;
+      ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
+      continue;
+    }
+    // All 32 bits are zero so we have found a free area at least 32 words long.
+    uword start_of_free = line;
+    uint8* object_start_location = GcMetadata::starts_for(line);
+    if (line != chunk->start()) {
+      // Free area may have started in previous line.
+      uint32 previous_mark_bits = mark_bits[-1];
+      if ((previous_mark_bits & 0x80000000) == 0) {  // Check last bit.
+        ASSERT(previous_mark_bits != 0);
+        // Count most significant zeros to get free bytes at end of previous line.
+        start_of_free -= Utils::clz(previous_mark_bits) << WORD_SIZE_LOG_2;
+        // Object starts may be pointing into the free area, which we have to
+        // fix.
+        uint8* previous_object_start_location = object_start_location - 1;
+        ASSERT(previous_object_start_location == GcMetadata::starts_for(start_of_free));
+        // The object starts may point to the middle of this free area, which
+        // is not the valid start of an object.  So we reset it to the start of
+        // the free area, which is a place we can always iterate from.
+        *previous_object_start_location = start_of_free;
+      }
+    }
+    // Scan to find the end of the free area.
+    while (bits == 0) {
+      ASSERT(object_start_location == GcMetadata::starts_for(line));
+      *object_start_location++ = GcMetadata::NO_OBJECT_START;
+      line += GcMetadata::CARD_SIZE;
+      mark_bits++;
+      ASSERT(object_start_location == GcMetadata::starts_for(line));
+      ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
+      if (line == end) {
+        // The last free space must end one word earlier to make space for
+        // the end-of-chunk sentinel.
+        free_list_.add_region(start_of_free, end - start_of_free - WORD_SIZE);
+        goto end_of_chunk;
+      }
+      bits = *mark_bits;
+    }
+    // Found a mark bit indicating the end of the free area.
+    ASSERT(bits == *mark_bits);
+    ASSERT(mark_bits == GcMetadata::mark_bits_for(line));
+    int free_words_at_start = Utils::ctz(bits);
+    if (bits + (1U << free_words_at_start) != 0) {
+      // The bits don't follow the pattern 1*0*, so we have to zap more
+      // free areas in this line.
+      for (int i = free_words_at_start; i < 32; i++) {
+        if ((bits & (1U << i)) == 0) {
+          *reinterpret_cast<word*>(line + (i << WORD_SIZE_LOG_2)) = SINGLE_FREE_WORD;
+        }
+      }
     }
-  end_of_chunk:
-    // Repair sentinel in case it was zapped by a marking bitmap.
-    *reinterpret_cast<Object**>(end - WORD_SIZE) = chunk_end_sentinel();
+    uword end_of_free = line + (free_words_at_start << WORD_SIZE_LOG_2);
+    free_list_.add_region(start_of_free, end_of_free - start_of_free);
+    // We set the object starts for this card to NO_OBJECT_START, but
+    // that's not very helpful.  Repair it to point to the end of the
+    // free area, which is a valid place to iterate from.
+    uint8* end_starts_location = GcMetadata::starts_for(end_of_free);
+    ASSERT(end_of_free < end);
+    *end_starts_location = end_of_free;
+    line += GcMetadata::CARD_SIZE;
+    mark_bits++;
+  }
+end_of_chunk:
+  // Repair sentinel in case it was zapped by a marking bitmap.
+  *reinterpret_cast<Object**>(end - WORD_SIZE) = chunk_end_sentinel();
 #ifdef TOIT_DEBUG
-    validate_sweep(chunk);
+  validate_sweep(chunk);
 #endif
-    GcMetadata::clear_mark_bits_for_chunk(chunk);
-    return false;  // Keep chunk in space.
-  });
-  return used << WORD_SIZE_LOG_2;
+  GcMetadata::clear_mark_bits_for_chunk(chunk);
 }
 
 #ifdef TOIT_DEBUG
@@ -699,14 +814,28 @@ void MarkingStack::empty(RootCallback* visitor) {
   }
 }
 
+bool MarkingStack::empty(RootCallback* visitor, uword budget) {
+  uword scanned = 0;
+  while (!is_empty()) {
+    if (scanned >= budget) return false;
+    HeapObject* object = *--next_;
+    object->roots_do(program_, visitor);
+    uword size = object->size(program_);
+    GcMetadata::mark_all(object, size);
+    scanned += size;
+  }
+  return true;
+}
+
 void MarkingStack::process(RootCallback* visitor, Space* old_space,
-                           Space* new_space) {
+                           Space* new_space, Space* large_object_space) {
   while (!is_empty() || is_overflowed()) {
     empty(visitor);
     if (is_overflowed()) {
       clear_overflow();
       old_space->iterate_overflowed_objects(visitor, this);
       new_space->iterate_overflowed_objects(visitor, this);
+      large_object_space->iterate_overflowed_objects(visitor, this);
     }
   }
 }
@@ -730,4 +859,149 @@ PromotedTrack* PromotedTrack::initialize(PromotedTrack* next, uword location, uw
   return self;
 }
 
+LargeObjectSpace::LargeObjectSpace(Program* program, TwoSpaceHeap* heap)
+    : Space(program, CAN_RESIZE, LARGE_OBJECT_PAGE),
+      heap_(heap) {}
+
+bool LargeObjectSpace::is_alive(HeapObject* old_location) {
+  return GcMetadata::is_marked(old_location);
+}
+
+bool LargeObjectSpace::has_active_finalizer(HeapObject* old_location) {
+  return old_location->has_active_finalizer();
+}
+
+uword LargeObjectSpace::allocate(uword size) {
+  ASSERT(Utils::is_aligned(size, WORD_SIZE));
+  uword chunk_size = Utils::round_up(size + SENTINEL_SIZE, TOIT_PAGE_SIZE);
+  word max_expansion = heap_->max_external_allocation();
+  if (max_expansion < 0 || chunk_size > static_cast<uword>(max_expansion)) {
+    return 0;
+  }
+  Chunk* chunk = ObjectMemory::allocate_chunk(this, chunk_size);
+  if (chunk == null) {
+    heap_->report_malloc_failed();
+    return 0;
+  }
+  append(chunk);
+
+  uword result = chunk->start();
+  uword end = result + size;
+  // Make the rest of the chunk iterable.  The filler is never allocated in.
+  uword usable_end = chunk->usable_end();
+  if (end != usable_end) FreeListRegion::create_at(end, usable_end - end);
+  write_sentinel_at(usable_end);
+  GcMetadata::record_start(result);
+  // The code that initializes new objects assumes that they are in new-space
+  // and does not use the write barrier, so all the cards of the object are
+  // dirty until the next scavenge.
+  GcMetadata::insert_range_into_remembered_set(result, end);
+  if (allocating_black_) {
+    HeapObject* object = HeapObject::from_address(result);
+    GcMetadata::mark(object);
+    GcMetadata::mark_all(object, size);
+  }
+  used_ += size;
+  return result;
+}
+
+// Calls card_callback with the remembered set byte of every dirty card, and
+// then slots_callback with the array elements in that card.
+template <typename CardCallback, typename SlotsCallback>
+void LargeObjectSpace::iterate_dirty_cards(const CardCallback& card_callback, const SlotsCallback& slots_callback) {
+  for (auto chunk : chunk_list_) {
+    HeapObject* object = HeapObject::from_address(chunk->start());
+    // Only arrays are allocated in the large-object space.
+    ASSERT(is_array(object));
+    Array* array = Array::cast(object);
+    uword from = reinterpret_cast<uword>(array->base());
+    uword to = from + array->length() * WORD_SIZE;
+    uword card = chunk->start();
+    uword bytes = reinterpret_cast<uword>(GcMetadata::remembered_set_for(card));
+    while (card < to) {
+      if (Utils::is_aligned(bytes, sizeof(uword))) {
+        // Skip blank cards n at a time.  The chunks are a whole number of
+        // pages, so this never reads the cards of the next chunk.
+        ASSERT(GcMetadata::NO_NEW_SPACE_POINTERS == 0);
+        if (*reinterpret_cast<uword*>(bytes) == 0) {
+          bytes += sizeof(uword);
+          card += sizeof(uword) * GcMetadata::CARD_SIZE;
+          continue;
+        }
+      }
+      uint8* byte = reinterpret_cast<uint8*>(bytes);
+      if (*byte != GcMetadata::NO_NEW_SPACE_POINTERS) {
+        card_callback(byte);
+        uword start = Utils::max(card, from);
+        uword end = Utils::min(card + GcMetadata::CARD_SIZE, to);
+        if (start < end) {
+          slots_callback(object, reinterpret_cast<Object**>(start), (end - start) / WORD_SIZE);
+        }
+      }
+      bytes++;
+      card += GcMetadata::CARD_SIZE;
+    }
+  }
+}
+
+void LargeObjectSpace::visit_remembered_set(ScavengeVisitor* visitor) {
+  iterate_dirty_cards(
+    [&](uint8* byte) {
+      // Reset in case there are no new-space pointers any more.
+      *byte = GcMetadata::NO_NEW_SPACE_POINTERS;
+      visitor->set_record_new_space_pointers(byte);
+    },
+    [&](HeapObject* object, Object** slots, word count) {
+      visitor->do_roots(slots, count);
+    });
+}
+
+void LargeObjectSpace::visit_marked_dirty_objects(RootCallback* visitor) {
+  // Unmarked objects are scanned completely if they are marked later.
+  iterate_dirty_cards(
+    [&](uint8* byte) {},
+    [&](HeapObject* object, Object** slots, word count) {
+      if (GcMetadata::is_marked(object)) visitor->do_roots(slots, count);
+    });
+}
+
+uword LargeObjectSpace::sweep() {
+  used_ = 0;
+  chunk_list_.remove_wherever([&](Chunk* chunk) -> bool {
+    HeapObject* object = HeapObject::from_address(chunk->start());
+    if (!GcMetadata::is_marked(object)) {
+      ObjectMemory::free_chunk(chunk);
+      return true;
+    }
+    GcMetadata::clear_mark_bits_for_chunk(chunk);
+    used_ += object->size(program_);
+    return false;
+  });
+  return used_;
+}
+
+void LargeObjectSpace::clear_marking_state() {
+  clear_mark_bits();
+  for (auto chunk : chunk_list_) GcMetadata::initialize_overflow_bits_for_chunk(chunk);
+}
+
+#ifdef TOIT_DEBUG
+void LargeObjectSpace::validate() {
+  // Verify that the remembered set is marked for all the array elements that
+  // point to new-space.
+  for (auto chunk : chunk_list_) {
+    HeapObject* object = HeapObject::from_address(chunk->start());
+    ASSERT(is_array(object));
+    ASSERT(*GcMetadata::starts_for(chunk->start()) == static_cast<uint8>(chunk->start()));
+    Array* array = Array::cast(object);
+    Object** elements = array->base();
+    for (word i = 0; i < array->length(); i++) {
+      if (GcMetadata::get_page_type(elements[i]) == NEW_SPACE_PAGE) {
+        ASSERT(*GcMetadata::remembered_set_for(reinterpret_cast<uword>(&elements[i])));
+      }
+    }
+  }
+}
+#endif
+
 }  // namespace toit
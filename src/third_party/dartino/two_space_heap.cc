@@ -16,11 +16,16 @@ TwoSpaceHeap::TwoSpaceHeap(Program* program, ObjectHeap* process_heap, Chunk* ch
     : program_(program),
       process_heap_(process_heap),
       old_space_(program, this),
-      semi_space_(program, chunk) {
+      semi_space_(program, chunk),
+      large_object_space_(program, this) {
   semi_space_size_ = TOIT_PAGE_SIZE;
   if (chunk) water_mark_ = chunk->start();
 }
 
+TwoSpaceHeap::~TwoSpaceHeap() {
+  if (is_marking_incrementally()) abandon_incremental_marking();
+}
+
 word TwoSpaceHeap::max_external_allocation() {
   return process_heap_->max_external_allocation();
 }
@@ -30,6 +35,9 @@ Process* TwoSpaceHeap::process() {
 }
 
 HeapObject* TwoSpaceHeap::allocate(uword size) {
+  if (size > static_cast<uword>(ObjectHeap::max_allocation_size())) {
+    return allocate_large_object(size);
+  }
   uword result = semi_space_.allocate(size);
   if (result == 0) {
     return new_space_allocation_failure(size);
@@ -43,6 +51,11 @@ static const uword MINIMUM_POST_GC_SPACE = TOIT_PAGE_SIZE >> 2;
 static const uword MINIMUM_POST_GC_SPACE = TOIT_PAGE_SIZE >> 1;
 #endif
 
+// Smaller old-spaces are collected fast enough without incremental marking.
+static const uword INCREMENTAL_MARKING_MINIMUM_OLD_SPACE = 1 * MB;
+// The number of bytes of objects that are scanned in each marking slice.
+static const uword INCREMENTAL_MARKING_SLICE = 64 * KB;
+
 HeapObject* TwoSpaceHeap::new_space_allocation_failure(uword size) {
   if (size >= MINIMUM_POST_GC_SPACE) {
     large_allocation_failed_ = true;
@@ -63,6 +76,30 @@ HeapObject* TwoSpaceHeap::new_space_allocation_failure(uword size) {
   return null;
 }
 
+HeapObject* TwoSpaceHeap::allocate_large_object(uword size) {
+  uword result = large_object_space_.allocate(size);
+  if (result == 0) {
+    // Only an old-space GC can free large objects, so we make sure the next
+    // GC is one.
+    large_allocation_failed_ = true;
+    old_space_.set_promotion_failed(true);
+    return null;
+  }
+  return HeapObject::from_address(result);
+}
+
+HeapObject* TwoSpaceHeap::allocate_pretenured(uword size) {
+  // Large objects are never allocated in new-space anyway.
+  if (size > static_cast<uword>(ObjectHeap::max_allocation_size())) return null;
+  uword result = old_space_.allocate(size);
+  if (result == 0) return null;
+  total_bytes_allocated_ += size;
+  // As for the objects allocated in old-space while retrying a primitive,
+  // the new object is populated without a write barrier.
+  GcMetadata::insert_into_remembered_set(result);
+  return HeapObject::from_address(result);
+}
+
 void TwoSpaceHeap::swap_semi_spaces(SemiSpace& from, SemiSpace& to) {
   water_mark_ = to.top();
   bool postpone_old_space = old_space()->is_empty() && !large_allocation_failed_;
@@ -110,7 +147,15 @@ HeapObject* ScavengeVisitor::clone_into_space(Program* program, HeapObject* orig
 void ScavengeVisitor::do_roots(Object** start, word count) {
   Object** end = start + count;
   for (Object** p = start; p < end; p++) {
-    if (!in_from_space(*p)) continue;
+    if (!in_from_space(*p)) {
+      if (marking_stack_ != null && GcMetadata::in_old_or_large_object_space(*p)) {
+        HeapObject* heap_object = HeapObject::cast(*p);
+        if (!GcMetadata::mark_grey_if_not_marked(heap_object)) {
+          marking_stack_->push(heap_object);
+        }
+      }
+      continue;
+    }
     HeapObject* old_object = reinterpret_cast<HeapObject*>(*p);
     if (old_object->has_forwarding_address()) {
       HeapObject* destination = old_object->forwarding_address();
@@ -145,12 +190,16 @@ void SemiSpace::start_scavenge() {
 void TwoSpaceHeap::do_scavenge(ScavengeVisitor* visitor) {
   SemiSpace* from = new_space();
   SemiSpace* to = visitor->to_space();
+  // Chunks can't be swept while we scavenge, so make sure there is room for
+  // the promoted objects.
+  old_space()->sweep_until(from->used());
   to->start_scavenge();
   old_space()->start_scavenge();
 
   process_heap_->iterate_roots(visitor);
 
   old_space()->visit_remembered_set(visitor);
+  large_object_space()->visit_remembered_set(visitor);
 
   // Scavenge as much as possible so we can identify which objects need
   // finalizing.
@@ -171,6 +220,9 @@ void TwoSpaceHeap::do_scavenge(ScavengeVisitor* visitor) {
 
   visitor->complete_scavenge();
 
+  if (Flags::pretenuring) process_heap_->process_allocation_site_samples(from);
+  process_heap_->update_stack_bytes(-visitor->shrunk_stack_bytes());
+
   old_space()->end_scavenge();
 
   total_bytes_allocated_ -= to->used();
@@ -181,7 +233,8 @@ GcType TwoSpaceHeap::collect_new_space(bool try_hard) {
 
   // Avoid getting time if we don't need it.  Best-case scavenges
   // are around 1us on desktop and this call is surprisingly expensive.
-  uint64 start = (Flags::tracegc) ? OS::get_monotonic_time() : 0;
+  bool timed = Flags::tracegc || process_heap_->has_gc_event_log();
+  uint64 start = timed ? OS::get_monotonic_time() : 0;
 
   // Might get set during scavenge if we fail to promote to a full old-space
   // that can't be expanded.
@@ -205,6 +258,7 @@ GcType TwoSpaceHeap::collect_new_space(bool try_hard) {
 
   uword old_used = old_space()->used();
   word old_external = process_heap_->external_memory();
+  word bytes_before = process_heap_->bytes_allocated();
   word from_used;
   word to_used;
   bool trigger_old_space_gc;
@@ -266,8 +320,11 @@ GcType TwoSpaceHeap::collect_new_space(bool try_hard) {
     swap_semi_spaces(*from, *to);
   }
 
+  uint64 end = timed ? OS::get_monotonic_time() : 0;
+  process_heap_->record_gc_event(GC_EVENT_SCAVENGE, start, end,
+      bytes_before, process_heap_->bytes_allocated(), old_space()->used() - old_used);
+
   if (Flags::tracegc) {
-    uint64 end = OS::get_monotonic_time();
     int f = from_used;
     int t = to_used;
     int o = old_used;
@@ -325,7 +382,14 @@ GcType TwoSpaceHeap::collect_new_space(bool try_hard) {
     old_space()->report_new_space_progress(progress);
   }
 
-  return collect_old_space_if_needed(try_hard, trigger_old_space_gc);
+  if (is_marking_incrementally() && incremental_marking_step()) {
+    // The marking is done, so we finish the old-space GC now.
+    trigger_old_space_gc = true;
+  }
+
+  GcType type = collect_old_space_if_needed(try_hard, trigger_old_space_gc);
+  if (type == NEW_SPACE_GC) start_incremental_marking_if_needed();
+  return type;
 }
 
 uword TwoSpaceHeap::total_bytes_allocated() const {
@@ -336,10 +400,11 @@ uword TwoSpaceHeap::total_bytes_allocated() const {
 
 GcType TwoSpaceHeap::collect_old_space_if_needed(bool force_compact, bool force) {
 #ifdef TOIT_DEBUG
-  if (Flags::validate_heap) {
+  if (Flags::validate_heap && !is_marking_incrementally()) {
     validate();
     old_space()->validate_before_mark_sweep(OLD_SPACE_PAGE, false);
     new_space()->validate_before_mark_sweep(NEW_SPACE_PAGE, true);
+    large_object_space()->validate_before_mark_sweep(LARGE_OBJECT_PAGE, false);
   }
 #endif
   if (!force && !force_compact && !old_space()->needs_garbage_collection()) {
@@ -355,6 +420,7 @@ GcType TwoSpaceHeap::collect_old_space_if_needed(bool force_compact, bool force)
 void TwoSpaceHeap::validate() {
   new_space()->validate();
   old_space()->validate();
+  large_object_space()->validate();
 }
 #endif
 
@@ -362,11 +428,16 @@ GcType TwoSpaceHeap::collect_old_space(bool force_compact) {
   uint64 start = OS::get_monotonic_time();
   uword old_used = old_space()->used();
   uword old_external = process_heap_->external_memory();
+  word bytes_before = process_heap_->bytes_allocated();
+  bool incremental = is_marking_incrementally();
 
   bool compacted = perform_garbage_collection(force_compact);
 
+  uint64 end = OS::get_monotonic_time();
+  process_heap_->record_gc_event(compacted ? GC_EVENT_COMPACTION : GC_EVENT_MARK_SWEEP, start, end,
+      bytes_before, process_heap_->bytes_allocated());
+
   if (Flags::tracegc) {
-    uint64 end = OS::get_monotonic_time();
     int f = old_used;
     int t = old_space()->used();
     uword overhead = old_space()->size() - t;
@@ -395,8 +466,9 @@ GcType TwoSpaceHeap::collect_old_space(bool force_compact) {
           ne >> 10);
     }
 
-    printf("%p Mark-sweep%s: %d%c->%d%c%s%s %dus\n",
+    printf("%p %s%s: %d%c->%d%c%s%s %dus (mark %dus, sweep %dus)\n",
         process_heap_->owner(),
+        incremental ? "Incremental mark-sweep" : "Mark-sweep",
         compacted ? "-compact" : "",
         (f >> 10) ? (f >> 10) : f,
         (f >> 10) ? 'k' : 'b',
@@ -404,7 +476,9 @@ GcType TwoSpaceHeap::collect_old_space(bool force_compact) {
         (t >> 10) ? 'k' : 'b',
         overhead_buffer,
         external_buffer,
-        static_cast<int>(end - start));
+        static_cast<int>(end - start),
+        static_cast<int>(mark_us_),
+        static_cast<int>(sweep_us_));
   }
 
   old_space()->set_promotion_failed(false);
@@ -423,27 +497,50 @@ bool TwoSpaceHeap::perform_garbage_collection(bool force_compact) {
   // detect liveness paths that go through new-space, but we just clear the
   // mark bits afterwards.  Dead objects in new-space are only cleared in a
   // new-space GC (scavenge).
+  uint64 mark_start = Flags::tracegc ? OS::get_monotonic_time() : 0;
   SemiSpace* semi_space = new_space();
-  MarkingStack stack(program_);
+  old_space()->abandon_lazy_sweep();
+  MarkingStack local_stack(program_);
+  MarkingStack& stack = is_marking_incrementally() ? *marking_stack_ : local_stack;
   MarkingVisitor marking_visitor(semi_space, &stack);
 
+  if (is_marking_incrementally()) {
+    // Most of old-space is already marked.  The objects that were written to
+    // after they were scanned are revisited, without shrinking stacks, since
+    // they may already be black.
+    old_space()->set_allocating_black(false);
+    large_object_space()->set_allocating_black(false);
+    MarkingVisitor dirty_visitor(semi_space, &stack, false);
+    old_space()->visit_marked_dirty_objects(&dirty_visitor);
+    large_object_space()->visit_marked_dirty_objects(&dirty_visitor);
+  }
+
   process_heap_->iterate_roots(&marking_visitor);
 
-  stack.process(&marking_visitor, old_space(), semi_space);
+  stack.process(&marking_visitor, old_space(), semi_space, large_object_space());
 
   process_heap_->process_registered_callback_finalizers(&marking_visitor, old_space());
   process_heap_->process_finalizer_queue(&marking_visitor, old_space());
 
-  stack.process(&marking_visitor, old_space(), semi_space);
+  stack.process(&marking_visitor, old_space(), semi_space, large_object_space());
 
   process_heap_->process_registered_vm_finalizers(&marking_visitor, old_space());
 
-  stack.process(&marking_visitor, old_space(), semi_space);
+  stack.process(&marking_visitor, old_space(), semi_space, large_object_space());
+
+  process_heap_->update_stack_bytes(-marking_visitor.shrunk_stack_bytes());
 
   word regained_by_compacting = old_space()->compute_compaction_destinations();
 
   bool compact = force_compact || regained_by_compacting > 0;
 
+  if (is_marking_incrementally()) {
+    delete marking_stack_;
+    marking_stack_ = null;
+  }
+
+  uint64 sweep_start = Flags::tracegc ? OS::get_monotonic_time() : 0;
+
   if (compact) {
     // We can reclaim some memory by compacting.
     compact_heap();
@@ -452,6 +549,12 @@ bool TwoSpaceHeap::perform_garbage_collection(bool force_compact) {
     sweep_heap();
   }
 
+  if (Flags::tracegc) {
+    uint64 sweep_end = OS::get_monotonic_time();
+    mark_us_ = sweep_start - mark_start;
+    sweep_us_ = sweep_end - sweep_start;
+  }
+
 #ifdef TOIT_DEBUG
   if (Flags::validate_heap) validate();
 #endif
@@ -464,8 +567,9 @@ void TwoSpaceHeap::sweep_heap() {
 
   old_space()->set_compacting(false);
 
-  // Sweep over the old-space and rebuild the freelist.
-  uword used_after = old_space()->sweep();
+  // Free the empty chunks.  The rest of old-space is swept lazily.
+  uword used_after = old_space()->start_lazy_sweep();
+  large_object_space()->sweep();
 
   // These are only needed during the mark phase, we can clear them without
   // looking at them.
@@ -518,6 +622,12 @@ void TwoSpaceHeap::compact_heap() {
   // left partially initialized objects in the semi-space.
   semi_space->iterate_objects(&new_space_visitor, old_space());
 
+  // The large objects are not moved, but they can point to objects that
+  // were.
+  large_object_space()->sweep();
+  HeapObjectPointerVisitor large_object_visitor(program_, &fix);
+  large_object_space()->iterate_objects(&large_object_visitor);
+
   process_heap_->iterate_roots(&fix);
   process_heap_->iterate_finalization_roots(&fix);
 
@@ -526,10 +636,77 @@ void TwoSpaceHeap::compact_heap() {
   old_space()->mark_chunk_ends_free();
 }
 
+void TwoSpaceHeap::start_incremental_marking_if_needed() {
+  if (!Flags::incremental_marking || is_marking_incrementally()) return;
+  if (old_space()->has_unswept_chunks()) {
+    // The scavenger visits dead objects in unswept chunks, and must not
+    // mark what they point to, so we finish sweeping first.
+    old_space()->sweep_next_chunk();
+    return;
+  }
+  if (old_space()->used() < INCREMENTAL_MARKING_MINIMUM_OLD_SPACE) return;
+  // Start when we are about three quarters of the way to the limit that
+  // triggers the next old-space GC.
+  word headroom = max_external_allocation();
+  if (headroom > static_cast<word>(size() / 3)) return;
+
+  marking_stack_ = _new MarkingStack(program_);
+  if (marking_stack_ == null) return;  // Just do a normal GC later.
+
+  if (Flags::tracegc) {
+    printf("%p Incremental marking started (old-gen %dk)\n",
+        process_heap_->owner(),
+        static_cast<int>(old_space()->used() >> 10));
+  }
+
+  old_space()->set_allocating_black(true);
+  large_object_space()->set_allocating_black(true);
+  // The roots and the new-space objects are visited again when the marking
+  // is finished, but marking what they point to now means that fewer objects
+  // are left for the final pause.
+  IncrementalMarkingVisitor visitor(program_, marking_stack_);
+  process_heap_->iterate_roots(&visitor);
+  HeapObjectPointerVisitor new_space_visitor(program_, &visitor);
+  new_space()->iterate_objects(&new_space_visitor);
+}
+
+bool TwoSpaceHeap::incremental_marking_step() {
+  ASSERT(is_marking_incrementally());
+  bool timed = process_heap_->has_gc_event_log();
+  uint64 start = timed ? OS::get_monotonic_time() : 0;
+  IncrementalMarkingVisitor visitor(program_, marking_stack_);
+  bool done = false;
+  if (marking_stack_->empty(&visitor, INCREMENTAL_MARKING_SLICE)) {
+    if (marking_stack_->is_overflowed()) {
+      marking_stack_->clear_overflow();
+      // Make the space iterable before looking for grey objects.
+      old_space()->flush();
+      old_space()->iterate_overflowed_objects(&visitor, marking_stack_);
+      large_object_space()->iterate_overflowed_objects(&visitor, marking_stack_);
+    }
+    done = marking_stack_->is_empty() && !marking_stack_->is_overflowed();
+  }
+  if (timed) {
+    word bytes = process_heap_->bytes_allocated();
+    process_heap_->record_gc_event(GC_EVENT_INCREMENTAL_MARK, start, OS::get_monotonic_time(), bytes, bytes);
+  }
+  return done;
+}
+
+void TwoSpaceHeap::abandon_incremental_marking() {
+  old_space()->set_allocating_black(false);
+  old_space()->clear_marking_state();
+  large_object_space()->set_allocating_black(false);
+  large_object_space()->clear_marking_state();
+  delete marking_stack_;
+  marking_stack_ = null;
+}
+
 #ifdef TOIT_DEBUG
 void TwoSpaceHeap::find(uword word) {
   semi_space_.find(word, "data semi_space");
   old_space_.find(word, "oldspace");
+  large_object_space_.find(word, "large object space");
 #ifdef DARTINO_TARGET_OS_LINUX
   FILE* fp = fopen("/proc/self/maps", "r");
   if (fp == NULL) return;
@@ -12,6 +12,7 @@
 
 namespace toit {
 
+class MarkingStack;
 class ScavengeVisitor;
 
 class HeapObjectFunctionVisitor : public HeapObjectVisitor {
@@ -33,6 +34,7 @@ class HeapObjectFunctionVisitor : public HeapObjectVisitor {
 class TwoSpaceHeap {
  public:
   TwoSpaceHeap(Program* program, ObjectHeap* process_heap, Chunk* chunk);
+  ~TwoSpaceHeap();
 
   // Allocate raw object. Returns null if a garbage collection is
   // needed.
@@ -62,7 +64,9 @@ class TwoSpaceHeap {
 
   OldSpace* old_space() { return &old_space_; }
 
-  word size() const { return old_space_.size() + new_space()->size(); }
+  LargeObjectSpace* large_object_space() { return &large_object_space_; }
+
+  word size() const { return old_space_.size() + new_space()->size() + large_object_space_.size(); }
 
   void swap_semi_spaces(SemiSpace& from, SemiSpace& to);
 
@@ -72,9 +76,12 @@ class TwoSpaceHeap {
   void iterate_objects(HeapObjectVisitor* visitor) {
     semi_space_.iterate_objects(visitor);
     old_space_.iterate_objects(visitor);
+    large_object_space_.iterate_objects(visitor);
   }
 
   void do_objects(const std::function<void (HeapObject*)>& func) {
+    // Dead objects in unswept chunks may point to reused memory.
+    old_space_.complete_sweep();
     HeapObjectFunctionVisitor visitor(program_, func);
     iterate_objects(&visitor);
   }
@@ -82,6 +89,7 @@ class TwoSpaceHeap {
   void iterate_chunks(void* context, process_chunk_callback_t* callback) {
     semi_space_.iterate_chunks(context, process(), callback);
     old_space_.iterate_chunks(context, process(), callback);
+    large_object_space_.iterate_chunks(context, process(), callback);
   }
 
   // Flush will write cached values back to object memory.
@@ -92,10 +100,18 @@ class TwoSpaceHeap {
   }
 
   // Returns the number of bytes allocated in the space.
-  word used() const { return old_space_.used() + semi_space_.used(); }
+  word used() const { return old_space_.used() + semi_space_.used() + large_object_space_.used(); }
 
   HeapObject* new_space_allocation_failure(uword size);
 
+  // Objects that are too big for a page are allocated in the large-object
+  // space.
+  HeapObject* allocate_large_object(uword size);
+
+  // Allocates an object from a pretenured allocation site in old-space.
+  // Returns null if old-space needs a GC first.
+  HeapObject* allocate_pretenured(uword size);
+
   bool has_empty_new_space() { return semi_space_.top() == semi_space_.single_chunk_start(); }
 
   void allocated_foreign_memory(uword size);
@@ -109,9 +125,24 @@ class TwoSpaceHeap {
   bool cross_process_gc_needed() const { return malloc_failed_; }
   void report_malloc_failed() { malloc_failed_ = true; }
   void sweep_heap();
+  bool has_unswept_chunks() const { return old_space_.has_unswept_chunks(); }
+  // Sweeps unswept old-space chunks until at least [bytes] of chunks have
+  // been swept.
+  void sweep_until(uword bytes) { old_space_.sweep_until(bytes); }
   void compact_heap();
   void set_promotion_failed() { old_space_.set_promotion_failed(true); }
 
+  // Incremental marking of old-space, enabled with -Xincremental_marking.
+  // The marking is started after a scavenge when a large old-space is
+  // getting close to the limit that triggers an old-space GC.  The marking
+  // then progresses in slices after each scavenge and each time the process
+  // is preempted.  The marking is finished, and the heap swept or compacted,
+  // in the scavenge after the last slice.
+  bool is_marking_incrementally() const { return marking_stack_ != null; }
+  // Does a bounded amount of marking work.  Returns true if there is no more
+  // marking to do before the marking can be finished.
+  bool incremental_marking_step();
+
   uword total_bytes_allocated() const;
 
   word max_external_allocation();
@@ -120,15 +151,22 @@ class TwoSpaceHeap {
   friend class ScavengeVisitor;
 
   void do_scavenge(ScavengeVisitor* visitor);
+  void start_incremental_marking_if_needed();
+  void abandon_incremental_marking();
 
   Program* program_;
   ObjectHeap* process_heap_;
   OldSpace old_space_;
   SemiSpace semi_space_;
+  LargeObjectSpace large_object_space_;
   Chunk* spare_chunk_ = null;  // Only used for large heap heuristics mode.
+  MarkingStack* marking_stack_ = null;  // Only used while marking incrementally.
   uword water_mark_;
   uword semi_space_size_;
   uword total_bytes_allocated_ = 0;
+  // Only used for tracegc.
+  uint64 mark_us_ = 0;
+  uint64 sweep_us_ = 0;
   bool large_allocation_failed_ = false;
   bool malloc_failed_ = false;
 };
@@ -145,18 +183,28 @@ class ScavengeVisitor : public RootCallback {
         to_(program, to_chunk),
         old_(heap->old_space()),
         record_(&dummy_record_),
-        water_mark_(heap->water_mark_) {}
+        water_mark_(heap->water_mark_),
+        marking_stack_(heap->marking_stack_) {}
 
   SemiSpace* to_space() { return &to_; }
 
   void complete_scavenge() {
     bool work_found = true;
     while (work_found) {
+      // The stacks that survive in new-space are copied at every scavenge,
+      // so their unused part is trimmed once they are in to-space.
+      shrink_stacks_ = true;
       work_found = to_.complete_scavenge(this);
+      shrink_stacks_ = false;
       work_found |= old_->complete_scavenge(this);
     }
   }
 
+  bool shrink_stacks() const override { return shrink_stacks_; }
+
+  void stack_shrunk(word bytes) override { shrunk_stack_bytes_ += bytes; }
+  word shrunk_stack_bytes() const { return shrunk_stack_bytes_; }
+
   virtual void do_root(Object** p) { do_roots(p, 1); }
 
   inline bool in_from_space(Object* object) {
@@ -190,11 +238,19 @@ class ScavengeVisitor : public RootCallback {
   SemiSpace to_;
   OldSpace* old_;
   bool trigger_old_space_gc_ = false;
+  bool shrink_stacks_ = false;
+  word shrunk_stack_bytes_ = 0;
   uint8* record_;
   // Avoid checking for null by having a default place to write the remembered
   // set byte.
   uint8 dummy_record_;
   uword water_mark_;
+  // While old-space is being marked incrementally, the scavenger marks the
+  // old-space objects it finds in the remembered set and in the promoted
+  // objects.  Together with the marking of dirty cards when the marking is
+  // finished, this turns the card marking write barrier into an
+  // incremental-update barrier.
+  MarkingStack* marking_stack_;
 };
 
 }  // namespace toit
@@ -38,11 +38,15 @@ int main(int argc, char **argv) {
 
   int exit_state = 0;
   if (argc > 1 && strcmp(argv[1], "--lsp") == 0) {
-    // Usually followed by '--project-root' and a path.
+    // Usually followed by '--project-root' and a path, and sometimes by
+    // '--daemon'.
     const char* project_root = null;
+    int flags_start = 2;
     if (argc >= 4 && strcmp(argv[2], "--project-root") == 0) {
       project_root = argv[3];
+      flags_start = 4;
     }
+    bool as_daemon = argc > flags_start && strcmp(argv[flags_start], "--daemon") == 0;
     compiler::Compiler::Configuration compiler_config = {
       .dep_file = null,
       .dep_format = compiler::Compiler::DepFormat::none,
@@ -52,9 +56,14 @@ int main(int argc, char **argv) {
       .show_package_warnings = false,
       .print_diagnostics_on_stdout = true,
       .optimization_level = DEFAULT_OPTIMIZATION_LEVEL,
+      .snapshot_cache = null,
     };
     compiler::Compiler compiler;
-    compiler.language_server(compiler_config);
+    if (as_daemon) {
+      compiler.language_server_daemon(compiler_config);
+    } else {
+      compiler.language_server(compiler_config);
+    }
     OS::tear_down();
     return 0;
   } else if (argc >= 2 && SnapshotBundle::is_bundle_file(argv[1])) {
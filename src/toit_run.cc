@@ -29,6 +29,7 @@
 #include "utils.h"
 #include "main_utf_8_helper.h"
 #include "compiler/compiler.h"
+#include "compiler/snapshot_cache.h"
 #include "third_party/dartino/gc_metadata.h"
 
 #include "objects_inline.h"
@@ -54,12 +55,14 @@ static void print_usage(int exit_code) {
   printf("  [--force]                            // Finish compilation even with errors (if possible).\n");
   printf("  [-Werror]                            // Treat warnings like errors.\n");
   printf("  [--show-package-warnings]            // Show warnings from packages.\n");
+  printf("  [--no-snapshot-cache]                // Compile the Toit file even if it has a cached snapshot.\n");
   printf("  { <snapshot> <args>... |             // Run snapshot file.\n");
   printf("    <toitfile> <args>... |             // Run Toit file.\n");
   printf("    -w <snapshot> <toitfile> |         // Write snapshot file.\n");
   printf("    -s <expression> |                  // Evaluate Toit expression.\n");
   printf("    --analyze <toitfiles>...           // Analyze Toit files.\n");
   printf("  }\n");
+  printf("toit.run --clear-snapshot-cache        // Remove the cached snapshots.\n");
   exit(exit_code);
 }
 
@@ -121,6 +124,17 @@ int main(int argc, char **argv) {
     print_version();
   }
 
+  // Clearing the snapshot cache must be used on its own.
+  if (strcmp(argv[1], "--clear-snapshot-cache") == 0) {
+    if (argc != 2) {
+      fprintf(stderr, "Can't have options with '%s'\n", argv[1]);
+      print_usage(1);
+    }
+    auto cache_directory = compiler::SnapshotCache::default_directory();
+    if (cache_directory != null) compiler::SnapshotCache::clear(cache_directory);
+    exit(0);
+  }
+
   // TODO(2663): remove support for '-r'.
   if (strcmp(argv[1], "-r") == 0 ||
       SnapshotBundle::is_bundle_file(argv[1])) {
@@ -157,10 +171,12 @@ int main(int argc, char **argv) {
     bool force = false;
     bool werror = false;
     bool show_package_warnings = false;
+    bool use_snapshot_cache = true;
     const char* dep_file = null;
     const char* project_root = null;
     auto dep_format = compiler::Compiler::DepFormat::none;
     bool for_language_server = false;
+    bool as_daemon = false;
     bool for_analysis = false;
     int optimization_level = DEFAULT_OPTIMIZATION_LEVEL;
 
@@ -170,7 +186,8 @@ int main(int argc, char **argv) {
     while (processed_args < argc) {
       if (strcmp(argv[processed_args], "-h") == 0 ||
           strcmp(argv[processed_args], "--help") == 0 ||
-          strcmp(argv[processed_args], "--version") == 0) {
+          strcmp(argv[processed_args], "--version") == 0 ||
+          strcmp(argv[processed_args], "--clear-snapshot-cache") == 0) {
         fprintf(stderr,
                 "The '%s' flag must not be used in combination with other arguments\n",
                 argv[processed_args]);
@@ -225,6 +242,9 @@ int main(int argc, char **argv) {
       } else if (strcmp(argv[processed_args], "--show-package-warnings") == 0) {
         show_package_warnings = true;
         processed_args++;
+      } else if (strcmp(argv[processed_args], "--no-snapshot-cache") == 0) {
+        use_snapshot_cache = false;
+        processed_args++;
       } else if (strcmp(argv[processed_args], "--dependency-file") == 0) {
         processed_args++;
         if (processed_args == argc) {
@@ -272,6 +292,9 @@ int main(int argc, char **argv) {
         for_analysis = strcmp(argv[processed_args], "--analyze") == 0;
         processed_args++;
         ways_to_run++;
+      } else if (strcmp(argv[processed_args], "--daemon") == 0) {
+        as_daemon = true;
+        processed_args++;
       } else if (argv[processed_args][0] == '-' &&
                  strcmp(argv[processed_args], "--") != 0) {
         fprintf(stderr, "Unknown flag '%s'\n", argv[processed_args]);
@@ -348,6 +371,11 @@ int main(int argc, char **argv) {
       print_usage(1);
     }
 
+    if (as_daemon && !for_language_server) {
+      fprintf(stderr, "The --daemon flag can only be used together with --lsp\n");
+      print_usage(1);
+    }
+
     if (for_language_server && dep_file != null) {
       fprintf(stderr, "Can't generate dependency file with --lsp\n");
       print_usage(1);
@@ -367,11 +395,16 @@ int main(int argc, char **argv) {
       // running the language-server, in which case the diagnostics must be on stdout.
       .print_diagnostics_on_stdout = for_analysis || generating_bundle,
       .optimization_level = optimization_level,
+      .snapshot_cache = null,
     };
 
     if (for_language_server) {
       compiler::Compiler compiler;
-      compiler.language_server(compiler_config);
+      if (as_daemon) {
+        compiler.language_server_daemon(compiler_config);
+      } else {
+        compiler.language_server(compiler_config);
+      }
     } else if (for_analysis) {
       compiler::Compiler compiler;
       compiler.analyze(List<const char*>(source_paths, source_path_count),
@@ -379,13 +412,23 @@ int main(int argc, char **argv) {
                        false);  // Not for dependencies.
     } else {
       auto compiled = SnapshotBundle::invalid();
-      { compiler::Compiler compiler;  // Scope the compiler, so we destroy it before running the interpreter.
-        auto source_path = source_path_count == 0 ? null : source_paths[0];
+      auto source_path = source_path_count == 0 ? null : source_paths[0];
+      // Running a Toit file goes through the snapshot cache, unless the
+      // compilation has other outputs.
+      compiler::SnapshotCache* snapshot_cache = null;
+      if (use_snapshot_cache && source_path != null && !generating_bundle && dep_file == null) {
+        snapshot_cache = compiler::SnapshotCache::for_entry(source_path, project_root, optimization_level);
+      }
+      if (snapshot_cache != null) compiled = snapshot_cache->lookup();
+      if (!compiled.is_valid()) {
+        compiler_config.snapshot_cache = snapshot_cache;
+        compiler::Compiler compiler;  // Scope the compiler, so we destroy it before running the interpreter.
         compiled = compiler.compile(source_path,
                                     direct_script,
                                     bundle_filename,
                                     compiler_config);
       }
+      delete snapshot_cache;
       if (!generating_bundle) {
         exit_state = run_program(boot_bundle_path,
                                  compiled,
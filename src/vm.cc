@@ -16,7 +16,10 @@
 #include <signal.h>
 
 #include "entropy_mixer.h"
+#include "flags.h"
+#include "interpreter.h"
 #include "memory.h"
+#include "messaging.h"
 #include "program_memory.h"
 #include "objects_inline.h"
 #include "os.h"
@@ -51,6 +54,9 @@ VM::VM() {
 }
 
 VM::~VM() {
+#ifdef TOIT_BYTECODE_PROFILE
+  if (Flags::bytecode_profile) Interpreter::print_profile();
+#endif
   delete event_manager_;
   delete scheduler_;
   current_ = null;